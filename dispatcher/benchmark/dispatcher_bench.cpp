@@ -0,0 +1,438 @@
+/*############################################################################
+  # Copyright (C) Intel Corporation
+  #
+  # SPDX-License-Identifier: MIT
+  ############################################################################*/
+
+// Micro-benchmarks for the dispatcher: MFXLoad, MFXSetConfigFilterProperty,
+// MFXEnumImplementations and MFXCreateSession with 1 to N fake implementations.
+//
+// The stub runtime built alongside this program is copied once per
+// implementation into a temporary directory which is then set as
+// ONEVPL_SEARCH_PATH. Other dispatcher environment variables (e.g.
+// ONEVPL_LAZY_LOAD, ONEVPL_CAPS_CACHE_DIR) are left as they are, so the same
+// benchmarks can be run with and without them.
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "vpl/mfxdispatcher.h"
+#include "vpl/mfxdispatcherext.h"
+#include "vpl/mfxvideo.h"
+
+#ifndef BENCH_STUB_RUNTIME
+    #define BENCH_STUB_RUNTIME ""
+#endif
+
+typedef std::chrono::steady_clock ClockType;
+
+struct BenchParams {
+    std::vector<mfxU32> numImpls   = { 1, 10, 100 };
+    std::vector<mfxU32> numFilters = { 1, 4, 16 };
+    mfxU32 iters                   = 50;
+    std::string stubPath           = BENCH_STUB_RUNTIME;
+    bool bCSV                      = false;
+};
+
+// properties which every stub implementation matches, used round-robin for the filter benchmarks
+struct BenchFilter {
+    const char* name;
+    mfxVariantType type;
+    mfxU32 value;
+};
+
+static const BenchFilter BenchFilters[] = {
+    { "mfxImplDescription.Impl", MFX_VARIANT_TYPE_U32, MFX_IMPL_TYPE_SOFTWARE },
+    { "mfxImplDescription.AccelerationMode", MFX_VARIANT_TYPE_U32, MFX_ACCEL_MODE_NA },
+    { "mfxImplDescription.VendorID", MFX_VARIANT_TYPE_U32, 0x8086 },
+    { "mfxImplDescription.ApiVersion.Major", MFX_VARIANT_TYPE_U16, 2 },
+    { "mfxImplDescription.mfxDecoderDescription.decoder.CodecID",
+      MFX_VARIANT_TYPE_U32,
+      MFX_CODEC_AVC },
+    { "mfxImplDescription.mfxDecoderDescription.decoder.decprofile.Profile",
+      MFX_VARIANT_TYPE_U32,
+      MFX_PROFILE_AVC_MAIN },
+    { "mfxImplDescription.mfxDecoderDescription.decoder.decprofile.decmemdesc.MemHandleType",
+      MFX_VARIANT_TYPE_U32,
+      MFX_RESOURCE_SYSTEM_SURFACE },
+    { "mfxImplDescription.mfxDecoderDescription.decoder.decprofile.decmemdesc.ColorFormats",
+      MFX_VARIANT_TYPE_U32,
+      MFX_FOURCC_NV12 },
+};
+
+static const mfxU32 NumBenchFilters = sizeof(BenchFilters) / sizeof(BenchFilters[0]);
+
+static void Usage() {
+    printf("\n");
+    printf("   Usage  :  vpl-dispatcher-bench [options]\n");
+    printf("     -impls <n,n,...>    numbers of fake implementations (default 1,10,100)\n");
+    printf("     -filters <n,n,...>  numbers of config filters (default 1,4,16)\n");
+    printf("     -iters <n>          timed iterations per benchmark (default 50)\n");
+    printf("     -stub <path>        stub runtime library (default %s)\n", BENCH_STUB_RUNTIME);
+    printf("     -csv                print results as CSV\n");
+    printf("\n");
+}
+
+static bool ParseList(const char* str, std::vector<mfxU32>& list) {
+    list.clear();
+
+    while (*str) {
+        char* end = nullptr;
+        long val  = strtol(str, &end, 10);
+        if (end == str || val <= 0)
+            return false;
+
+        list.push_back((mfxU32)val);
+
+        str = end;
+        if (*str == ',')
+            str++;
+    }
+
+    return !list.empty();
+}
+
+static bool ParseArgs(int argc, char* argv[], BenchParams& params) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool bHasVal    = (i + 1 < argc);
+
+        if (arg == "-impls" && bHasVal) {
+            if (!ParseList(argv[++i], params.numImpls))
+                return false;
+        }
+        else if (arg == "-filters" && bHasVal) {
+            if (!ParseList(argv[++i], params.numFilters))
+                return false;
+        }
+        else if (arg == "-iters" && bHasVal) {
+            params.iters = (mfxU32)strtoul(argv[++i], nullptr, 10);
+            if (params.iters == 0)
+                return false;
+        }
+        else if (arg == "-stub" && bHasVal) {
+            params.stubPath = argv[++i];
+        }
+        else if (arg == "-csv") {
+            params.bCSV = true;
+        }
+        else {
+            return false;
+        }
+    }
+
+    return !params.stubPath.empty();
+}
+
+// temporary directory with one copy of the stub runtime per implementation
+class StubRuntimeDir {
+public:
+    StubRuntimeDir() : m_dir() {}
+    ~StubRuntimeDir() {
+        Remove();
+    }
+
+    bool Create(const std::string& stubPath, mfxU32 numImpls) {
+        std::ifstream in(stubPath, std::ios::binary);
+        if (!in)
+            return false;
+
+        std::string lib((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+        const char* tmpDir      = getenv("TMPDIR");
+        std::string dirTemplate = std::string(tmpDir ? tmpDir : "/tmp") + "/vplbenchXXXXXX";
+        if (!mkdtemp(&dirTemplate[0]))
+            return false;
+        m_dir = dirTemplate;
+
+        // distinct files, so the dynamic loader does not share one handle between them
+        for (mfxU32 i = 0; i < numImpls; i++) {
+            char name[64];
+            snprintf(name, sizeof(name), "/libvplbench%03u.so", i);
+
+            std::ofstream out(m_dir + name, std::ios::binary);
+            out.write(lib.data(), lib.size());
+            if (!out)
+                return false;
+        }
+
+        return true;
+    }
+
+    void Remove() {
+        if (m_dir.empty())
+            return;
+
+        DIR* dir = opendir(m_dir.c_str());
+        if (dir) {
+            struct dirent* entry;
+            while ((entry = readdir(dir)) != nullptr) {
+                if (strcmp(entry->d_name, ".") && strcmp(entry->d_name, ".."))
+                    unlink((m_dir + "/" + entry->d_name).c_str());
+            }
+            closedir(dir);
+        }
+        rmdir(m_dir.c_str());
+
+        m_dir.clear();
+    }
+
+    const std::string& GetPath() const {
+        return m_dir;
+    }
+
+private:
+    std::string m_dir;
+};
+
+class BenchReport {
+public:
+    explicit BenchReport(bool bCSV) : m_bCSV(bCSV) {}
+
+    void PrintHeader() {
+        if (m_bCSV)
+            printf("benchmark,impls,filters,iters,min_us,median_us,max_us\n");
+        else
+            printf("%-16s %6s %8s %6s %12s %12s %12s\n",
+                   "benchmark",
+                   "impls",
+                   "filters",
+                   "iters",
+                   "min_us",
+                   "median_us",
+                   "max_us");
+    }
+
+    void PrintResult(const char* name,
+                     mfxU32 numImpls,
+                     mfxU32 numFilters,
+                     std::vector<double>& samples) {
+        std::sort(samples.begin(), samples.end());
+
+        double minUs    = samples.front();
+        double medianUs = samples[samples.size() / 2];
+        double maxUs    = samples.back();
+
+        if (m_bCSV)
+            printf("%s,%u,%u,%zu,%.2f,%.2f,%.2f\n",
+                   name,
+                   numImpls,
+                   numFilters,
+                   samples.size(),
+                   minUs,
+                   medianUs,
+                   maxUs);
+        else
+            printf("%-16s %6u %8u %6zu %12.2f %12.2f %12.2f\n",
+                   name,
+                   numImpls,
+                   numFilters,
+                   samples.size(),
+                   minUs,
+                   medianUs,
+                   maxUs);
+
+        fflush(stdout);
+    }
+
+private:
+    bool m_bCSV;
+};
+
+// run one untimed warm-up iteration, then iters timed ones
+// func returns the time in us of the part of the iteration being measured, or < 0 on error
+static bool RunBench(mfxU32 iters, std::vector<double>& samples, std::function<double()> func) {
+    samples.clear();
+
+    if (func() < 0.0)
+        return false;
+
+    for (mfxU32 i = 0; i < iters; i++) {
+        double us = func();
+        if (us < 0.0)
+            return false;
+        samples.push_back(us);
+    }
+
+    return true;
+}
+
+static double ElapsedUs(ClockType::time_point start) {
+    return std::chrono::duration<double, std::micro>(ClockType::now() - start).count();
+}
+
+static mfxU32 CountImpls(mfxLoader loader) {
+    mfxU32 count = 0;
+
+    mfxHDL desc;
+    while (MFXEnumImplementations(loader, count, MFX_IMPLCAPS_IMPLDESCSTRUCTURE, &desc) ==
+           MFX_ERR_NONE) {
+        MFXDispReleaseImplDescription(loader, desc);
+        count++;
+    }
+
+    return count;
+}
+
+static mfxStatus SetFilters(mfxLoader loader, mfxU32 numFilters) {
+    for (mfxU32 i = 0; i < numFilters; i++) {
+        const BenchFilter& filter = BenchFilters[i % NumBenchFilters];
+
+        mfxConfig cfg = MFXCreateConfig(loader);
+        if (!cfg)
+            return MFX_ERR_MEMORY_ALLOC;
+
+        mfxVariant var      = {};
+        var.Version.Version = (mfxU16)MFX_VARIANT_VERSION;
+        var.Type            = filter.type;
+        if (filter.type == MFX_VARIANT_TYPE_U16)
+            var.Data.U16 = (mfxU16)filter.value;
+        else
+            var.Data.U32 = filter.value;
+
+        mfxStatus sts = MFXSetConfigFilterProperty(cfg, (const mfxU8*)filter.name, var);
+        if (sts != MFX_ERR_NONE)
+            return sts;
+    }
+
+    return MFX_ERR_NONE;
+}
+
+static bool RunImplBenchmarks(const BenchParams& params, mfxU32 numImpls, BenchReport& report) {
+    StubRuntimeDir stubDir;
+    if (!stubDir.Create(params.stubPath, numImpls)) {
+        fprintf(stderr, "error: cannot copy stub runtime %s\n", params.stubPath.c_str());
+        return false;
+    }
+    setenv("ONEVPL_SEARCH_PATH", stubDir.GetPath().c_str(), 1);
+
+    std::vector<double> samples;
+
+    // MFXLoad, including directory scan and (unless lazy load is enabled) caps query
+    bool bOK = RunBench(params.iters, samples, [&]() {
+        ClockType::time_point start = ClockType::now();
+        mfxLoader loader            = MFXLoad();
+        double us                   = ElapsedUs(start);
+        if (!loader)
+            return -1.0;
+        MFXUnload(loader);
+        return us;
+    });
+    if (!bOK) {
+        fprintf(stderr, "error: MFXLoad failed with %u implementations\n", numImpls);
+        return false;
+    }
+    report.PrintResult("load", numImpls, 0, samples);
+
+    mfxLoader loader = MFXLoad();
+    if (!loader)
+        return false;
+
+    mfxU32 foundImpls = CountImpls(loader);
+    if (foundImpls != numImpls)
+        fprintf(stderr,
+                "warning: found %u implementations instead of %u, "
+                "check LD_LIBRARY_PATH and the current directory for other runtimes\n",
+                foundImpls,
+                numImpls);
+
+    // MFXEnumImplementations over all implementations, with release
+    bOK = RunBench(params.iters, samples, [&]() {
+        ClockType::time_point start = ClockType::now();
+        mfxU32 count                = CountImpls(loader);
+        double us                   = ElapsedUs(start);
+        return (count == foundImpls) ? us : -1.0;
+    });
+    if (bOK)
+        report.PrintResult("enum_all", numImpls, 0, samples);
+
+    // MFXCreateSession with the last implementation (MFXClose not timed)
+    // the runtime library is loaded by the warm-up iteration
+    bOK = bOK && RunBench(params.iters, samples, [&]() {
+        mfxSession session = nullptr;
+
+        ClockType::time_point start = ClockType::now();
+        mfxStatus sts               = MFXCreateSession(loader, foundImpls - 1, &session);
+        double us                   = ElapsedUs(start);
+        if (sts != MFX_ERR_NONE)
+            return -1.0;
+
+        MFXClose(session);
+        return us;
+    });
+    if (bOK)
+        report.PrintResult("create_session", numImpls, 0, samples);
+
+    MFXUnload(loader);
+
+    if (!bOK) {
+        fprintf(stderr, "error: enumeration or session creation failed\n");
+        return false;
+    }
+
+    for (mfxU32 numFilters : params.numFilters) {
+        std::vector<double> enumSamples;
+
+        // MFXCreateConfig + MFXSetConfigFilterProperty on a fresh loader,
+        //   then the first enumeration which applies the filters
+        bOK = RunBench(params.iters, samples, [&]() {
+            mfxLoader filterLoader = MFXLoad();
+            if (!filterLoader)
+                return -1.0;
+
+            ClockType::time_point start = ClockType::now();
+            mfxStatus sts               = SetFilters(filterLoader, numFilters);
+            double us                   = ElapsedUs(start);
+
+            start        = ClockType::now();
+            mfxU32 count = CountImpls(filterLoader);
+            enumSamples.push_back(ElapsedUs(start));
+
+            MFXUnload(filterLoader);
+
+            return (sts == MFX_ERR_NONE && count == foundImpls) ? us : -1.0;
+        });
+        if (!bOK) {
+            fprintf(stderr, "error: filters removed implementations or failed to set\n");
+            return false;
+        }
+
+        // drop the warm-up sample
+        enumSamples.erase(enumSamples.begin());
+
+        report.PrintResult("set_filters", numImpls, numFilters, samples);
+        report.PrintResult("enum_filtered", numImpls, numFilters, enumSamples);
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    BenchParams params;
+
+    if (!ParseArgs(argc, argv, params)) {
+        Usage();
+        return 1;
+    }
+
+    BenchReport report(params.bCSV);
+    report.PrintHeader();
+
+    for (mfxU32 numImpls : params.numImpls) {
+        if (!RunImplBenchmarks(params, numImpls, report))
+            return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,251 @@
+/*############################################################################
+  # Copyright (C) Intel Corporation
+  #
+  # SPDX-License-Identifier: MIT
+  ############################################################################*/
+
+// Minimal oneVPL runtime used by the dispatcher benchmarks.
+// Reports one software implementation which decodes AVC and HEVC to system
+// memory, and creates sessions which do nothing. The benchmark copies this
+// library once per fake implementation, so the dispatcher sees each copy as
+// a separate runtime.
+
+#include <string.h>
+
+#include "vpl/mfxdispatcher.h"
+#include "vpl/mfximplcaps.h"
+#include "vpl/mfxvideo.h"
+
+#if defined(_WIN32) || defined(_WIN64)
+    #define STUB_EXPORT extern "C" __declspec(dllexport)
+#else
+    #define STUB_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+namespace {
+
+struct StubSession {
+    mfxU32 reserved;
+};
+
+mfxU32 g_colorFormats[] = { MFX_FOURCC_NV12, MFX_FOURCC_I420 };
+
+mfxDecoderDescription::decoder::decprofile::decmemdesc g_decMemDesc = {
+    MFX_RESOURCE_SYSTEM_SURFACE, // MemHandleType
+    { 64, 4096, 16 },            // Width
+    { 64, 4096, 16 },            // Height
+    {},                          // reserved
+    2,                           // NumColorFormats
+    g_colorFormats,              // ColorFormats
+};
+
+mfxDecoderDescription::decoder::decprofile g_decProfiles[] = {
+    { MFX_PROFILE_AVC_MAIN, {}, 1, &g_decMemDesc },
+    { MFX_PROFILE_HEVC_MAIN, {}, 1, &g_decMemDesc },
+};
+
+mfxDecoderDescription::decoder g_decoders[] = {
+    { MFX_CODEC_AVC, {}, MFX_LEVEL_AVC_52, 1, &g_decProfiles[0] },
+    { MFX_CODEC_HEVC, {}, MFX_LEVEL_HEVC_51, 1, &g_decProfiles[1] },
+};
+
+mfxAccelerationMode g_accelModes[] = { MFX_ACCEL_MODE_NA };
+
+const mfxChar* g_functionNames[] = {
+    "MFXInitialize",
+    "MFXClose",
+    "MFXQueryIMPL",
+    "MFXQueryVersion",
+};
+
+mfxImplementedFunctions g_implFunctions = {
+    sizeof(g_functionNames) / sizeof(g_functionNames[0]),
+    (mfxChar**)g_functionNames,
+};
+
+mfxImplDescription MakeImplDescription() {
+    mfxImplDescription desc = {};
+
+    desc.Version.Version  = MFX_IMPLDESCRIPTION_VERSION;
+    desc.Impl             = MFX_IMPL_TYPE_SOFTWARE;
+    desc.AccelerationMode = MFX_ACCEL_MODE_NA;
+    desc.ApiVersion.Major = 2;
+    desc.ApiVersion.Minor = 0;
+    desc.VendorID         = 0x8086;
+    desc.VendorImplID     = 0;
+
+    strncpy(desc.ImplName, "dispatcher benchmark stub", sizeof(desc.ImplName) - 1);
+    strncpy(desc.License, "MIT", sizeof(desc.License) - 1);
+    strncpy(desc.Keywords, "benchmark,stub", sizeof(desc.Keywords) - 1);
+
+    desc.AccelerationModeDescription.Version.Version      = MFX_ACCELERATIONMODESCRIPTION_VERSION;
+    desc.AccelerationModeDescription.NumAccelerationModes = 1;
+    desc.AccelerationModeDescription.Mode                 = g_accelModes;
+
+    desc.Dev.Version.Version = MFX_DEVICEDESCRIPTION_VERSION;
+    strncpy(desc.Dev.DeviceID, "0000", sizeof(desc.Dev.DeviceID) - 1);
+
+    desc.Dec.Version.Version = MFX_DECODERDESCRIPTION_VERSION;
+    desc.Dec.NumCodecs       = sizeof(g_decoders) / sizeof(g_decoders[0]);
+    desc.Dec.Codecs          = g_decoders;
+
+    return desc;
+}
+
+mfxImplDescription g_implDesc = MakeImplDescription();
+
+// arrays returned by MFXQueryImplsDescription() are static, so release has nothing to free
+mfxHDL g_implDescHandles[]  = { &g_implDesc };
+mfxHDL g_implFuncsHandles[] = { &g_implFunctions };
+
+} // namespace
+
+STUB_EXPORT mfxHDL* MFXQueryImplsDescription(mfxImplCapsDeliveryFormat format, mfxU32* num_impls) {
+    if (!num_impls)
+        return nullptr;
+
+    *num_impls = 1;
+
+    switch (format) {
+        case MFX_IMPLCAPS_IMPLDESCSTRUCTURE:
+            return g_implDescHandles;
+        case MFX_IMPLCAPS_IMPLEMENTEDFUNCTIONS:
+            return g_implFuncsHandles;
+        default:
+            *num_impls = 0;
+            return nullptr;
+    }
+}
+
+STUB_EXPORT mfxStatus MFXReleaseImplDescription(mfxHDL hdl) {
+    return hdl ? MFX_ERR_NONE : MFX_ERR_NULL_PTR;
+}
+
+STUB_EXPORT mfxStatus MFXInitialize(mfxInitializationParam par, mfxSession* session) {
+    if (!session)
+        return MFX_ERR_NULL_PTR;
+
+    if (par.AccelerationMode != MFX_ACCEL_MODE_NA)
+        return MFX_ERR_UNSUPPORTED;
+
+    *session = (mfxSession) new StubSession{};
+
+    return MFX_ERR_NONE;
+}
+
+STUB_EXPORT mfxStatus MFXInitEx(mfxInitParam par, mfxSession* session) {
+    if (!session)
+        return MFX_ERR_NULL_PTR;
+
+    *session = (mfxSession) new StubSession{};
+
+    return MFX_ERR_NONE;
+}
+
+STUB_EXPORT mfxStatus MFXClose(mfxSession session) {
+    if (!session)
+        return MFX_ERR_INVALID_HANDLE;
+
+    delete (StubSession*)session;
+
+    return MFX_ERR_NONE;
+}
+
+STUB_EXPORT mfxStatus MFXQueryIMPL(mfxSession session, mfxIMPL* impl) {
+    if (!session || !impl)
+        return MFX_ERR_NULL_PTR;
+
+    *impl = MFX_IMPL_SOFTWARE;
+
+    return MFX_ERR_NONE;
+}
+
+STUB_EXPORT mfxStatus MFXQueryVersion(mfxSession session, mfxVersion* version) {
+    if (!session || !version)
+        return MFX_ERR_NULL_PTR;
+
+    version->Major = 2;
+    version->Minor = 0;
+
+    return MFX_ERR_NONE;
+}
+
+STUB_EXPORT mfxStatus MFXMemory_GetSurfaceForVPP(mfxSession session, mfxFrameSurface1** surface) {
+    return MFX_ERR_UNSUPPORTED;
+}
+
+STUB_EXPORT mfxStatus MFXMemory_GetSurfaceForEncode(mfxSession session,
+                                                    mfxFrameSurface1** surface) {
+    return MFX_ERR_UNSUPPORTED;
+}
+
+STUB_EXPORT mfxStatus MFXMemory_GetSurfaceForDecode(mfxSession session,
+                                                    mfxFrameSurface1** surface) {
+    return MFX_ERR_UNSUPPORTED;
+}
+
+// remaining functions which the dispatcher requires a runtime to export,
+//   never called by the benchmarks
+#define STUB_FUNCTION(func_name, formal_param_list)  \
+    STUB_EXPORT mfxStatus func_name formal_param_list { \
+        return MFX_ERR_UNSUPPORTED;                     \
+    }
+
+STUB_FUNCTION(MFXInit, (mfxIMPL impl, mfxVersion* ver, mfxSession* session))
+STUB_FUNCTION(MFXJoinSession, (mfxSession session, mfxSession child))
+STUB_FUNCTION(MFXVideoCORE_SetFrameAllocator, (mfxSession session, mfxFrameAllocator* allocator))
+STUB_FUNCTION(MFXVideoCORE_SetHandle, (mfxSession session, mfxHandleType type, mfxHDL hdl))
+STUB_FUNCTION(MFXVideoCORE_GetHandle, (mfxSession session, mfxHandleType type, mfxHDL* hdl))
+STUB_FUNCTION(MFXVideoCORE_SyncOperation, (mfxSession session, mfxSyncPoint syncp, mfxU32 wait))
+STUB_FUNCTION(MFXVideoENCODE_Query, (mfxSession session, mfxVideoParam* in, mfxVideoParam* out))
+STUB_FUNCTION(MFXVideoENCODE_QueryIOSurf,
+              (mfxSession session, mfxVideoParam* par, mfxFrameAllocRequest* request))
+STUB_FUNCTION(MFXVideoENCODE_Init, (mfxSession session, mfxVideoParam* par))
+STUB_FUNCTION(MFXVideoENCODE_Reset, (mfxSession session, mfxVideoParam* par))
+STUB_FUNCTION(MFXVideoENCODE_Close, (mfxSession session))
+STUB_FUNCTION(MFXVideoENCODE_GetVideoParam, (mfxSession session, mfxVideoParam* par))
+STUB_FUNCTION(MFXVideoENCODE_GetEncodeStat, (mfxSession session, mfxEncodeStat* stat))
+STUB_FUNCTION(MFXVideoENCODE_EncodeFrameAsync,
+              (mfxSession session,
+               mfxEncodeCtrl* ctrl,
+               mfxFrameSurface1* surface,
+               mfxBitstream* bs,
+               mfxSyncPoint* syncp))
+STUB_FUNCTION(MFXVideoDECODE_Query, (mfxSession session, mfxVideoParam* in, mfxVideoParam* out))
+STUB_FUNCTION(MFXVideoDECODE_DecodeHeader,
+              (mfxSession session, mfxBitstream* bs, mfxVideoParam* par))
+STUB_FUNCTION(MFXVideoDECODE_QueryIOSurf,
+              (mfxSession session, mfxVideoParam* par, mfxFrameAllocRequest* request))
+STUB_FUNCTION(MFXVideoDECODE_Init, (mfxSession session, mfxVideoParam* par))
+STUB_FUNCTION(MFXVideoDECODE_Reset, (mfxSession session, mfxVideoParam* par))
+STUB_FUNCTION(MFXVideoDECODE_Close, (mfxSession session))
+STUB_FUNCTION(MFXVideoDECODE_GetVideoParam, (mfxSession session, mfxVideoParam* par))
+STUB_FUNCTION(MFXVideoDECODE_GetDecodeStat, (mfxSession session, mfxDecodeStat* stat))
+STUB_FUNCTION(MFXVideoDECODE_SetSkipMode, (mfxSession session, mfxSkipMode mode))
+STUB_FUNCTION(MFXVideoDECODE_GetPayload, (mfxSession session, mfxU64* ts, mfxPayload* payload))
+STUB_FUNCTION(MFXVideoDECODE_DecodeFrameAsync,
+              (mfxSession session,
+               mfxBitstream* bs,
+               mfxFrameSurface1* surface_work,
+               mfxFrameSurface1** surface_out,
+               mfxSyncPoint* syncp))
+STUB_FUNCTION(MFXVideoVPP_Query, (mfxSession session, mfxVideoParam* in, mfxVideoParam* out))
+STUB_FUNCTION(MFXVideoVPP_QueryIOSurf,
+              (mfxSession session, mfxVideoParam* par, mfxFrameAllocRequest* request))
+STUB_FUNCTION(MFXVideoVPP_Init, (mfxSession session, mfxVideoParam* par))
+STUB_FUNCTION(MFXVideoVPP_Reset, (mfxSession session, mfxVideoParam* par))
+STUB_FUNCTION(MFXVideoVPP_Close, (mfxSession session))
+STUB_FUNCTION(MFXVideoVPP_GetVideoParam, (mfxSession session, mfxVideoParam* par))
+STUB_FUNCTION(MFXVideoVPP_GetVPPStat, (mfxSession session, mfxVPPStat* stat))
+STUB_FUNCTION(MFXVideoVPP_RunFrameVPPAsync,
+              (mfxSession session,
+               mfxFrameSurface1* in,
+               mfxFrameSurface1* out,
+               mfxExtVppAuxData* aux,
+               mfxSyncPoint* syncp))
+STUB_FUNCTION(MFXDisjoinSession, (mfxSession session))
+STUB_FUNCTION(MFXSetPriority, (mfxSession session, mfxPriority priority))
+STUB_FUNCTION(MFXGetPriority, (mfxSession session, mfxPriority* priority))
+STUB_FUNCTION(MFXVideoCORE_QueryPlatform, (mfxSession session, mfxPlatform* platform))
+
+#undef STUB_FUNCTION
@@ -0,0 +1,197 @@
+/*############################################################################
+  # Copyright (C) Intel Corporation
+  #
+  # SPDX-License-Identifier: MIT
+  ############################################################################*/
+
+#ifndef __MFXDISPATCHEREXT_H__
+#define __MFXDISPATCHEREXT_H__
+
+#include "vpl/mfxdispatcher.h"
+
+/* Dispatcher extensions (not part of spec). */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! Flags for MFXDispCreateSessions. */
+enum {
+    MFX_DISP_SESSIONS_JOIN = 0x0001, /*!< Join sessions 1..N-1 to sessions[0] with MFXJoinSession. */
+};
+
+/*! Called by MFXDispLoadAsync() when discovery of implementations has finished. */
+typedef void(MFX_CDECL* mfxDispLoadCallback)(mfxLoader loader, mfxStatus sts, mfxHDL userData);
+
+/*!
+   @brief
+      Creates the loader like MFXLoad(), but searches for and queries the runtime libraries
+      on a background thread, and returns without waiting for it.
+
+      MFXEnumImplementations(), MFXCreateSession() and the other functions which need the list
+      of implementations or create sessions wait until discovery has finished.
+      MFXCreateConfig() and MFXSetConfigFilterProperty() do not wait. Filters set before
+      discovery has finished are stored and take effect when it completes, before any
+      waiting function returns.
+
+      When discovery has finished, callback (if not NULL) is called on the background thread
+      with the status of discovery: MFX_ERR_NONE if at least one implementation was found,
+      otherwise an error such as MFX_ERR_NOT_FOUND. Unlike MFXLoad(), the loader is returned
+      even if no implementations are found. Functions which need implementations then
+      return MFX_ERR_NOT_FOUND. The callback may call any function with this loader,
+      including MFXUnload().
+
+      MFXUnload() waits for discovery to finish.
+
+   @param[in] callback Function called when discovery has finished. Can be NULL.
+   @param[in] userData Passed to callback.
+   @return
+      Loader handle or NULL if failed.
+*/
+mfxLoader MFX_CDECL MFXDispLoadAsync(mfxDispLoadCallback callback, mfxHDL userData);
+
+/*!
+   @brief
+      Creates numSessions sessions on the implementation with index i.
+
+      Equivalent to calling MFXCreateSession() numSessions times, but the implementation
+      is looked up and the runtime library is loaded only once. All sessions share the
+      resolved function table and the device handle set with mfxHandleType/mfxHDL config
+      properties, if any.
+
+      If MFX_DISP_SESSIONS_JOIN is set, sessions[1] through sessions[numSessions-1] are joined
+      to sessions[0] as child sessions. sessions[0] is the parent session and must be closed
+      last: the application must disjoin and close the child sessions before closing
+      sessions[0].
+
+   @param[in] loader      Loader handle.
+   @param[in] i           Index of the implementation.
+   @param[in] numSessions Number of sessions to create.
+   @param[out] sessions   Array of numSessions session handles.
+   @param[in] flags       Bitwise OR of MFX_DISP_SESSIONS_* flags, or 0.
+   @return
+      MFX_ERR_NONE        The function completed successfully. sessions contains numSessions session handles.\n
+      MFX_ERR_NULL_PTR    If loader or sessions is NULL. \n
+      MFX_ERR_NOT_FOUND   Provided index is out of possible range. \n
+      MFX_ERR_UNSUPPORTED If numSessions is 0. \n
+      Any error returned by the runtime. On failure all sessions created by this call are closed
+      and every element of sessions is set to NULL.
+*/
+mfxStatus MFX_CDECL MFXDispCreateSessions(mfxLoader loader,
+                                          mfxU32 i,
+                                          mfxU32 numSessions,
+                                          mfxSession* sessions,
+                                          mfxU32 flags);
+
+/*!
+   @brief
+      Gets a session with implementation index i from the loader's session pool.
+
+      If the pool holds an idle session for this implementation and the current
+      mfxAccelerationMode config property, it is returned without re-initializing the runtime.
+      Otherwise a new session is created as with MFXCreateSession().
+      The session must be returned with MFXDispReleaseSession() instead of MFXClose().
+
+   @param[in] loader   Loader handle.
+   @param[in] i        Index of the implementation.
+   @param[out] session Pointer to the session handle.
+   @return
+      MFX_ERR_NONE        The function completed successfully. \n
+      MFX_ERR_NULL_PTR    If loader or session is NULL. \n
+      MFX_ERR_NOT_FOUND   Provided index is out of possible range.
+*/
+mfxStatus MFX_CDECL MFXDispAcquireSession(mfxLoader loader, mfxU32 i, mfxSession* session);
+
+/*!
+   @brief
+      Returns a session obtained with MFXDispAcquireSession() to the session pool.
+
+      DECODE, ENCODE and VPP are closed on the session before it is pooled. The application
+      must disjoin the session from any other session first. If the pool already holds the
+      maximum number of idle sessions for this implementation, the session is closed.
+      All pooled sessions are closed by MFXUnload().
+
+   @param[in] loader  Loader handle.
+   @param[in] session Session handle.
+   @return
+      MFX_ERR_NONE           The function completed successfully. \n
+      MFX_ERR_NULL_PTR       If loader or session is NULL. \n
+      MFX_ERR_INVALID_HANDLE Session was not obtained from this loader with MFXDispAcquireSession().
+*/
+mfxStatus MFX_CDECL MFXDispReleaseSession(mfxLoader loader, mfxSession session);
+
+/*!
+   @brief
+      Sets the limits of the loader's session pool.
+
+      Defaults are 4 idle sessions per implementation and a 30000 ms idle timeout, or the values
+      of the ONEVPL_SESSION_POOL_MAX_IDLE and ONEVPL_SESSION_POOL_IDLE_MS environment variables.
+      Idle sessions are closed on the next acquire or release after the timeout expires.
+
+   @param[in] loader        Loader handle.
+   @param[in] maxIdle       Maximum number of idle sessions kept per implementation. 0 disables pooling.
+   @param[in] idleTimeoutMs Close sessions which have been idle for this many ms. 0 means no timeout.
+   @return
+      MFX_ERR_NONE           The function completed successfully. \n
+      MFX_ERR_NULL_PTR       If loader is NULL.
+*/
+mfxStatus MFX_CDECL MFXDispSetSessionPoolParams(mfxLoader loader,
+                                                mfxU32 maxIdle,
+                                                mfxU32 idleTimeoutMs);
+
+/*!
+   @brief
+      Gets the time spent in each phase of the loader as JSON text.
+
+      Timing is recorded only if the ONEVPL_TIMING environment variable is set to 1, or
+      ONEVPL_TIMING_FILE is set to the name of a file which receives the same JSON text on
+      MFXUnload(). Results are reported per phase and, where applicable, per library:
+      { "phases": [ { "phase": "load_lib", "lib": "<path>", "count": 1, "total_us": 12.3, "max_us": 12.3 }, ... ] }
+
+      Phases: dir_scan, load_lib, resolve_exports, query_impls, msdk_probe, filter_validation,
+      init_session.
+
+   @param[in] loader     Loader handle.
+   @param[out] buffer    Buffer which receives null-terminated JSON text. Can be NULL to query the size.
+   @param[in,out] size   In: size of buffer in bytes. Out: required size in bytes, including null terminator.
+   @return
+      MFX_ERR_NONE              The function completed successfully. \n
+      MFX_ERR_NULL_PTR          If loader or size is NULL. \n
+      MFX_ERR_NOT_ENOUGH_BUFFER If buffer is NULL or too small. size is set to the required size. \n
+      MFX_ERR_UNSUPPORTED       Timing is not enabled.
+*/
+mfxStatus MFX_CDECL MFXDispQueryTiming(mfxLoader loader, mfxChar* buffer, mfxU32* size);
+
+/*!
+   @brief
+      Gets call counts and latency histograms of the functions passed through to the runtime,
+      as JSON text.
+
+      Statistics are recorded for all sessions in the process, only if the ONEVPL_CALL_STATS
+      environment variable is set to 1, or ONEVPL_CALL_STATS_FILE is set to the name of a file
+      which receives the same JSON text once, when the process exits normally.
+      Each thread records into its own buffer; buffers are summed when this function is called.
+      Only functions which were called, and only non-empty histogram buckets, are reported:
+      { "functions": [ { "name": "MFXVideoCORE_SyncOperation", "count": 10, "total_us": 123.4, "max_us": 45.6,
+                         "hist": [ { "lt_ns": 16384, "count": 10 }, ... ] }, ... ] }
+
+      Bucket lt_ns counts calls which took at least lt_ns/2 and less than lt_ns nanoseconds.
+      The last bucket has lt_ns 0 and no upper bound.
+
+      Statistics are only recorded by the dispatcher for Linux.
+
+   @param[out] buffer    Buffer which receives null-terminated JSON text. Can be NULL to query the size.
+   @param[in,out] size   In: size of buffer in bytes. Out: required size in bytes, including null terminator.
+   @return
+      MFX_ERR_NONE              The function completed successfully. \n
+      MFX_ERR_NULL_PTR          If size is NULL. \n
+      MFX_ERR_NOT_ENOUGH_BUFFER If buffer is NULL or too small. size is set to the required size. \n
+      MFX_ERR_UNSUPPORTED       Call statistics are not enabled, or not supported on this platform.
+*/
+mfxStatus MFX_CDECL MFXDispQueryCallStats(mfxChar* buffer, mfxU32* size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -6,20 +6,28 @@
 
 #include <assert.h>
 #include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <list>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <utility>
 #include <vector>
 
+#include "vpl/mfxdispatcherext.h"
 #include "vpl/mfxvideo.h"
 
 #include "linux/device_ids.h"
 #include "linux/mfxloader.h"
+#include "vpl/mfx_dispatcher_vpl.h"
 
 namespace MFX {
 
@@ -115,12 +123,22 @@ static const FunctionsTable2 g_mfxFuncTable2[] = {
     { eMFXVideoVPP_ProcessFrameAsync, "MFXVideoVPP_ProcessFrameAsync", VERSION(2, 1) },
 };
 
+// runtime library handle along with all exported functions
+// resolved once and shared by every session created with the same library
+struct LoaderModule {
+    std::shared_ptr<void> dlh;
+    mfxU16 deviceID = 0;
+    void* table[eFunctionsNum]{};
+    void* table2[eFunctionsNum2]{};
+};
+
 class LoaderCtx {
 public:
     mfxStatus Init(mfxInitParam& par,
                    mfxInitializationParam& vplParam,
                    mfxU16* pDeviceID,
-                   char* dllName);
+                   char* dllName,
+                   std::shared_ptr<void>* libModule = nullptr);
     mfxStatus Close();
 
     inline void* getFunction(Function func) const {
@@ -143,8 +161,13 @@ public:
         return m_version;
     }
 
+    inline void setSessionRef(std::shared_ptr<void> sessionRef) {
+        m_sessionRef = std::move(sessionRef);
+    }
+
 private:
-    std::shared_ptr<void> m_dlh;
+    std::shared_ptr<LoaderModule> m_module;
+    std::shared_ptr<void> m_sessionRef; // released when the session is freed
     mfxVersion m_version{};
     mfxIMPL m_implementation{};
     mfxSession m_session = nullptr;
@@ -159,31 +182,73 @@ std::shared_ptr<void> make_dlopen(const char* filename, int flags) {
     });
 }
 
+// load library and resolve all functions, missing functions are left as nullptr
+// and checked against the requested API version in LoaderCtx::Init()
+std::shared_ptr<LoaderModule> make_module(const char* filename) {
+    std::shared_ptr<void> hdl = make_dlopen(filename, RTLD_LOCAL | RTLD_NOW);
+    if (!hdl)
+        return nullptr;
+
+    std::shared_ptr<LoaderModule> module = std::make_shared<LoaderModule>();
+    module->dlh                          = std::move(hdl);
+
+    for (int i = 0; i < eFunctionsNum; ++i) {
+        assert(i == g_mfxFuncTable[i].id);
+        module->table[i] = dlsym(module->dlh.get(), g_mfxFuncTable[i].name);
+    }
+
+    for (int i = 0; i < eFunctionsNum2; ++i) {
+        assert(i == g_mfxFuncTable2[i].id);
+        module->table2[i] = dlsym(module->dlh.get(), g_mfxFuncTable2[i].name);
+    }
+
+    return module;
+}
+
+// if libModule is not null, the module (library handle + function tables) is reused
+//   if already set, otherwise it is set to the newly loaded module on success
+// libModule is only used when loading a specific DLL (dllName != nullptr)
+// libModule may be shared by threads creating sessions concurrently, so it is
+//   only accessed with std::atomic_load/atomic_compare_exchange
 mfxStatus LoaderCtx::Init(mfxInitParam& par,
                           mfxInitializationParam& vplParam,
                           mfxU16* pDeviceID,
-                          char* dllName) {
+                          char* dllName,
+                          std::shared_ptr<void>* libModule) {
     mfxStatus mfx_res = MFX_ERR_NONE;
 
     std::vector<std::string> libs;
     std::vector<Device> devices;
-    eMFXHWType platform;
+    eMFXHWType platform = MFX_HW_UNKNOWN;
+
+    if (!dllName)
+        libModule = nullptr;
+
+    std::shared_ptr<LoaderModule> sharedModule;
+    if (libModule)
+        sharedModule = std::static_pointer_cast<LoaderModule>(std::atomic_load(libModule));
 
     // query graphics device_id
     // if it is found on list of legacy devices, load MSDK RT
     // otherwise load oneVPL RT
+    // if reusing a module, device_id was already queried when it was loaded
     mfxU16 deviceID = 0;
-    mfx_res         = get_devices(devices);
-    if (mfx_res == MFX_ERR_NOT_FOUND) {
-        // query failed
-        platform = MFX_HW_UNKNOWN;
+    if (sharedModule) {
+        deviceID = sharedModule->deviceID;
     }
     else {
-        // query succeeded:
-        //   may be a valid platform from listLegalDevIDs[] or MFX_HW_UNKNOWN
-        //   if underlying device_id is unrecognized (i.e. new platform)
-        platform = devices[0].platform;
-        deviceID = devices[0].device_id;
+        mfx_res = get_devices(devices);
+        if (mfx_res == MFX_ERR_NOT_FOUND) {
+            // query failed
+            platform = MFX_HW_UNKNOWN;
+        }
+        else {
+            // query succeeded:
+            //   may be a valid platform from listLegalDevIDs[] or MFX_HW_UNKNOWN
+            //   if underlying device_id is unrecognized (i.e. new platform)
+            platform = devices[0].platform;
+            deviceID = devices[0].device_id;
+        }
     }
 
     if (pDeviceID)
@@ -223,14 +288,15 @@ mfxStatus LoaderCtx::Init(mfxInitParam& par,
     mfx_res = MFX_ERR_UNSUPPORTED;
 
     for (auto& lib : libs) {
-        std::shared_ptr<void> hdl = make_dlopen(lib.c_str(), RTLD_LOCAL | RTLD_NOW);
-        if (hdl) {
+        std::shared_ptr<LoaderModule> module =
+            sharedModule ? sharedModule : make_module(lib.c_str());
+
+        if (module) {
             do {
                 /* Loading functions table */
                 bool wrong_version = false;
                 for (int i = 0; i < eFunctionsNum; ++i) {
-                    assert(i == g_mfxFuncTable[i].id);
-                    m_table[i] = dlsym(hdl.get(), g_mfxFuncTable[i].name);
+                    m_table[i] = module->table[i];
                     if (!m_table[i] && ((g_mfxFuncTable[i].version <= par.Version))) {
                         wrong_version = true;
                         break;
@@ -240,8 +306,7 @@ mfxStatus LoaderCtx::Init(mfxInitParam& par,
                 // if version >= 2.0, load these functions as well
                 if (par.Version.Major >= 2) {
                     for (int i = 0; i < eFunctionsNum2; ++i) {
-                        assert(i == g_mfxFuncTable2[i].id);
-                        m_table2[i] = dlsym(hdl.get(), g_mfxFuncTable2[i].name);
+                        m_table2[i] = module->table2[i];
                         if (!m_table2[i] && (g_mfxFuncTable2[i].version <= par.Version)) {
                             wrong_version = true;
                             break;
@@ -298,7 +363,15 @@ mfxStatus LoaderCtx::Init(mfxInitParam& par,
             } while (false);
 
             if (MFX_ERR_NONE == mfx_res) {
-                m_dlh = std::move(hdl);
+                if (libModule && module != sharedModule) {
+                    // if another thread got there first, keep its module for later sessions
+                    std::shared_ptr<void> noModule;
+                    module->deviceID = deviceID;
+                    std::atomic_compare_exchange_strong(libModule,
+                                                        &noModule,
+                                                        std::shared_ptr<void>(module));
+                }
+                m_module = std::move(module);
                 break;
             }
             else {
@@ -318,19 +391,418 @@ mfxStatus LoaderCtx::Close() {
     m_version        = {};
     m_session        = nullptr;
     std::fill(std::begin(m_table), std::end(m_table), nullptr);
+    std::fill(std::begin(m_table2), std::end(m_table2), nullptr);
     return mfx_res;
 }
 
+// per-call statistics of functions passed through to the runtime
+// enabled with ONEVPL_CALL_STATS=1, or ONEVPL_CALL_STATS_FILE=<file> which is
+//   written with the results once, at process exit
+#define ENV_ONEVPL_CALL_STATS      "ONEVPL_CALL_STATS"
+#define ENV_ONEVPL_CALL_STATS_FILE "ONEVPL_CALL_STATS_FILE"
+
+// functions from both tables share one index space: Function, then Function2
+enum { eCallStatsNum = eFunctionsNum + eFunctionsNum2 };
+
+// bucket i counts calls which took [2^i, 2^(i+1)) ns, the last bucket has no upper bound
+#define CALL_STATS_NUM_BUCKETS 32
+
+// each thread records into its own buffer, so updates need no locking or atomic RMW
+// values are atomic only so that GetJSON() can read them while the owner is writing
+struct CallStatsBuffer {
+    std::atomic<mfxU64> count[eCallStatsNum];
+    std::atomic<mfxU64> totalNs[eCallStatsNum];
+    std::atomic<mfxU64> maxNs[eCallStatsNum];
+    std::atomic<mfxU64> hist[eCallStatsNum][CALL_STATS_NUM_BUCKETS];
+};
+
+class CallStats {
+public:
+    // never destroyed - threads may exit after static destructors have run
+    static CallStats& Get() {
+        static CallStats* stats = new CallStats();
+        return *stats;
+    }
+
+    inline bool IsEnabled() const {
+        return m_bEnabled;
+    }
+
+    void AddSample(mfxU32 func, mfxU64 ns);
+    std::string GetJSON();
+    void DumpJSON();
+
+    // called from the destructor of the thread_local owner of buf
+    void RetireBuffer(CallStatsBuffer* buf);
+
+private:
+    CallStats();
+
+    CallStatsBuffer* GetThreadBuffer();
+
+    bool m_bEnabled;
+    std::string m_dumpFile;
+
+    // protects m_threadBuffers and m_retired, not taken when recording a sample
+    std::mutex m_mutex;
+    std::vector<CallStatsBuffer*> m_threadBuffers;
+
+    // sum of buffers from threads which have exited
+    CallStatsBuffer m_retired;
+};
+
+// owns the calling thread's buffer, allocated on its first recorded call
+struct CallStatsThreadBuffer {
+    CallStatsBuffer* buf = nullptr;
+
+    ~CallStatsThreadBuffer() {
+        if (buf)
+            CallStats::Get().RetireBuffer(buf);
+    }
+};
+
+static thread_local CallStatsThreadBuffer t_callStatsBuffer;
+
+static const char* GetCallName(mfxU32 func) {
+    return (func < eFunctionsNum) ? g_mfxFuncTable[func].name
+                                  : g_mfxFuncTable2[func - eFunctionsNum].name;
+}
+
+static void DumpCallStatsAtExit() {
+    CallStats::Get().DumpJSON();
+}
+
+static inline void AddRelaxed(std::atomic<mfxU64>& val, mfxU64 n) {
+    val.store(val.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+CallStats::CallStats()
+        : m_bEnabled(false),
+          m_dumpFile(),
+          m_mutex(),
+          m_threadBuffers(),
+          m_retired() {
+    mfxU32 callStats = 0;
+    if (GetEnvVarU32(ENV_ONEVPL_CALL_STATS, &callStats))
+        m_bEnabled = (callStats != 0);
+
+    const char* envVar = getenv(ENV_ONEVPL_CALL_STATS_FILE);
+    if (envVar && *envVar) {
+        m_dumpFile = envVar;
+        m_bEnabled = true;
+        atexit(DumpCallStatsAtExit);
+    }
+}
+
+CallStatsBuffer* CallStats::GetThreadBuffer() {
+    if (!t_callStatsBuffer.buf) {
+        // value-initialize so that all counters start at zero
+        CallStatsBuffer* buf = new CallStatsBuffer();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_threadBuffers.push_back(buf);
+        t_callStatsBuffer.buf = buf;
+    }
+
+    return t_callStatsBuffer.buf;
+}
+
+void CallStats::AddSample(mfxU32 func, mfxU64 ns) {
+    CallStatsBuffer* buf = GetThreadBuffer();
+
+    mfxU32 bucket = 0;
+    if (ns > 1)
+        bucket = std::min(63 - __builtin_clzll(ns), CALL_STATS_NUM_BUCKETS - 1);
+
+    AddRelaxed(buf->count[func], 1);
+    AddRelaxed(buf->totalNs[func], ns);
+    AddRelaxed(buf->hist[func][bucket], 1);
+    if (ns > buf->maxNs[func].load(std::memory_order_relaxed))
+        buf->maxNs[func].store(ns, std::memory_order_relaxed);
+}
+
+// must be called with m_mutex held, dst is only written by this thread
+static void MergeCallStats(CallStatsBuffer* dst, const CallStatsBuffer* src) {
+    for (mfxU32 i = 0; i < eCallStatsNum; i++) {
+        AddRelaxed(dst->count[i], src->count[i].load(std::memory_order_relaxed));
+        AddRelaxed(dst->totalNs[i], src->totalNs[i].load(std::memory_order_relaxed));
+
+        mfxU64 maxNs = src->maxNs[i].load(std::memory_order_relaxed);
+        if (maxNs > dst->maxNs[i].load(std::memory_order_relaxed))
+            dst->maxNs[i].store(maxNs, std::memory_order_relaxed);
+
+        for (mfxU32 j = 0; j < CALL_STATS_NUM_BUCKETS; j++)
+            AddRelaxed(dst->hist[i][j], src->hist[i][j].load(std::memory_order_relaxed));
+    }
+}
+
+void CallStats::RetireBuffer(CallStatsBuffer* buf) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    MergeCallStats(&m_retired, buf);
+
+    m_threadBuffers.erase(std::remove(m_threadBuffers.begin(), m_threadBuffers.end(), buf),
+                          m_threadBuffers.end());
+    delete buf;
+}
+
+// format:
+// { "functions": [ { "name": "MFXVideoCORE_SyncOperation", "count": 10,
+//                    "total_us": 123.4, "max_us": 45.6,
+//                    "hist": [ { "lt_ns": 2048, "count": 3 }, ... ] }, ... ] }
+// only functions which were called are listed, only non-empty buckets are listed
+// for the last bucket lt_ns is 0 (no upper bound)
+std::string CallStats::GetJSON() {
+    std::unique_ptr<CallStatsBuffer> total(new CallStatsBuffer());
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        MergeCallStats(total.get(), &m_retired);
+        for (CallStatsBuffer* buf : m_threadBuffers)
+            MergeCallStats(total.get(), buf);
+    }
+
+    std::string json = "{\"functions\":[";
+    char buf[256];
+
+    bool bFirst = true;
+    for (mfxU32 i = 0; i < eCallStatsNum; i++) {
+        mfxU64 count = total->count[i].load(std::memory_order_relaxed);
+        if (!count)
+            continue;
+
+        snprintf(buf,
+                 sizeof(buf),
+                 "%s{\"name\":\"%s\",\"count\":%llu,\"total_us\":%.1f,\"max_us\":%.1f,\"hist\":[",
+                 bFirst ? "" : ",",
+                 GetCallName(i),
+                 (unsigned long long)count,
+                 total->totalNs[i].load(std::memory_order_relaxed) / 1000.0,
+                 total->maxNs[i].load(std::memory_order_relaxed) / 1000.0);
+        json += buf;
+
+        bool bFirstBucket = true;
+        for (mfxU32 j = 0; j < CALL_STATS_NUM_BUCKETS; j++) {
+            mfxU64 bucketCount = total->hist[i][j].load(std::memory_order_relaxed);
+            if (!bucketCount)
+                continue;
+
+            mfxU64 upperNs = (j == CALL_STATS_NUM_BUCKETS - 1) ? 0 : (2ULL << j);
+            snprintf(buf,
+                     sizeof(buf),
+                     "%s{\"lt_ns\":%llu,\"count\":%llu}",
+                     bFirstBucket ? "" : ",",
+                     (unsigned long long)upperNs,
+                     (unsigned long long)bucketCount);
+            json += buf;
+
+            bFirstBucket = false;
+        }
+
+        json += "]}";
+        bFirst = false;
+    }
+
+    json += "]}";
+
+    return json;
+}
+
+void CallStats::DumpJSON() {
+    if (!m_bEnabled || m_dumpFile.empty())
+        return;
+
+    std::string json = GetJSON();
+
+    FILE* fp = fopen(m_dumpFile.c_str(), "w");
+    if (!fp)
+        return;
+
+    fprintf(fp, "%s\n", json.c_str());
+    fclose(fp);
+}
+
+// trace of passthrough calls in Chrome Trace Event format (JSON array format),
+//   which can be opened with chrome://tracing or ui.perfetto.dev
+// enabled with ONEVPL_TRACE_FILE=<file>, the file is overwritten
+// each call is one complete event ("ph":"X") with the mfxSession handle seen by
+//   the application in args, and the OS thread ID as tid
+// events are buffered per thread and appended to the file when the buffer is full,
+//   when the thread exits, and when the thread calls MFXClose()
+// the closing ']' is optional in this format, so the file is valid at any time
+#define ENV_ONEVPL_TRACE_FILE "ONEVPL_TRACE_FILE"
+
+// flush thread buffer to the file when it reaches this size (bytes)
+#define CALL_TRACE_FLUSH_SIZE (64 * 1024)
+
+class CallTrace {
+public:
+    typedef std::chrono::steady_clock ClockType;
+
+    // never destroyed - threads may exit after static destructors have run
+    static CallTrace& Get() {
+        static CallTrace* trace = new CallTrace();
+        return *trace;
+    }
+
+    inline bool IsEnabled() const {
+        return m_fp != nullptr;
+    }
+
+    void AddEvent(mfxU32 func,
+                  mfxSession session,
+                  ClockType::time_point start,
+                  ClockType::time_point end);
+
+    // append the calling thread's events to the file
+    void Flush();
+
+    // called from the destructor of the thread_local owner of events
+    void Write(const std::string& events);
+
+private:
+    CallTrace();
+
+    FILE* m_fp;
+    std::mutex m_mutex;
+
+    // timestamps are relative to the first use of the dispatcher
+    ClockType::time_point m_startTime;
+    mfxU32 m_pid;
+};
+
+// owns the calling thread's pending events
+struct CallTraceThreadBuffer {
+    std::string events;
+    mfxU32 tid = 0;
+
+    ~CallTraceThreadBuffer() {
+        if (!events.empty())
+            CallTrace::Get().Write(events);
+    }
+};
+
+static thread_local CallTraceThreadBuffer t_callTraceBuffer;
+
+CallTrace::CallTrace() : m_fp(nullptr), m_mutex(), m_startTime(ClockType::now()), m_pid(0) {
+    const char* envVar = getenv(ENV_ONEVPL_TRACE_FILE);
+    if (!envVar || !(*envVar))
+        return;
+
+    m_fp = fopen(envVar, "w");
+    if (!m_fp)
+        return;
+
+    m_pid = (mfxU32)getpid();
+
+    fprintf(m_fp, "[\n");
+    fflush(m_fp);
+}
+
+void CallTrace::AddEvent(mfxU32 func,
+                         mfxSession session,
+                         ClockType::time_point start,
+                         ClockType::time_point end) {
+    CallTraceThreadBuffer& buf = t_callTraceBuffer;
+    if (!buf.tid)
+        buf.tid = (mfxU32)syscall(SYS_gettid);
+
+    // ts and dur are in microseconds
+    double ts  = std::chrono::duration<double, std::micro>(start - m_startTime).count();
+    double dur = std::chrono::duration<double, std::micro>(end - start).count();
+
+    char event[256];
+    snprintf(event,
+             sizeof(event),
+             "{\"name\":\"%s\",\"cat\":\"mfx\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+             "\"pid\":%u,\"tid\":%u,\"args\":{\"session\":\"%p\"}},\n",
+             GetCallName(func),
+             ts,
+             dur,
+             m_pid,
+             buf.tid,
+             (void*)session);
+    buf.events += event;
+
+    if (buf.events.size() >= CALL_TRACE_FLUSH_SIZE)
+        Flush();
+}
+
+void CallTrace::Flush() {
+    CallTraceThreadBuffer& buf = t_callTraceBuffer;
+    if (buf.events.empty())
+        return;
+
+    Write(buf.events);
+    buf.events.clear();
+}
+
+void CallTrace::Write(const std::string& events) {
+    if (!m_fp)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    fwrite(events.data(), 1, events.size(), m_fp);
+    fflush(m_fp);
+}
+
+// records one passthrough call made with session (the handle seen by the application),
+//   if call statistics or call tracing are enabled
+class CallTimer {
+public:
+    CallTimer(Function func, mfxSession session) : CallTimer((mfxU32)func, session) {}
+    CallTimer(Function2 func, mfxSession session)
+            : CallTimer((mfxU32)(eFunctionsNum + func), session) {}
+
+    ~CallTimer() {
+        if (!m_bActive)
+            return;
+
+        CallTrace::ClockType::time_point end = CallTrace::ClockType::now();
+
+        if (CallStats::Get().IsEnabled()) {
+            mfxU64 ns =
+                (mfxU64)std::chrono::duration_cast<std::chrono::nanoseconds>(end - m_start)
+                    .count();
+            CallStats::Get().AddSample(m_func, ns);
+        }
+
+        if (CallTrace::Get().IsEnabled())
+            CallTrace::Get().AddEvent(m_func, m_session, m_start, end);
+    }
+
+private:
+    CallTimer(mfxU32 func, mfxSession session)
+            : m_func(func),
+              m_session(session),
+              m_bActive(CallStats::Get().IsEnabled() || CallTrace::Get().IsEnabled()),
+              m_start() {
+        if (m_bActive)
+            m_start = CallTrace::ClockType::now();
+    }
+
+    mfxU32 m_func;
+    mfxSession m_session;
+    bool m_bActive;
+    CallTrace::ClockType::time_point m_start;
+};
+
 } // namespace MFX
 
 // internal function - load a specific DLL, return unsupported if it fails
 // vplParam is required for API >= 2.0 (load via MFXInitialize)
+// libModule is optional - see LoaderCtx::Init()
+// sessionRef is optional - held by the session until it is freed by MFXClose()
 mfxStatus MFXInitEx2(mfxVersion version,
                      mfxInitializationParam vplParam,
                      mfxIMPL hwImpl,
                      mfxSession* session,
                      mfxU16* deviceID,
-                     char* dllName) {
+                     char* dllName,
+                     std::shared_ptr<void>* libModule,
+                     std::shared_ptr<void> sessionRef) {
     if (!session)
         return MFX_ERR_NULL_PTR;
 
@@ -368,8 +840,9 @@ mfxStatus MFXInitEx2(mfxVersion version,
 
         loader.reset(new MFX::LoaderCtx{});
 
-        mfxStatus mfx_res = loader->Init(par, vplParam, deviceID, dllName);
+        mfxStatus mfx_res = loader->Init(par, vplParam, deviceID, dllName, libModule);
         if (MFX_ERR_NONE == mfx_res) {
+            loader->setSessionRef(std::move(sessionRef));
             *session = (mfxSession)loader.release();
         }
         else {
@@ -447,6 +920,10 @@ mfxStatus MFXClose(mfxSession session) {
             // Can't unload library in this case.
             loader.release();
         }
+
+        // write pending trace events of this thread (ONEVPL_TRACE_FILE)
+        MFX::CallTrace::Get().Flush();
+
         return mfx_res;
     }
     catch (...) {
@@ -467,6 +944,8 @@ mfxStatus MFXMemory_GetSurfaceForVPP(mfxSession session, mfxFrameSurface1** surf
         return MFX_ERR_INVALID_HANDLE;
     }
 
+    MFX::CallTimer callTimer(MFX::eMFXMemory_GetSurfaceForVPP, session);
+
     return (*proc)(loader->getSession(), surface);
 }
 
@@ -482,6 +961,8 @@ mfxStatus MFXMemory_GetSurfaceForVPPOut(mfxSession session, mfxFrameSurface1** s
         return MFX_ERR_INVALID_HANDLE;
     }
 
+    MFX::CallTimer callTimer(MFX::eMFXMemory_GetSurfaceForVPPOut, session);
+
     return (*proc)(loader->getSession(), surface);
 }
 
@@ -497,6 +978,8 @@ mfxStatus MFXMemory_GetSurfaceForEncode(mfxSession session, mfxFrameSurface1** s
         return MFX_ERR_INVALID_HANDLE;
     }
 
+    MFX::CallTimer callTimer(MFX::eMFXMemory_GetSurfaceForEncode, session);
+
     return (*proc)(loader->getSession(), surface);
 }
 
@@ -512,6 +995,8 @@ mfxStatus MFXMemory_GetSurfaceForDecode(mfxSession session, mfxFrameSurface1** s
         return MFX_ERR_INVALID_HANDLE;
     }
 
+    MFX::CallTimer callTimer(MFX::eMFXMemory_GetSurfaceForDecode, session);
+
     return (*proc)(loader->getSession(), surface);
 }
 
@@ -530,6 +1015,8 @@ mfxStatus MFXVideoDECODE_VPP_Init(mfxSession session,
         return MFX_ERR_INVALID_HANDLE;
     }
 
+    MFX::CallTimer callTimer(MFX::eMFXVideoDECODE_VPP_Init, session);
+
     return (*proc)(loader->getSession(), decode_par, vpp_par_array, num_vpp_par);
 }
 
@@ -549,6 +1036,8 @@ mfxStatus MFXVideoDECODE_VPP_DecodeFrameAsync(mfxSession session,
         return MFX_ERR_INVALID_HANDLE;
     }
 
+    MFX::CallTimer callTimer(MFX::eMFXVideoDECODE_VPP_DecodeFrameAsync, session);
+
     return (*proc)(loader->getSession(), bs, skip_channels, num_skip_channels, surf_array_out);
 }
 
@@ -567,6 +1056,8 @@ mfxStatus MFXVideoDECODE_VPP_Reset(mfxSession session,
         return MFX_ERR_INVALID_HANDLE;
     }
 
+    MFX::CallTimer callTimer(MFX::eMFXVideoDECODE_VPP_Reset, session);
+
     return (*proc)(loader->getSession(), decode_par, vpp_par_array, num_vpp_par);
 }
 
@@ -584,6 +1075,8 @@ mfxStatus MFXVideoDECODE_VPP_GetChannelParam(mfxSession session,
         return MFX_ERR_INVALID_HANDLE;
     }
 
+    MFX::CallTimer callTimer(MFX::eMFXVideoDECODE_VPP_GetChannelParam, session);
+
     return (*proc)(loader->getSession(), par, channel_id);
 }
 
@@ -599,6 +1092,8 @@ mfxStatus MFXVideoDECODE_VPP_Close(mfxSession session) {
         return MFX_ERR_INVALID_HANDLE;
     }
 
+    MFX::CallTimer callTimer(MFX::eMFXVideoDECODE_VPP_Close, session);
+
     return (*proc)(loader->getSession());
 }
 
@@ -616,6 +1111,8 @@ mfxStatus MFXVideoVPP_ProcessFrameAsync(mfxSession session,
         return MFX_ERR_INVALID_HANDLE;
     }
 
+    MFX::CallTimer callTimer(MFX::eMFXVideoVPP_ProcessFrameAsync, session);
+
     return (*proc)(loader->getSession(), in, out);
 }
 
@@ -636,6 +1133,8 @@ mfxStatus MFXJoinSession(mfxSession session, mfxSession child_session) {
         return MFX_ERR_INVALID_HANDLE;
     }
 
+    MFX::CallTimer callTimer(MFX::eMFXJoinSession, session);
+
     return (*proc)(loader->getSession(), child_loader->getSession());
 }
 
@@ -662,6 +1161,29 @@ mfxStatus MFXCloneSession(mfxSession session, mfxSession* clone) {
     return MFX_ERR_NONE;
 }
 
+// get per-call statistics as JSON text (dispatcher extension)
+mfxStatus MFXDispQueryCallStats(mfxChar* buffer, mfxU32* size) {
+    if (!size)
+        return MFX_ERR_NULL_PTR;
+
+    if (!MFX::CallStats::Get().IsEnabled())
+        return MFX_ERR_UNSUPPORTED;
+
+    std::string json = MFX::CallStats::Get().GetJSON();
+
+    // required size including null terminator
+    mfxU32 reqSize = (mfxU32)json.size() + 1;
+    if (!buffer || *size < reqSize) {
+        *size = reqSize;
+        return MFX_ERR_NOT_ENOUGH_BUFFER;
+    }
+
+    memcpy(buffer, json.c_str(), reqSize);
+    *size = reqSize;
+
+    return MFX_ERR_NONE;
+}
+
 #undef FUNCTION
 #define FUNCTION(return_value, func_name, formal_param_list, actual_param_list)   \
     return_value MFX_CDECL func_name formal_param_list {                          \
@@ -677,7 +1199,8 @@ mfxStatus MFXCloneSession(mfxSession session, mfxSession* clone) {
                                                                                   \
         /* get the real session pointer */                                        \
         session = loader->getSession();                                           \
-        /* pass down the call */                                                  \
+        /* pass down the call, recording its duration if enabled */               \
+        MFX::CallTimer callTimer(MFX::e##func_name, (mfxSession)loader);          \
         return (*proc)actual_param_list;                                          \
     }
 
@@ -29,22 +29,39 @@ mfxLoader MFXLoad() {
         return nullptr;
     }
 
-    // prune libraries which are not actually implementations, filling function
-    // ptr table for each library which is
-    mfxU32 numLibs = loaderCtx->CheckValidLibraries();
-    if (numLibs == 0) {
+    // in lazy load mode, libraries are not loaded until the first call
+    //   to MFXEnumImplementations() or MFXCreateSession()
+    if (loaderCtx->IsLazyLoadEnabled())
+        return (mfxLoader)loaderCtx;
+
+    // prune libraries which are not actually implementations and
+    //   query capabilities of each implementation
+    sts = loaderCtx->LoadLibsAndQueryCaps();
+    if (MFX_ERR_NONE != sts) {
+        loaderCtx->UnloadAllLibraries();
         delete loaderCtx;
         return nullptr;
     }
 
-    // query capabilities of each implementation
-    // may be more than one implementation per library
-    sts = loaderCtx->QueryLibraryCaps();
-    if (MFX_ERR_NONE != sts) {
-        delete loaderCtx;
+    return (mfxLoader)loaderCtx;
+}
+
+// create loader and search for implementations on a background thread (dispatcher extension)
+mfxLoader MFXDispLoadAsync(mfxDispLoadCallback callback, mfxHDL userData) {
+    LoaderCtxVPL* loaderCtx;
+
+    try {
+        std::unique_ptr<LoaderCtxVPL> pLoaderCtx;
+        pLoaderCtx.reset(new LoaderCtxVPL{});
+        loaderCtx = (LoaderCtxVPL*)pLoaderCtx.release();
+    }
+    catch (...) {
         return nullptr;
     }
 
+    // errors are reported to the callback and by later calls with this loader
+    loaderCtx->StartAsyncLoad(callback, userData);
+
     return (mfxLoader)loaderCtx;
 }
 
@@ -53,10 +70,16 @@ void MFXUnload(mfxLoader loader) {
     if (loader) {
         LoaderCtxVPL* loaderCtx = (LoaderCtxVPL*)loader;
 
+        // wait for MFXDispLoadAsync() to finish
+        loaderCtx->JoinAsyncLoad();
+
         loaderCtx->UnloadAllLibraries();
 
         loaderCtx->FreeConfigFilters();
 
+        // optionally save timing results (ENV_ONEVPL_TIMING_FILE)
+        loaderCtx->GetTiming().DumpJSON();
+
         delete loaderCtx;
     }
 
@@ -91,13 +114,9 @@ mfxStatus MFXSetConfigFilterProperty(mfxConfig config, const mfxU8* name, mfxVar
         return MFX_ERR_NULL_PTR;
 
     ConfigCtxVPL* configCtx = (ConfigCtxVPL*)config;
-
-    mfxStatus sts = configCtx->SetFilterProperty(name, value);
-
-    // update list of valid libraries based on updated set of
-    //   mfxConfig properties
     LoaderCtxVPL* loaderCtx = configCtx->m_parentLoader;
-    loaderCtx->UpdateValidImplList();
+
+    mfxStatus sts = loaderCtx->SetConfigFilterProperty(configCtx, name, value);
 
     return sts;
 }
@@ -130,6 +149,86 @@ mfxStatus MFXCreateSession(mfxLoader loader, mfxU32 i, mfxSession* session) {
     return sts;
 }
 
+// create numSessions sessions with implementation i (dispatcher extension)
+mfxStatus MFXDispCreateSessions(mfxLoader loader,
+                                mfxU32 i,
+                                mfxU32 numSessions,
+                                mfxSession* sessions,
+                                mfxU32 flags) {
+    if (!loader || !sessions)
+        return MFX_ERR_NULL_PTR;
+
+    if (numSessions == 0)
+        return MFX_ERR_UNSUPPORTED;
+
+    LoaderCtxVPL* loaderCtx = (LoaderCtxVPL*)loader;
+
+    mfxStatus sts = loaderCtx->CreateSessions(i, numSessions, sessions, flags);
+
+    return sts;
+}
+
+// get session with implementation i from the session pool (dispatcher extension)
+mfxStatus MFXDispAcquireSession(mfxLoader loader, mfxU32 i, mfxSession* session) {
+    if (!loader || !session)
+        return MFX_ERR_NULL_PTR;
+
+    LoaderCtxVPL* loaderCtx = (LoaderCtxVPL*)loader;
+
+    mfxStatus sts = loaderCtx->AcquireSession(i, session);
+
+    return sts;
+}
+
+// return session to the session pool (dispatcher extension)
+mfxStatus MFXDispReleaseSession(mfxLoader loader, mfxSession session) {
+    if (!loader || !session)
+        return MFX_ERR_NULL_PTR;
+
+    LoaderCtxVPL* loaderCtx = (LoaderCtxVPL*)loader;
+
+    mfxStatus sts = loaderCtx->ReleaseSession(session);
+
+    return sts;
+}
+
+// configure session pool limits (dispatcher extension)
+mfxStatus MFXDispSetSessionPoolParams(mfxLoader loader, mfxU32 maxIdle, mfxU32 idleTimeoutMs) {
+    if (!loader)
+        return MFX_ERR_NULL_PTR;
+
+    LoaderCtxVPL* loaderCtx = (LoaderCtxVPL*)loader;
+
+    loaderCtx->SetSessionPoolParams(maxIdle, idleTimeoutMs);
+
+    return MFX_ERR_NONE;
+}
+
+// get loader timing results as JSON text (dispatcher extension)
+mfxStatus MFXDispQueryTiming(mfxLoader loader, mfxChar* buffer, mfxU32* size) {
+    if (!loader || !size)
+        return MFX_ERR_NULL_PTR;
+
+    LoaderCtxVPL* loaderCtx = (LoaderCtxVPL*)loader;
+
+    if (!loaderCtx->GetTiming().IsEnabled())
+        return MFX_ERR_UNSUPPORTED;
+
+    std::string json = loaderCtx->GetTiming().GetJSON();
+
+    // required size including null terminator
+    mfxU32 reqSize = (mfxU32)json.size() + 1;
+    if (!buffer || *size < reqSize) {
+        *size = reqSize;
+        return MFX_ERR_NOT_ENOUGH_BUFFER;
+    }
+
+    memcpy(buffer, json.c_str(), reqSize);
+    *size = reqSize;
+
+    return MFX_ERR_NONE;
+}
+
 // release memory associated with implementation description hdl
 mfxStatus MFXDispReleaseImplDescription(mfxLoader loader, mfxHDL hdl) {
     if (!loader)
@@ -8,12 +8,22 @@
 #define DISPATCHER_VPL_MFX_DISPATCHER_VPL_H_
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
 #include <list>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
 
 #include "vpl/mfxdispatcher.h"
+#include "vpl/mfxdispatcherext.h"
 #include "vpl/mfxvideo.h"
 
 #if defined(_WIN32) || defined(_WIN64)
@@ -49,6 +59,13 @@ typedef char CHAR_TYPE;
 
 #define MAX_VPL_SEARCH_PATH 4096
 
+#define MAX_VPL_QUERY_THREADS 64
+
+#define CAPS_SHM_NAME_PREFIX "/onevpl_caps_"
+
+#define DEFAULT_SESSION_POOL_MAX_IDLE 4
+#define DEFAULT_SESSION_POOL_IDLE_MS  30000
+
 // OS-specific environment variables for implementation
 //   search paths as defined by spec
 #if defined(_WIN32) || defined(_WIN64)
@@ -61,6 +78,45 @@ typedef char CHAR_TYPE;
     #define ENV_OS_PATH             "LD_LIBRARY_PATH"
 #endif
 
+// optional dispatcher settings (not part of spec)
+//   ONEVPL_CAPS_CACHE_DIR        - directory for persistent cache of implementation caps
+//                                  (on Linux, ignored unless owned by the user and not
+//                                  writable by group or others)
+//   ONEVPL_CAPS_SHM              - if set to 1, share caps between processes (Linux only)
+//   ONEVPL_LAZY_LOAD             - if set to 1, defer loading runtimes until caps are required
+//   ONEVPL_LOAD_BALANCE          - if set to 1, create sessions on the equivalent hardware
+//                                  implementation with the fewest open sessions on its device
+//   ONEVPL_QUERY_THREADS         - number of threads used to load and query runtimes (default 1)
+//   ONEVPL_RUNTIME_PATH          - full path of the runtime library to use, no directories are
+//                                  searched (separate multiple libraries like ONEVPL_SEARCH_PATH)
+//   ONEVPL_SESSION_POOL_MAX_IDLE - max idle sessions kept per implementation (default 4)
+//   ONEVPL_SESSION_POOL_IDLE_MS  - close idle sessions after this many ms (default 30000)
+//   ONEVPL_TIMING                - if set to 1, record duration of each loader phase
+//   ONEVPL_TIMING_FILE           - write timing results as JSON to this file on MFXUnload
+#if defined(_WIN32) || defined(_WIN64)
+    #define ENV_ONEVPL_CAPS_CACHE_DIR        L"ONEVPL_CAPS_CACHE_DIR"
+    #define ENV_ONEVPL_CAPS_SHM              L"ONEVPL_CAPS_SHM"
+    #define ENV_ONEVPL_LAZY_LOAD             L"ONEVPL_LAZY_LOAD"
+    #define ENV_ONEVPL_LOAD_BALANCE          L"ONEVPL_LOAD_BALANCE"
+    #define ENV_ONEVPL_QUERY_THREADS         L"ONEVPL_QUERY_THREADS"
+    #define ENV_ONEVPL_RUNTIME_PATH          L"ONEVPL_RUNTIME_PATH"
+    #define ENV_ONEVPL_SESSION_POOL_MAX_IDLE L"ONEVPL_SESSION_POOL_MAX_IDLE"
+    #define ENV_ONEVPL_SESSION_POOL_IDLE_MS  L"ONEVPL_SESSION_POOL_IDLE_MS"
+    #define ENV_ONEVPL_TIMING                L"ONEVPL_TIMING"
+    #define ENV_ONEVPL_TIMING_FILE           L"ONEVPL_TIMING_FILE"
+#else
+    #define ENV_ONEVPL_CAPS_CACHE_DIR        "ONEVPL_CAPS_CACHE_DIR"
+    #define ENV_ONEVPL_CAPS_SHM              "ONEVPL_CAPS_SHM"
+    #define ENV_ONEVPL_LAZY_LOAD             "ONEVPL_LAZY_LOAD"
+    #define ENV_ONEVPL_LOAD_BALANCE          "ONEVPL_LOAD_BALANCE"
+    #define ENV_ONEVPL_QUERY_THREADS         "ONEVPL_QUERY_THREADS"
+    #define ENV_ONEVPL_RUNTIME_PATH          "ONEVPL_RUNTIME_PATH"
+    #define ENV_ONEVPL_SESSION_POOL_MAX_IDLE "ONEVPL_SESSION_POOL_MAX_IDLE"
+    #define ENV_ONEVPL_SESSION_POOL_IDLE_MS  "ONEVPL_SESSION_POOL_IDLE_MS"
+    #define ENV_ONEVPL_TIMING                "ONEVPL_TIMING"
+    #define ENV_ONEVPL_TIMING_FILE           "ONEVPL_TIMING_FILE"
+#endif
+
 #define TAB_SIZE(type, tab) (sizeof(tab) / sizeof(type))
 #define MAKE_MFX_VERSION(major, minor) \
     { (minor), (major) }
@@ -70,12 +126,26 @@ typedef char CHAR_TYPE;
 enum { MFX_ACCEL_MODE_VIA_HW_ANY = 0x7FFFFFFF };
 
 // internal function to load dll by full path, fail if unsuccessful
+// libModule (optional) is an opaque handle to the loaded library and its function table,
+//   which is filled in on the first call and reused by later calls with the same library
+//   (ignored on Windows)
+// sessionRef (optional) is held by the new session until it is freed by MFXClose()
 mfxStatus MFXInitEx2(mfxVersion version,
                      mfxInitializationParam vplParam,
                      mfxIMPL hwImpl,
                      mfxSession* session,
                      mfxU16* deviceID,
-                     CHAR_TYPE* dllName);
+                     CHAR_TYPE* dllName,
+                     std::shared_ptr<void>* libModule = nullptr,
+                     std::shared_ptr<void> sessionRef  = nullptr);
+
+// internal function to read optional numeric dispatcher setting from environment
+// returns false if variable is not set or is not a valid number
+bool GetEnvVarU32(const CHAR_TYPE* envVarName, mfxU32* value);
+
+// internal function to convert string to quoted and escaped JSON string
+// non-ASCII characters are replaced with '?'
+std::string MakeJSONString(const STRING_TYPE& str);
 
 typedef void(MFX_CDECL* VPLFunctionPtr)(void);
 
@@ -185,6 +255,33 @@ struct VPPConfig {
     mfxU32 OutFormat;
 };
 
+// index of flattened configs, maps key (CodecID or FilterFourCC) to list of config indices
+typedef std::unordered_map<mfxU32, std::vector<mfxU32>> FlatConfigIndex;
+
+// flattened Dec/Enc/VPP configs for a single implementation
+// generated on first call to ValidateConfig() and reused for every filter update
+//   since caps do not change for the lifetime of the loader
+struct ImplFlatCaps {
+    bool bInitialized;
+    std::vector<DecConfig> decConfigs;
+    std::vector<EncConfig> encConfigs;
+    std::vector<VPPConfig> vppConfigs;
+
+    // configs grouped by CodecID (dec, enc) or FilterFourCC (vpp)
+    FlatConfigIndex decIndex;
+    FlatConfigIndex encIndex;
+    FlatConfigIndex vppIndex;
+
+    ImplFlatCaps()
+            : bInitialized(false),
+              decConfigs(),
+              encConfigs(),
+              vppConfigs(),
+              decIndex(),
+              encIndex(),
+              vppIndex() {}
+};
+
 // special props which are passed in via MFXSetConfigProperty()
 // these are updated with every call to ValidateConfig() and may
 //   be used in MFXCreateSession()
@@ -195,6 +292,33 @@ struct SpecialConfig {
     mfxVersion ApiVersion;
 };
 
+class ConfigCtxVPL;
+
+// combined filter properties from all mfxConfig objects associated with a loader
+// built once per update, then used to validate each implementation
+struct ConfigFilterSet {
+    // first value set for each property (indexed by property), unset if not used
+    std::vector<mfxVariant> cfgPropsAll;
+
+    // additional configs which set a property that was already set
+    std::vector<ConfigCtxVPL*> configCtxListDups;
+
+    // list of functions required to be implemented
+    std::list<std::string> implFunctionList;
+
+    bool decRequested;
+    bool encRequested;
+    bool vppRequested;
+
+    ConfigFilterSet()
+            : cfgPropsAll(),
+              configCtxListDups(),
+              implFunctionList(),
+              decRequested(false),
+              encRequested(false),
+              vppRequested(false) {}
+};
+
 // config class implementation
 class ConfigCtxVPL {
 public:
@@ -204,12 +328,22 @@ public:
     // set a single filter property (KV pair)
     mfxStatus SetFilterProperty(const mfxU8* name, mfxVariant value);
 
+    // combine properties from all config filters, and update special props
+    //   which are used in MFXCreateSession()
+    static mfxStatus BuildFilterSet(const std::vector<ConfigCtxVPL*>& configCtxList,
+                                    ConfigFilterSet* filterSet,
+                                    SpecialConfig* specialConfig);
+
     // compare library caps vs. set of configuration filters
+    // flatCaps is filled in on first call for each implementation
+    // if changedConfig is set, implementation is assumed to pass all filters except
+    //   for those in the same group (general, dec, enc, vpp, functions) as changedConfig
     static mfxStatus ValidateConfig(mfxImplDescription* libImplDesc,
                                     mfxImplementedFunctions* libImplFuncs,
-                                    std::list<ConfigCtxVPL*> configCtxList,
+                                    ImplFlatCaps* flatCaps,
+                                    const ConfigFilterSet& filterSet,
                                     LibType libType,
-                                    SpecialConfig* specialConfig);
+                                    const ConfigCtxVPL* changedConfig = nullptr);
 
     // loader object this config is associated with - needed to
     //   rebuild valid implementation list after each calling
@@ -217,42 +351,30 @@ public:
     class LoaderCtxVPL* m_parentLoader;
 
 private:
-    __inline std::string GetNextProp(std::list<std::string>* s) {
-        if (s->empty())
-            return "";
-        std::string t = s->front();
-        s->pop_front();
-        return t;
-    }
-
     mfxStatus ValidateAndSetProp(mfxI32 idx, mfxVariant value);
-    mfxStatus SetFilterPropertyDec(mfxVariant value);
-    mfxStatus SetFilterPropertyEnc(mfxVariant value);
-    mfxStatus SetFilterPropertyVPP(mfxVariant value);
 
     static mfxStatus GetFlatDescriptionsDec(mfxImplDescription* libImplDesc,
-                                            std::list<DecConfig>& decConfigList);
+                                            std::vector<DecConfig>& decConfigList);
 
     static mfxStatus GetFlatDescriptionsEnc(mfxImplDescription* libImplDesc,
-                                            std::list<EncConfig>& encConfigList);
+                                            std::vector<EncConfig>& encConfigList);
 
     static mfxStatus GetFlatDescriptionsVPP(mfxImplDescription* libImplDesc,
-                                            std::list<VPPConfig>& vppConfigList);
+                                            std::vector<VPPConfig>& vppConfigList);
 
     static mfxStatus CheckPropsGeneral(mfxVariant cfgPropsAll[], mfxImplDescription* libImplDesc);
 
-    static mfxStatus CheckPropsDec(mfxVariant cfgPropsAll[], std::list<DecConfig> decConfigList);
+    static mfxStatus CheckPropsDec(mfxVariant cfgPropsAll[], const ImplFlatCaps& flatCaps);
 
-    static mfxStatus CheckPropsEnc(mfxVariant cfgPropsAll[], std::list<EncConfig> encConfigList);
+    static mfxStatus CheckPropsEnc(mfxVariant cfgPropsAll[], const ImplFlatCaps& flatCaps);
 
-    static mfxStatus CheckPropsVPP(mfxVariant cfgPropsAll[], std::list<VPPConfig> vppConfigList);
+    static mfxStatus CheckPropsVPP(mfxVariant cfgPropsAll[], const ImplFlatCaps& flatCaps);
 
     static mfxStatus CheckPropString(mfxChar* implString, std::string filtString);
 
     std::string m_propName;
     mfxVariant m_propValue;
     mfxI32 m_propIdx;
-    std::list<std::string> m_propParsedString;
 
     // special containers for properties which are passed by pointer
     //   (save a copy of the whole object based on m_propName)
@@ -263,6 +385,242 @@ private:
     std::string m_implFunctionName;
 };
 
+struct LibInfo;
+struct ImplInfo;
+
+// copy of mfxImplDescription and mfxImplementedFunctions in memory owned by the dispatcher
+// all pointers inside the copied structures refer to locations within the same buffer,
+//   so the caps remain valid after the runtime library is unloaded
+struct ImplCapsBlob {
+    std::vector<mfxU64> implDesc;
+    std::vector<mfxU64> implFuncs;
+};
+
+// identifies one version of a library file on disk
+struct CapsCacheKey {
+    mfxU64 libSize;
+    mfxI64 libMTime;
+    mfxU64 libInode;
+    mfxU64 libDevice;
+
+    bool operator==(const CapsCacheKey& other) const {
+        return libSize == other.libSize && libMTime == other.libMTime &&
+               libInode == other.libInode && libDevice == other.libDevice;
+    }
+};
+
+// persistent on-disk cache of implementation caps (opt-in, see ENV_ONEVPL_CAPS_CACHE_DIR)
+// each entry is keyed by the full path of the library along with its size, modification time,
+//   and inode, so any change to the library automatically invalidates the entry
+// caps of MSDK libraries are the result of opening probe sessions (see LoaderCtxMSDK)
+// NOTE: only the library file is checked - the cache directory should be cleared after
+//   changes to the underlying driver stack or hardware
+class CapsCacheVPL {
+public:
+    CapsCacheVPL();
+    ~CapsCacheVPL();
+
+    // get size, modification time, and inode of library file
+    static mfxStatus GetCacheKey(const STRING_TYPE& libNameFull, CapsCacheKey* key);
+
+    // enable cache if ENV_ONEVPL_CAPS_CACHE_DIR or ENV_ONEVPL_CAPS_SHM is set
+    bool Init();
+
+    bool IsEnabled() {
+        return !m_cacheDir.empty() || m_bShmEnabled;
+    }
+
+    // look up cached caps for this library
+    // if a valid entry is found, libType and cachedCaps in libInfo are filled in
+    //   (libType = LibTypeUnknown means library was previously found to not be a valid runtime)
+    mfxStatus LoadEntry(LibInfo* libInfo);
+
+    // save caps for this library, implCapsList is empty if library is not a valid runtime
+    mfxStatus StoreEntry(LibInfo* libInfo, const std::list<ImplCapsBlob>& implCapsList);
+
+    // create contiguous dispatcher-owned copy of caps returned by runtime
+    static mfxStatus CopyImplDesc(const mfxImplDescription* implDesc, std::vector<mfxU64>& blob);
+    static mfxStatus CopyImplFuncs(const mfxImplementedFunctions* implFuncs,
+                                   std::vector<mfxU64>& blob);
+
+    // write entries for all libraries to the shared snapshot (ENV_ONEVPL_CAPS_SHM)
+    // does nothing if the existing snapshot already contained all of them
+    void PublishSharedSnapshot();
+
+private:
+    STRING_TYPE GetEntryFileName(const STRING_TYPE& libNameFull);
+
+    void MapSharedSnapshot();
+    void UnmapSharedSnapshot();
+    bool FindSharedEntry(const STRING_TYPE& libNameFull, std::vector<mfxU8>& entry);
+    void AddSharedEntry(const STRING_TYPE& libNameFull,
+                        const std::vector<mfxU8>& entry,
+                        bool bNew);
+
+    STRING_TYPE m_cacheDir;
+
+    // shared snapshot of caps for all libraries (Linux only)
+    bool m_bShmEnabled;
+    bool m_bShmStale;
+    const mfxU8* m_shmBase;
+    size_t m_shmSize;
+
+    // entries seen by this process, used to publish a new snapshot
+    std::mutex m_shmMutex;
+    std::map<STRING_TYPE, std::vector<mfxU8>> m_shmEntries;
+};
+
+// pool of idle sessions which can be handed out again without re-initializing the runtime
+// sessions are keyed by implementation and acceleration mode
+// expired sessions are closed on the next call to Get() or Put() (no background thread)
+class SessionPoolVPL {
+public:
+    SessionPoolVPL();
+    ~SessionPoolVPL();
+
+    // read optional pool settings from environment
+    void Init();
+
+    void SetParams(mfxU32 maxIdle, mfxU32 idleTimeoutMs);
+
+    // take an idle session for this implementation, created with the same acceleration mode
+    //   and device handle, returns nullptr if none available
+    mfxSession Get(const ImplInfo* implInfo, const SpecialConfig& specialConfig);
+
+    // track session handed out to the application, so that it can be returned with Put()
+    void AddActive(mfxSession session,
+                   const ImplInfo* implInfo,
+                   const SpecialConfig& specialConfig);
+
+    // return session to the pool, or close it if the pool is full
+    mfxStatus Put(mfxSession session);
+
+    // close all idle sessions (active sessions are owned by the application)
+    void Clear();
+
+private:
+    typedef std::chrono::steady_clock ClockType;
+    // sessions are bound to the device handle passed to MFXVideoCORE_SetHandle() on creation
+    typedef std::tuple<const ImplInfo*, mfxAccelerationMode, mfxHandleType, mfxHDL> PoolKey;
+
+    struct IdleSession {
+        mfxSession session;
+        ClockType::time_point releaseTime;
+    };
+
+    static PoolKey MakeKey(const ImplInfo* implInfo, const SpecialConfig& specialConfig);
+    static void CountIdle(const PoolKey& key, bool bIdle);
+
+    // move expired sessions to closeList, to be closed after releasing m_mutex
+    void RemoveExpired(ClockType::time_point now, std::list<mfxSession>& closeList);
+
+    std::mutex m_mutex;
+
+    // most recently returned sessions are at the front of each list
+    std::map<PoolKey, std::list<IdleSession>> m_idleSessions;
+    std::map<mfxSession, PoolKey> m_activeSessions;
+
+    mfxU32 m_maxIdle;
+    mfxU32 m_idleTimeoutMs;
+};
+
+// immutable list of valid implementations and special config properties
+// a new snapshot is published by the thread which changes the filters, and readers
+//   (MFXEnumImplementations, MFXCreateSession) use the current one without locking
+// ImplInfo objects are not freed until MFXUnload, so the pointers remain valid
+struct ValidImplSnapshot {
+    std::vector<ImplInfo*> implList; // indexed by validImplIdx
+    SpecialConfig specialConfig;
+};
+
+// loader phases recorded by LoaderTimingVPL
+enum TimingPhase {
+    TimingPhaseDirScan = 0,      // search directories for candidate libraries
+    TimingPhaseLoadLib,          // dlopen/LoadLibrary of each candidate
+    TimingPhaseResolveExports,   // symbol lookup and ValidateAPIExports()
+    TimingPhaseQueryImpls,       // MFXQueryImplsDescription()
+    TimingPhaseMSDKProbe,        // MSDK compatibility caps query
+    TimingPhaseFilterValidation, // UpdateValidImplList()
+    TimingPhaseInitSession,      // MFXInitEx2()
+
+    TimingPhaseCount
+};
+
+// optional record of time spent in each loader phase, per library where applicable
+// enabled with ENV_ONEVPL_TIMING or ENV_ONEVPL_TIMING_FILE
+class LoaderTimingVPL {
+public:
+    typedef std::chrono::steady_clock ClockType;
+
+    LoaderTimingVPL();
+    ~LoaderTimingVPL();
+
+    // read optional settings from environment
+    void Init();
+
+    bool IsEnabled() const {
+        return m_bEnabled;
+    }
+
+    // may be called concurrently (parallel library query)
+    void AddSample(TimingPhase phase, const STRING_TYPE* libName, ClockType::duration duration);
+
+    // get all results as JSON text
+    std::string GetJSON();
+
+    // write results to ENV_ONEVPL_TIMING_FILE, if set
+    void DumpJSON();
+
+private:
+    struct PhaseStats {
+        mfxU64 count;
+        ClockType::duration total;
+        ClockType::duration max;
+    };
+
+    std::mutex m_mutex;
+
+    // ordered by phase, then by library name (empty if phase is not per-library)
+    std::map<std::pair<mfxU32, STRING_TYPE>, PhaseStats> m_stats;
+
+    bool m_bEnabled;
+    STRING_TYPE m_dumpFile;
+};
+
+// record duration of the enclosing scope, if timing is enabled
+class TimingScopeVPL {
+public:
+    TimingScopeVPL(LoaderTimingVPL& timing,
+                   TimingPhase phase,
+                   const STRING_TYPE* libName = nullptr)
+            : m_timing(timing),
+              m_phase(phase),
+              m_libName(libName),
+              m_start(),
+              m_bStopped(false) {
+        if (m_timing.IsEnabled())
+            m_start = LoaderTimingVPL::ClockType::now();
+    }
+
+    ~TimingScopeVPL() {
+        Stop();
+    }
+
+    // record duration now instead of at end of scope
+    void Stop() {
+        if (m_timing.IsEnabled() && !m_bStopped)
+            m_timing.AddSample(m_phase, m_libName, LoaderTimingVPL::ClockType::now() - m_start);
+        m_bStopped = true;
+    }
+
+private:
+    LoaderTimingVPL& m_timing;
+    TimingPhase m_phase;
+    const STRING_TYPE* m_libName;
+    LoaderTimingVPL::ClockType::time_point m_start;
+    bool m_bStopped;
+};
+
 // MSDK compatibility loader implementation
 class LoaderCtxMSDK {
 public:
@@ -271,15 +629,35 @@ public:
 
     // public function to be called by VPL dispatcher
     // do not allocate any new memory here, so no need for a matching Release functions
+    // probe sessions are only opened the first time each library is queried in this process
     mfxStatus QueryMSDKCaps(STRING_TYPE libNameFull,
                             mfxImplDescription** implDesc,
                             mfxImplementedFunctions** implFuncs,
                             mfxIMPL* msdkAdapter);
 
+    // use caps saved from an earlier call to QueryMSDKCaps() (persistent cache)
+    // does not open any sessions
+    mfxStatus LoadCachedCaps(STRING_TYPE libNameFull,
+                             const mfxImplDescription* cachedDesc,
+                             mfxImplDescription** implDesc,
+                             mfxImplementedFunctions** implFuncs,
+                             mfxIMPL* msdkAdapter);
+
     // required by MFXCreateSession
     mfxIMPL msdkAdapter;
 
 private:
+    // open probe sessions to fill in m_id
+    mfxStatus ProbeMSDKCaps(mfxImplDescription** implDesc,
+                            mfxImplementedFunctions** implFuncs,
+                            mfxIMPL* msdkAdapter);
+
+    // copy previous probe result into m_id
+    mfxStatus SetCaps(const mfxImplDescription* srcDesc,
+                      mfxImplDescription** implDesc,
+                      mfxImplementedFunctions** implFuncs,
+                      mfxIMPL* msdkAdapter);
+
     // session management
     mfxStatus OpenSession(mfxSession* session,
                           STRING_TYPE libNameFull,
@@ -327,6 +705,15 @@ struct LibInfo {
     VPLFunctionPtr msdkFuncTable[NumMSDKFunctions]; // NOLINT
     class LoaderCtxMSDK* msdkCtx;
 
+    // library handle and function table used by sessions, shared by all
+    //   sessions created with this library (set on first MFXCreateSession)
+    std::shared_ptr<void> sessionModule;
+
+    // caps loaded from persistent cache - if set, the library does not
+    //   need to be loaded in order to build the list of implementations
+    bool bCapsCached;
+    std::list<ImplCapsBlob> cachedCaps;
+
     // avoid warnings
     LibInfo()
             : libNameFull(),
@@ -336,7 +723,10 @@ struct LibInfo {
               hModuleVPL(nullptr),
               vplFuncTable(),
               msdkFuncTable(),
-              msdkCtx() {}
+              msdkCtx(),
+              sessionModule(),
+              bCapsCached(false),
+              cachedCaps() {}
 
     ~LibInfo() {
         if (msdkCtx)
@@ -354,6 +744,13 @@ struct ImplInfo {
     // list of implemented functions
     mfxHDL implFuncs;
 
+    // if not empty, implDesc and implFuncs point into this dispatcher-owned copy
+    //   rather than memory returned by the runtime
+    ImplCapsBlob capsBlob;
+
+    // flattened caps used for filtering
+    ImplFlatCaps flatCaps;
+
     // used for session initialization with this implementation
     mfxInitializationParam vplParam;
     mfxVersion version;
@@ -364,15 +761,22 @@ struct ImplInfo {
     // index of valid libraries - updates with every call to MFXSetConfigFilterProperty()
     mfxI32 validImplIdx;
 
+    // number of open sessions on the device of this implementation (ENV_ONEVPL_LOAD_BALANCE)
+    // shared by all hardware implementations on the same device
+    std::shared_ptr<std::atomic<mfxU32>> sessionLoad;
+
     // avoid warnings
     ImplInfo()
             : libInfo(nullptr),
               implDesc(nullptr),
               implFuncs(nullptr),
+              capsBlob(),
+              flatCaps(),
               vplParam(),
               version(),
               libImplIdx(0),
-              validImplIdx(-1) {}
+              validImplIdx(-1),
+              sessionLoad() {}
 };
 
 // loader class implementation
@@ -387,17 +791,55 @@ public:
     mfxStatus QueryLibraryCaps();
     mfxStatus UnloadAllLibraries();
 
+    // check and query all candidate libraries, if not already done
+    // in lazy load mode this is deferred until the first call which requires caps
+    mfxStatus LoadLibsAndQueryCaps();
+
+    bool IsLazyLoadEnabled() {
+        return m_bLazyLoad;
+    }
+
+    // search for and query libraries on a background thread (MFXDispLoadAsync)
+    // LoadLibsAndQueryCaps() waits for it to finish
+    mfxStatus StartAsyncLoad(mfxDispLoadCallback callback, mfxHDL userData);
+
+    // wait for background thread started by StartAsyncLoad(), if any
+    void JoinAsyncLoad();
+
     // query capabilities of each implementation
     mfxStatus QueryImpl(mfxU32 idx, mfxImplCapsDeliveryFormat format, mfxHDL* idesc);
     mfxStatus ReleaseImpl(mfxHDL idesc);
 
     // update list of valid implementations based on current filter props
-    mfxStatus UpdateValidImplList(void);
+    // if changedConfig is set, only filters affected by it are re-checked
+    // caller must hold m_writeMutex and m_configMutex (or be the only thread using the loader)
+    mfxStatus UpdateValidImplList(const ConfigCtxVPL* changedConfig = nullptr);
     mfxStatus PrioritizeImplList(void);
 
+    // set filter property and update list of valid implementations
+    // may be called concurrently with QueryImpl() and CreateSession()
+    mfxStatus SetConfigFilterProperty(ConfigCtxVPL* configCtx,
+                                      const mfxU8* name,
+                                      mfxVariant value);
+
     // create mfxSession
     mfxStatus CreateSession(mfxU32 idx, mfxSession* session);
 
+    // create numSessions mfxSessions with the same implementation
+    mfxStatus CreateSessions(mfxU32 idx, mfxU32 numSessions, mfxSession* sessions, mfxU32 flags);
+
+    // get session from pool (or create new one) and return it to pool when done
+    mfxStatus AcquireSession(mfxU32 idx, mfxSession* session);
+    mfxStatus ReleaseSession(mfxSession session);
+
+    void SetSessionPoolParams(mfxU32 maxIdle, mfxU32 idleTimeoutMs) {
+        m_sessionPool.SetParams(maxIdle, idleTimeoutMs);
+    }
+
+    LoaderTimingVPL& GetTiming() {
+        return m_timing;
+    }
+
     // manage configuration filters
     ConfigCtxVPL* AddConfigFilter();
     mfxStatus FreeConfigFilters();
@@ -405,22 +847,44 @@ public:
 private:
     // helper functions
     mfxStatus LoadSingleLibrary(LibInfo* libInfo);
+    mfxStatus CheckSingleLibrary(LibInfo* libInfo);
+    mfxStatus QuerySingleLibrary(LibInfo* libInfo, std::vector<ImplInfo*>& implInfoList);
     mfxStatus UnloadSingleLibrary(LibInfo* libInfo);
     mfxStatus UnloadSingleImplementation(ImplInfo* implInfo);
+    mfxStatus UnloadLibraryKeepCaps(LibInfo* libInfo);
+    mfxStatus QueryAllLibraries();
+    mfxStatus RunAsyncLoad(mfxDispLoadCallback callback, mfxHDL userData);
+    void SetCapsReady(bool bApplyFilters);
+    void PublishValidImpls();
+    std::shared_ptr<const ValidImplSnapshot> GetValidImpls();
+    mfxStatus CreateSessionForImpl(ImplInfo* implInfo,
+                                   const SpecialConfig& specialConfig,
+                                   mfxSession* session);
+    void AssignSessionLoadCounters();
+    ImplInfo* SelectLeastLoadedImpl(const ValidImplSnapshot& validImpls, mfxU32 idx);
     VPLFunctionPtr GetFunctionAddr(void* hModuleVPL, const char* pName);
 
     mfxU32 ParseEnvSearchPaths(const CHAR_TYPE* envVarName, std::list<STRING_TYPE>& searchDirs);
     mfxU32 ParseLegacySearchPaths(std::list<STRING_TYPE>& searchDirs);
 
     mfxStatus SearchDirForLibs(STRING_TYPE searchDir,
-                               std::list<LibInfo*>& libInfoList,
+                               std::vector<LibInfo*>& libInfoList,
                                mfxU32 priority);
+    mfxStatus AddLibByPath(const STRING_TYPE& libPath,
+                           std::vector<LibInfo*>& libInfoList,
+                           mfxU32 priority);
 
     mfxStatus ValidateAPIExports(VPLFunctionPtr* vplFuncTable, mfxVersion reportedVersion);
 
-    std::list<LibInfo*> m_libInfoList;
-    std::list<ImplInfo*> m_implInfoList;
-    std::list<ConfigCtxVPL*> m_configCtxList;
+    mfxStatus StoreCachedCaps(LibInfo* libInfo,
+                              mfxHDL* hImpl,
+                              mfxU32 numImpls,
+                              mfxHDL* hImplFuncs,
+                              mfxU32 numImplsFuncs);
+
+    std::vector<LibInfo*> m_libInfoList;
+    std::vector<ImplInfo*> m_implInfoList;
+    std::vector<ConfigCtxVPL*> m_configCtxList;
 
     std::list<STRING_TYPE> m_userSearchDirs;
     std::list<STRING_TYPE> m_packageSearchDirs;
@@ -429,9 +893,34 @@ private:
     STRING_TYPE m_vplPackageDir;
     STRING_TYPE m_driverStoreDir;
     SpecialConfig m_specialConfig;
+    ConfigFilterSet m_filterSet;
+    CapsCacheVPL m_capsCache;
+    SessionPoolVPL m_sessionPool;
+    LoaderTimingVPL m_timing;
+
+    // current list of valid implementations, replaced with std::atomic_store()
+    std::shared_ptr<const ValidImplSnapshot> m_validImpls;
+
+    // serializes loading and changes to the list of valid implementations
+    std::mutex m_writeMutex;
+
+    // protects m_configCtxList and the filter properties, does not wait for loading
+    // lock order: m_writeMutex, then m_configMutex
+    std::mutex m_configMutex;
+
+    // background discovery started by StartAsyncLoad()
+    // m_asyncLoadStatus is set before the callback is called
+    std::thread m_asyncLoadThread;
+    std::promise<mfxStatus> m_asyncLoadPromise;
+    std::shared_future<mfxStatus> m_asyncLoadStatus;
 
     mfxU32 m_implIdxNext;
     bool m_bKeepCapsUntilUnload;
+    bool m_bLazyLoad;
+    bool m_bLoadBalance;
+    bool m_bLibsLoaded;
+    std::atomic<bool> m_bCapsReady; // set once loading is complete (successful or not)
+    mfxU32 m_numQueryThreads;
 };
 
 #endif // DISPATCHER_VPL_MFX_DISPATCHER_VPL_H_
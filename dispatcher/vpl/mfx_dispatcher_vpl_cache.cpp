@@ -0,0 +1,949 @@
+/*############################################################################
+  # Copyright (C) Intel Corporation
+  #
+  # SPDX-License-Identifier: MIT
+  ############################################################################*/
+
+#include "vpl/mfx_dispatcher_vpl.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+    #include <direct.h>
+    #include <process.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
+#include <atomic>
+
+// increment whenever the layout of the cache file or the caps structures changes
+#define CAPS_CACHE_FORMAT_VERSION 1
+
+static const mfxU8 CapsCacheMagic[8] = { 'V', 'P', 'L', 'C', 'A', 'P', 'S', 0 };
+static const mfxU8 CapsShmMagic[8]   = { 'V', 'P', 'L', 'C', 'S', 'H', 'M', 0 };
+
+// header of each cache file, followed by:
+//   libNameLen bytes - full path to library (used to detect hash collisions)
+//   for each implementation:
+//     mfxU64 descSize, mfxU64 funcsSize (in bytes)
+//     descSize bytes of mfxImplDescription, funcsSize bytes of mfxImplementedFunctions
+struct CapsCacheFileHeader {
+    mfxU8 magic[8];
+    mfxU32 formatVersion;
+    mfxU32 ptrSize;
+    mfxU64 libSize;
+    mfxI64 libMTime;
+    mfxU64 libInode;
+    mfxU64 libDevice;
+    mfxI32 libType;
+    mfxU32 numImpls;
+    mfxU32 libNameLen;
+    mfxU32 reserved;
+};
+
+// header of shared snapshot, followed by numEntries entries:
+//   mfxU64 entrySize, then entrySize bytes in the same format as a cache file
+// magic is written last, so a segment which is still being written is ignored
+struct CapsShmHeader {
+    mfxU8 magic[8];
+    mfxU32 formatVersion;
+    mfxU32 ptrSize;
+    mfxU64 totalSize;
+    mfxU32 numEntries;
+    mfxU32 reserved;
+};
+
+mfxStatus CapsCacheVPL::GetCacheKey(const STRING_TYPE& libNameFull, CapsCacheKey* key) {
+    *key = {};
+
+#if defined(_WIN32) || defined(_WIN64)
+    struct _stat64 st;
+    if (_wstat64(libNameFull.c_str(), &st))
+        return MFX_ERR_NOT_FOUND;
+
+    key->libMTime = (mfxI64)st.st_mtime;
+#else
+    struct stat st;
+    if (stat(libNameFull.c_str(), &st))
+        return MFX_ERR_NOT_FOUND;
+
+    key->libMTime = (mfxI64)st.st_mtim.tv_sec * 1000000000 + (mfxI64)st.st_mtim.tv_nsec;
+#endif
+
+    key->libSize   = (mfxU64)st.st_size;
+    key->libInode  = (mfxU64)st.st_ino;
+    key->libDevice = (mfxU64)st.st_dev;
+
+    return MFX_ERR_NONE;
+}
+
+static FILE* OpenCacheFile(const STRING_TYPE& fileName) {
+#if defined(_WIN32) || defined(_WIN64)
+    return _wfopen(fileName.c_str(), L"rb");
+#else
+    return fopen(fileName.c_str(), "rb");
+#endif
+}
+
+// create a new temporary file next to fileName, readable only by the current user
+// the name is not predictable and an existing file or link is never opened
+static FILE* OpenTempCacheFile(const STRING_TYPE& fileName, STRING_TYPE& tmpName) {
+#if defined(_WIN32) || defined(_WIN64)
+    tmpName = fileName + L"." + std::to_wstring(_getpid()) + L".tmp";
+    return _wfopen(tmpName.c_str(), L"wbx");
+#else
+    std::vector<char> name(fileName.begin(), fileName.end());
+    const char suffix[] = ".XXXXXX";
+    name.insert(name.end(), suffix, suffix + sizeof(suffix));
+
+    int fd = mkstemp(name.data());
+    if (fd < 0)
+        return nullptr;
+
+    tmpName = name.data();
+    FILE* f = fdopen(fd, "wb");
+    if (!f) {
+        close(fd);
+        remove(tmpName.c_str());
+    }
+    return f;
+#endif
+}
+
+// replace existing file (if any) so that readers never see a partially written entry
+static bool ReplaceCacheFile(const STRING_TYPE& tmpName, const STRING_TYPE& fileName) {
+#if defined(_WIN32) || defined(_WIN64)
+    return MoveFileExW(tmpName.c_str(), fileName.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(tmpName.c_str(), fileName.c_str()) == 0;
+#endif
+}
+
+static void RemoveCacheFile(const STRING_TYPE& fileName) {
+#if defined(_WIN32) || defined(_WIN64)
+    _wremove(fileName.c_str());
+#else
+    remove(fileName.c_str());
+#endif
+}
+
+// helper for building contiguous copy of caps structures
+// pointers inside the buffer are stored as offsets from the start of the buffer
+//   until Relocate() is called (offset 0 is the root structure, so it is used for nullptr)
+class CapsWriter {
+public:
+    CapsWriter() : m_buf() {}
+
+    size_t Append(const void* src, size_t size) {
+        // keep all arrays 8-byte aligned
+        size_t offset = (m_buf.size() + 7) & ~((size_t)7);
+        m_buf.resize(offset + size, 0);
+        if (src && size)
+            memcpy(m_buf.data() + offset, src, size);
+        return offset;
+    }
+
+    template <typename T>
+    T* AppendArray(const T* src, mfxU32 count) {
+        if (!src || !count)
+            return nullptr;
+        return (T*)(uintptr_t)Append(src, count * sizeof(T));
+    }
+
+    template <typename T>
+    T* At(size_t offset) {
+        return (T*)(m_buf.data() + offset);
+    }
+
+    template <typename T>
+    T* At(T* encodedOffset, mfxU32 idx) {
+        return At<T>((size_t)(uintptr_t)encodedOffset + idx * sizeof(T));
+    }
+
+    void GetBlob(std::vector<mfxU64>& blob) {
+        blob.resize((m_buf.size() + 7) / 8, 0);
+        memcpy(blob.data(), m_buf.data(), m_buf.size());
+    }
+
+private:
+    std::vector<mfxU8> m_buf;
+};
+
+// walk all pointers inside a contiguous caps buffer
+// if bToOffset is true, absolute pointers are converted to offsets from the start of the buffer,
+//   otherwise offsets are converted to absolute pointers
+// ptrBase is the address that absolute pointers in the buffer refer to, which differs from
+//   base when converting a copy of a buffer
+// every array is checked to lie entirely within the buffer, so this is safe to
+//   call on data read from disk
+class CapsRelocator {
+public:
+    CapsRelocator(mfxU8* base, size_t size, bool bToOffset, const mfxU8* ptrBase = nullptr)
+            : m_base(base),
+              m_ptrBase(ptrBase ? ptrBase : base),
+              m_size(size),
+              m_bToOffset(bToOffset) {}
+
+    template <typename T>
+    bool Fix(T*& ptr, mfxU32 count, T** absPtr) {
+        *absPtr = nullptr;
+
+        size_t offset;
+        if (m_bToOffset) {
+            if (!ptr)
+                return (count == 0);
+            offset = (size_t)((const mfxU8*)ptr - m_ptrBase);
+        }
+        else {
+            offset = (size_t)(uintptr_t)ptr;
+            if (!offset)
+                return (count == 0);
+        }
+
+        if (offset >= m_size || (offset % sizeof(mfxU64)) || count > (m_size - offset) / sizeof(T))
+            return false;
+
+        *absPtr = (T*)(m_base + offset);
+        ptr     = m_bToOffset ? (T*)(uintptr_t)offset : *absPtr;
+
+        return true;
+    }
+
+    bool FixString(mfxChar*& str) {
+        mfxChar* absStr = nullptr;
+        if (!Fix(str, 1, &absStr) || !absStr)
+            return false;
+
+        size_t offset = (size_t)((mfxU8*)absStr - m_base);
+        return memchr(absStr, 0, m_size - offset) != nullptr;
+    }
+
+    bool RelocateImplDesc() {
+        if (m_size < sizeof(mfxImplDescription))
+            return false;
+
+        mfxImplDescription* implDesc = (mfxImplDescription*)m_base;
+
+        if (implDesc->NumExtParam || implDesc->ExtParams.ExtParam)
+            return false;
+
+        mfxDeviceDescription::subdevices* subDevices = nullptr;
+        if (!Fix(implDesc->Dev.SubDevices, implDesc->Dev.NumSubDevices, &subDevices))
+            return false;
+
+        mfxAccelerationMode* modes = nullptr;
+        if (!Fix(implDesc->AccelerationModeDescription.Mode,
+                 implDesc->AccelerationModeDescription.NumAccelerationModes,
+                 &modes))
+            return false;
+
+        // decoders
+        DecCodec* decCodecs = nullptr;
+        if (!Fix(implDesc->Dec.Codecs, implDesc->Dec.NumCodecs, &decCodecs))
+            return false;
+
+        for (mfxU32 c = 0; c < implDesc->Dec.NumCodecs; c++) {
+            DecProfile* profiles = nullptr;
+            if (!Fix(decCodecs[c].Profiles, decCodecs[c].NumProfiles, &profiles))
+                return false;
+
+            for (mfxU32 p = 0; p < decCodecs[c].NumProfiles; p++) {
+                DecMemDesc* memDesc = nullptr;
+                if (!Fix(profiles[p].MemDesc, profiles[p].NumMemTypes, &memDesc))
+                    return false;
+
+                for (mfxU32 m = 0; m < profiles[p].NumMemTypes; m++) {
+                    mfxU32* colorFormats = nullptr;
+                    if (!Fix(memDesc[m].ColorFormats, memDesc[m].NumColorFormats, &colorFormats))
+                        return false;
+                }
+            }
+        }
+
+        // encoders
+        EncCodec* encCodecs = nullptr;
+        if (!Fix(implDesc->Enc.Codecs, implDesc->Enc.NumCodecs, &encCodecs))
+            return false;
+
+        for (mfxU32 c = 0; c < implDesc->Enc.NumCodecs; c++) {
+            EncProfile* profiles = nullptr;
+            if (!Fix(encCodecs[c].Profiles, encCodecs[c].NumProfiles, &profiles))
+                return false;
+
+            for (mfxU32 p = 0; p < encCodecs[c].NumProfiles; p++) {
+                EncMemDesc* memDesc = nullptr;
+                if (!Fix(profiles[p].MemDesc, profiles[p].NumMemTypes, &memDesc))
+                    return false;
+
+                for (mfxU32 m = 0; m < profiles[p].NumMemTypes; m++) {
+                    mfxU32* colorFormats = nullptr;
+                    if (!Fix(memDesc[m].ColorFormats, memDesc[m].NumColorFormats, &colorFormats))
+                        return false;
+                }
+            }
+        }
+
+        // VPP filters
+        VPPFilter* filters = nullptr;
+        if (!Fix(implDesc->VPP.Filters, implDesc->VPP.NumFilters, &filters))
+            return false;
+
+        for (mfxU32 f = 0; f < implDesc->VPP.NumFilters; f++) {
+            VPPMemDesc* memDesc = nullptr;
+            if (!Fix(filters[f].MemDesc, filters[f].NumMemTypes, &memDesc))
+                return false;
+
+            for (mfxU32 m = 0; m < filters[f].NumMemTypes; m++) {
+                VPPFormat* formats = nullptr;
+                if (!Fix(memDesc[m].Formats, memDesc[m].NumInFormats, &formats))
+                    return false;
+
+                for (mfxU32 i = 0; i < memDesc[m].NumInFormats; i++) {
+                    mfxU32* outFormats = nullptr;
+                    if (!Fix(formats[i].OutFormats, formats[i].NumOutFormat, &outFormats))
+                        return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    bool RelocateImplFuncs() {
+        if (m_size < sizeof(mfxImplementedFunctions))
+            return false;
+
+        mfxImplementedFunctions* implFuncs = (mfxImplementedFunctions*)m_base;
+
+        mfxChar** names = nullptr;
+        if (!Fix(implFuncs->FunctionsName, implFuncs->NumFunctions, &names))
+            return false;
+
+        for (mfxU32 i = 0; i < implFuncs->NumFunctions; i++) {
+            if (!FixString(names[i]))
+                return false;
+        }
+
+        return true;
+    }
+
+private:
+    mfxU8* m_base;
+    const mfxU8* m_ptrBase;
+    size_t m_size;
+    bool m_bToOffset;
+};
+
+mfxStatus CapsCacheVPL::CopyImplDesc(const mfxImplDescription* implDesc,
+                                     std::vector<mfxU64>& blob) {
+    if (!implDesc)
+        return MFX_ERR_NULL_PTR;
+
+    CapsWriter w;
+
+    size_t d = w.Append(implDesc, sizeof(mfxImplDescription));
+
+    // extension buffers are reserved for future use - do not copy
+    w.At<mfxImplDescription>(d)->NumExtParam         = 0;
+    w.At<mfxImplDescription>(d)->ExtParams.ExtParam = nullptr;
+
+    // AccelerationModeDescription was added in struct version 1.1
+    mfxAccelerationModeDescription accelDesc = {};
+    if (implDesc->Version.Version >= MFX_STRUCT_VERSION(1, 1))
+        accelDesc = implDesc->AccelerationModeDescription;
+
+    auto modes = w.AppendArray(accelDesc.Mode, accelDesc.NumAccelerationModes);
+    w.At<mfxImplDescription>(d)->AccelerationModeDescription.Mode = modes;
+    if (!modes)
+        w.At<mfxImplDescription>(d)->AccelerationModeDescription.NumAccelerationModes = 0;
+
+    auto subDevices = w.AppendArray(implDesc->Dev.SubDevices, implDesc->Dev.NumSubDevices);
+    w.At<mfxImplDescription>(d)->Dev.SubDevices = subDevices;
+    if (!subDevices)
+        w.At<mfxImplDescription>(d)->Dev.NumSubDevices = 0;
+
+    // decoders
+    const mfxDecoderDescription* dec = &implDesc->Dec;
+    auto decCodecs                   = w.AppendArray(dec->Codecs, dec->NumCodecs);
+    w.At<mfxImplDescription>(d)->Dec.Codecs = decCodecs;
+    if (!decCodecs)
+        w.At<mfxImplDescription>(d)->Dec.NumCodecs = 0;
+
+    for (mfxU32 c = 0; decCodecs && c < dec->NumCodecs; c++) {
+        const DecCodec* codec = &dec->Codecs[c];
+        auto profiles         = w.AppendArray(codec->Profiles, codec->NumProfiles);
+        w.At(decCodecs, c)->Profiles = profiles;
+        if (!profiles)
+            w.At(decCodecs, c)->NumProfiles = 0;
+
+        for (mfxU32 p = 0; profiles && p < codec->NumProfiles; p++) {
+            const DecProfile* profile = &codec->Profiles[p];
+            auto memDesc              = w.AppendArray(profile->MemDesc, profile->NumMemTypes);
+            w.At(profiles, p)->MemDesc = memDesc;
+            if (!memDesc)
+                w.At(profiles, p)->NumMemTypes = 0;
+
+            for (mfxU32 m = 0; memDesc && m < profile->NumMemTypes; m++) {
+                const DecMemDesc* mem = &profile->MemDesc[m];
+                auto colorFormats     = w.AppendArray(mem->ColorFormats, mem->NumColorFormats);
+                w.At(memDesc, m)->ColorFormats = colorFormats;
+                if (!colorFormats)
+                    w.At(memDesc, m)->NumColorFormats = 0;
+            }
+        }
+    }
+
+    // encoders
+    const mfxEncoderDescription* enc = &implDesc->Enc;
+    auto encCodecs                   = w.AppendArray(enc->Codecs, enc->NumCodecs);
+    w.At<mfxImplDescription>(d)->Enc.Codecs = encCodecs;
+    if (!encCodecs)
+        w.At<mfxImplDescription>(d)->Enc.NumCodecs = 0;
+
+    for (mfxU32 c = 0; encCodecs && c < enc->NumCodecs; c++) {
+        const EncCodec* codec = &enc->Codecs[c];
+        auto profiles         = w.AppendArray(codec->Profiles, codec->NumProfiles);
+        w.At(encCodecs, c)->Profiles = profiles;
+        if (!profiles)
+            w.At(encCodecs, c)->NumProfiles = 0;
+
+        for (mfxU32 p = 0; profiles && p < codec->NumProfiles; p++) {
+            const EncProfile* profile = &codec->Profiles[p];
+            auto memDesc              = w.AppendArray(profile->MemDesc, profile->NumMemTypes);
+            w.At(profiles, p)->MemDesc = memDesc;
+            if (!memDesc)
+                w.At(profiles, p)->NumMemTypes = 0;
+
+            for (mfxU32 m = 0; memDesc && m < profile->NumMemTypes; m++) {
+                const EncMemDesc* mem = &profile->MemDesc[m];
+                auto colorFormats     = w.AppendArray(mem->ColorFormats, mem->NumColorFormats);
+                w.At(memDesc, m)->ColorFormats = colorFormats;
+                if (!colorFormats)
+                    w.At(memDesc, m)->NumColorFormats = 0;
+            }
+        }
+    }
+
+    // VPP filters
+    const mfxVPPDescription* vpp = &implDesc->VPP;
+    auto filters                 = w.AppendArray(vpp->Filters, vpp->NumFilters);
+    w.At<mfxImplDescription>(d)->VPP.Filters = filters;
+    if (!filters)
+        w.At<mfxImplDescription>(d)->VPP.NumFilters = 0;
+
+    for (mfxU32 f = 0; filters && f < vpp->NumFilters; f++) {
+        const VPPFilter* filter = &vpp->Filters[f];
+        auto memDesc            = w.AppendArray(filter->MemDesc, filter->NumMemTypes);
+        w.At(filters, f)->MemDesc = memDesc;
+        if (!memDesc)
+            w.At(filters, f)->NumMemTypes = 0;
+
+        for (mfxU32 m = 0; memDesc && m < filter->NumMemTypes; m++) {
+            const VPPMemDesc* mem = &filter->MemDesc[m];
+            auto formats          = w.AppendArray(mem->Formats, mem->NumInFormats);
+            w.At(memDesc, m)->Formats = formats;
+            if (!formats)
+                w.At(memDesc, m)->NumInFormats = 0;
+
+            for (mfxU32 i = 0; formats && i < mem->NumInFormats; i++) {
+                const VPPFormat* format = &mem->Formats[i];
+                auto outFormats         = w.AppendArray(format->OutFormats, format->NumOutFormat);
+                w.At(formats, i)->OutFormats = outFormats;
+                if (!outFormats)
+                    w.At(formats, i)->NumOutFormat = 0;
+            }
+        }
+    }
+
+    w.GetBlob(blob);
+
+    // convert offsets to absolute pointers within the new buffer
+    CapsRelocator r((mfxU8*)blob.data(), blob.size() * sizeof(mfxU64), false);
+    if (!r.RelocateImplDesc()) {
+        blob.clear();
+        return MFX_ERR_UNKNOWN;
+    }
+
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CapsCacheVPL::CopyImplFuncs(const mfxImplementedFunctions* implFuncs,
+                                      std::vector<mfxU64>& blob) {
+    if (!implFuncs)
+        return MFX_ERR_NULL_PTR;
+
+    CapsWriter w;
+
+    size_t f   = w.Append(implFuncs, sizeof(mfxImplementedFunctions));
+    auto names = w.AppendArray(implFuncs->FunctionsName, implFuncs->NumFunctions);
+    w.At<mfxImplementedFunctions>(f)->FunctionsName = names;
+    if (!names)
+        w.At<mfxImplementedFunctions>(f)->NumFunctions = 0;
+
+    for (mfxU32 i = 0; names && i < implFuncs->NumFunctions; i++) {
+        const mfxChar* name = implFuncs->FunctionsName[i] ? implFuncs->FunctionsName[i] : "";
+        *w.At(names, i)     = (mfxChar*)(uintptr_t)w.Append(name, strlen(name) + 1);
+    }
+
+    w.GetBlob(blob);
+
+    CapsRelocator r((mfxU8*)blob.data(), blob.size() * sizeof(mfxU64), false);
+    if (!r.RelocateImplFuncs()) {
+        blob.clear();
+        return MFX_ERR_UNKNOWN;
+    }
+
+    return MFX_ERR_NONE;
+}
+
+CapsCacheVPL::CapsCacheVPL()
+        : m_cacheDir(),
+          m_bShmEnabled(false),
+          m_bShmStale(false),
+          m_shmBase(nullptr),
+          m_shmSize(0),
+          m_shmMutex(),
+          m_shmEntries() {}
+
+CapsCacheVPL::~CapsCacheVPL() {
+    UnmapSharedSnapshot();
+}
+
+bool CapsCacheVPL::Init() {
+    m_cacheDir.clear();
+
+    mfxU32 useShm = 0;
+    if (GetEnvVarU32(ENV_ONEVPL_CAPS_SHM, &useShm) && useShm)
+        MapSharedSnapshot();
+
+#if defined(_WIN32) || defined(_WIN64)
+    CHAR_TYPE envVar[MAX_VPL_SEARCH_PATH] = { L"" };
+    if (!GetEnvironmentVariableW(ENV_ONEVPL_CAPS_CACHE_DIR, envVar, MAX_VPL_SEARCH_PATH))
+        return IsEnabled();
+
+    m_cacheDir = envVar;
+    _wmkdir(m_cacheDir.c_str());
+#else
+    CHAR_TYPE* envVar = getenv(ENV_ONEVPL_CAPS_CACHE_DIR);
+    if (!envVar)
+        return IsEnabled();
+
+    m_cacheDir = envVar;
+    mkdir(m_cacheDir.c_str(), 0700);
+
+    // entries are trusted, so only use a directory that no other user can write to
+    struct stat st;
+    if (stat(m_cacheDir.c_str(), &st) || !S_ISDIR(st.st_mode) || st.st_uid != getuid() ||
+        (st.st_mode & (S_IWGRP | S_IWOTH)))
+        m_cacheDir.clear();
+#endif
+
+    return IsEnabled();
+}
+
+// one file per library, named with 64-bit FNV-1a hash of the full path
+STRING_TYPE CapsCacheVPL::GetEntryFileName(const STRING_TYPE& libNameFull) {
+    mfxU64 hash         = 0xcbf29ce484222325ULL;
+    const mfxU8* p      = (const mfxU8*)libNameFull.c_str();
+    const size_t nBytes = libNameFull.size() * sizeof(CHAR_TYPE);
+    for (size_t i = 0; i < nBytes; i++) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    CHAR_TYPE hashName[32];
+#if defined(_WIN32) || defined(_WIN64)
+    swprintf(hashName, 32, L"%016llx.caps", (unsigned long long)hash);
+#else
+    snprintf(hashName, 32, "%016llx.caps", (unsigned long long)hash);
+#endif
+
+    return m_cacheDir + MAKE_STRING("/") + hashName;
+}
+
+// parse one cache entry (see CapsCacheFileHeader) and fill in libInfo if it is valid
+//   for the current version of the library
+static mfxStatus ParseEntry(const mfxU8* data,
+                            size_t dataSize,
+                            const CapsCacheKey& key,
+                            LibInfo* libInfo) {
+    // check that header matches current library and build
+    CapsCacheFileHeader hdr;
+    if (dataSize < sizeof(hdr))
+        return MFX_ERR_NOT_FOUND;
+    memcpy(&hdr, data, sizeof(hdr));
+
+    if (memcmp(hdr.magic, CapsCacheMagic, sizeof(CapsCacheMagic)) ||
+        hdr.formatVersion != CAPS_CACHE_FORMAT_VERSION || hdr.ptrSize != sizeof(void*) ||
+        hdr.libSize != key.libSize || hdr.libMTime != key.libMTime ||
+        hdr.libInode != key.libInode || hdr.libDevice != key.libDevice)
+        return MFX_ERR_NOT_FOUND;
+
+    if (hdr.libType != LibTypeVPL && hdr.libType != LibTypeMSDK && hdr.libType != LibTypeUnknown)
+        return MFX_ERR_NOT_FOUND;
+
+    // MSDK libraries always have one implementation, failed probes are not saved
+    if (hdr.libType == LibTypeMSDK && hdr.numImpls != 1)
+        return MFX_ERR_NOT_FOUND;
+
+    size_t pos         = sizeof(hdr);
+    size_t libNameSize = libInfo->libNameFull.size() * sizeof(CHAR_TYPE);
+    if (hdr.libNameLen != libNameSize || dataSize - pos < libNameSize ||
+        memcmp(data + pos, libInfo->libNameFull.c_str(), libNameSize))
+        return MFX_ERR_NOT_FOUND;
+    pos += libNameSize;
+
+    std::list<ImplCapsBlob> implCapsList;
+    for (mfxU32 i = 0; i < hdr.numImpls; i++) {
+        mfxU64 sizes[2];
+        if (dataSize - pos < sizeof(sizes))
+            return MFX_ERR_NOT_FOUND;
+        memcpy(sizes, data + pos, sizeof(sizes));
+        pos += sizeof(sizes);
+
+        ImplCapsBlob implCaps;
+        std::vector<mfxU64>* blobs[2] = { &implCaps.implDesc, &implCaps.implFuncs };
+        for (mfxU32 j = 0; j < 2; j++) {
+            if ((sizes[j] % sizeof(mfxU64)) || dataSize - pos < sizes[j])
+                return MFX_ERR_NOT_FOUND;
+
+            blobs[j]->resize((size_t)(sizes[j] / sizeof(mfxU64)));
+            if (sizes[j])
+                memcpy(blobs[j]->data(), data + pos, (size_t)sizes[j]);
+            pos += (size_t)sizes[j];
+        }
+
+        // description is required, list of functions is optional (API >= 2.2)
+        CapsRelocator rDesc((mfxU8*)implCaps.implDesc.data(), (size_t)sizes[0], false);
+        if (!rDesc.RelocateImplDesc())
+            return MFX_ERR_NOT_FOUND;
+
+        CapsRelocator rFuncs((mfxU8*)implCaps.implFuncs.data(), (size_t)sizes[1], false);
+        if (sizes[1] && !rFuncs.RelocateImplFuncs())
+            return MFX_ERR_NOT_FOUND;
+
+        implCapsList.push_back(std::move(implCaps));
+    }
+
+    libInfo->libType     = (LibType)hdr.libType;
+    libInfo->bCapsCached = true;
+    libInfo->cachedCaps  = std::move(implCapsList);
+
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CapsCacheVPL::LoadEntry(LibInfo* libInfo) {
+    if (!IsEnabled())
+        return MFX_ERR_NOT_INITIALIZED;
+
+    CapsCacheKey key;
+    if (GetCacheKey(libInfo->libNameFull, &key))
+        return MFX_ERR_NOT_FOUND;
+
+    // check shared snapshot first, then per-library file
+    std::vector<mfxU8> data;
+    if (FindSharedEntry(libInfo->libNameFull, data) &&
+        ParseEntry(data.data(), data.size(), key, libInfo) == MFX_ERR_NONE) {
+        AddSharedEntry(libInfo->libNameFull, data, false);
+        return MFX_ERR_NONE;
+    }
+
+    if (m_cacheDir.empty())
+        return MFX_ERR_NOT_FOUND;
+
+    STRING_TYPE fileName = GetEntryFileName(libInfo->libNameFull);
+    FILE* f              = OpenCacheFile(fileName);
+    if (!f)
+        return MFX_ERR_NOT_FOUND;
+
+    data.clear();
+    mfxU8 readBuf[4096];
+    size_t n;
+    while ((n = fread(readBuf, 1, sizeof(readBuf), f)) > 0)
+        data.insert(data.end(), readBuf, readBuf + n);
+    fclose(f);
+
+    mfxStatus sts = ParseEntry(data.data(), data.size(), key, libInfo);
+    if (sts != MFX_ERR_NONE)
+        return sts;
+
+    // shared snapshot did not have this entry
+    AddSharedEntry(libInfo->libNameFull, data, true);
+
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CapsCacheVPL::StoreEntry(LibInfo* libInfo, const std::list<ImplCapsBlob>& implCapsList) {
+    if (!IsEnabled())
+        return MFX_ERR_NOT_INITIALIZED;
+
+    CapsCacheKey key;
+    if (GetCacheKey(libInfo->libNameFull, &key))
+        return MFX_ERR_NOT_FOUND;
+
+    CapsCacheFileHeader hdr = {};
+    memcpy(hdr.magic, CapsCacheMagic, sizeof(CapsCacheMagic));
+    hdr.formatVersion = CAPS_CACHE_FORMAT_VERSION;
+    hdr.ptrSize       = sizeof(void*);
+    hdr.libSize       = key.libSize;
+    hdr.libMTime      = key.libMTime;
+    hdr.libInode      = key.libInode;
+    hdr.libDevice     = key.libDevice;
+    hdr.libType       = (mfxI32)libInfo->libType;
+    hdr.numImpls      = (mfxU32)implCapsList.size();
+    hdr.libNameLen    = (mfxU32)(libInfo->libNameFull.size() * sizeof(CHAR_TYPE));
+
+    // size the entry once, then copy each part to its offset
+    size_t dataSize = sizeof(hdr) + hdr.libNameLen;
+    for (auto& implCaps : implCapsList)
+        dataSize += 2 * sizeof(mfxU64) +
+                    (implCaps.implDesc.size() + implCaps.implFuncs.size()) * sizeof(mfxU64);
+
+    std::vector<mfxU8> data(dataSize);
+    size_t offset = 0;
+
+    memcpy(data.data() + offset, &hdr, sizeof(hdr));
+    offset += sizeof(hdr);
+
+    memcpy(data.data() + offset, libInfo->libNameFull.c_str(), hdr.libNameLen);
+    offset += hdr.libNameLen;
+
+    for (auto& implCaps : implCapsList) {
+        // pointers are saved as offsets from the start of each blob
+        std::vector<mfxU64> blobDesc  = implCaps.implDesc;
+        std::vector<mfxU64> blobFuncs = implCaps.implFuncs;
+
+        CapsRelocator rDesc((mfxU8*)blobDesc.data(),
+                            blobDesc.size() * sizeof(mfxU64),
+                            true,
+                            (const mfxU8*)implCaps.implDesc.data());
+        if (!rDesc.RelocateImplDesc())
+            return MFX_ERR_UNKNOWN;
+
+        CapsRelocator rFuncs((mfxU8*)blobFuncs.data(),
+                             blobFuncs.size() * sizeof(mfxU64),
+                             true,
+                             (const mfxU8*)implCaps.implFuncs.data());
+        if (!blobFuncs.empty() && !rFuncs.RelocateImplFuncs())
+            return MFX_ERR_UNKNOWN;
+
+        mfxU64 sizes[2] = { blobDesc.size() * sizeof(mfxU64), blobFuncs.size() * sizeof(mfxU64) };
+        memcpy(data.data() + offset, sizes, sizeof(sizes));
+        offset += sizeof(sizes);
+
+        if (sizes[0])
+            memcpy(data.data() + offset, blobDesc.data(), (size_t)sizes[0]);
+        offset += (size_t)sizes[0];
+
+        if (sizes[1])
+            memcpy(data.data() + offset, blobFuncs.data(), (size_t)sizes[1]);
+        offset += (size_t)sizes[1];
+    }
+
+    AddSharedEntry(libInfo->libNameFull, data, true);
+
+    if (m_cacheDir.empty())
+        return MFX_ERR_NONE;
+
+    // write to temporary file, then replace the entry
+    STRING_TYPE fileName = GetEntryFileName(libInfo->libNameFull);
+    STRING_TYPE tmpName;
+
+    FILE* f = OpenTempCacheFile(fileName, tmpName);
+    if (!f)
+        return MFX_ERR_UNKNOWN;
+
+    size_t nWritten = fwrite(data.data(), 1, data.size(), f);
+    fclose(f);
+
+    if (nWritten != data.size() || !ReplaceCacheFile(tmpName, fileName)) {
+        RemoveCacheFile(tmpName);
+        return MFX_ERR_UNKNOWN;
+    }
+
+    return MFX_ERR_NONE;
+}
+
+#if defined(_WIN32) || defined(_WIN64)
+
+// shared snapshot is not supported on Windows - per-library cache files are used instead
+void CapsCacheVPL::MapSharedSnapshot() {}
+
+void CapsCacheVPL::UnmapSharedSnapshot() {}
+
+bool CapsCacheVPL::FindSharedEntry(const STRING_TYPE& libNameFull, std::vector<mfxU8>& entry) {
+    return false;
+}
+
+void CapsCacheVPL::PublishSharedSnapshot() {}
+
+#else
+
+// one segment per user, so that other users cannot inject caps
+static std::string GetShmName() {
+    return std::string(CAPS_SHM_NAME_PREFIX) + std::to_string((unsigned long)getuid());
+}
+
+// map existing snapshot read-only, if any
+// shared mode is enabled even if there is no snapshot yet, so that one is published after
+//   the first full query
+void CapsCacheVPL::MapSharedSnapshot() {
+    m_bShmEnabled = true;
+
+    int fd = shm_open(GetShmName().c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return;
+
+    struct stat st;
+    if (fstat(fd, &st) || st.st_uid != getuid() || (size_t)st.st_size < sizeof(CapsShmHeader)) {
+        close(fd);
+        return;
+    }
+
+    void* base = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return;
+
+    CapsShmHeader hdr;
+    memcpy(&hdr, base, sizeof(hdr));
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    if (memcmp(hdr.magic, CapsShmMagic, sizeof(CapsShmMagic)) ||
+        hdr.formatVersion != CAPS_CACHE_FORMAT_VERSION || hdr.ptrSize != sizeof(void*) ||
+        hdr.totalSize != (mfxU64)st.st_size) {
+        munmap(base, (size_t)st.st_size);
+        return;
+    }
+
+    m_shmBase = (const mfxU8*)base;
+    m_shmSize = (size_t)st.st_size;
+}
+
+void CapsCacheVPL::UnmapSharedSnapshot() {
+    if (m_shmBase)
+        munmap((void*)m_shmBase, m_shmSize);
+
+    m_shmBase = nullptr;
+    m_shmSize = 0;
+}
+
+// copy entry for this library out of the shared snapshot
+// entry is validated against the library on disk by the caller
+bool CapsCacheVPL::FindSharedEntry(const STRING_TYPE& libNameFull, std::vector<mfxU8>& entry) {
+    if (!m_shmBase)
+        return false;
+
+    CapsShmHeader shmHdr;
+    memcpy(&shmHdr, m_shmBase, sizeof(shmHdr));
+
+    size_t libNameSize = libNameFull.size() * sizeof(CHAR_TYPE);
+    size_t pos         = sizeof(shmHdr);
+    for (mfxU32 i = 0; i < shmHdr.numEntries; i++) {
+        mfxU64 entrySize;
+        if (m_shmSize - pos < sizeof(entrySize))
+            return false;
+        memcpy(&entrySize, m_shmBase + pos, sizeof(entrySize));
+        pos += sizeof(entrySize);
+
+        if (m_shmSize - pos < entrySize)
+            return false;
+
+        const mfxU8* entryData = m_shmBase + pos;
+        pos += (size_t)entrySize;
+
+        CapsCacheFileHeader hdr;
+        if (entrySize < sizeof(hdr))
+            continue;
+        memcpy(&hdr, entryData, sizeof(hdr));
+
+        if (hdr.libNameLen != libNameSize || entrySize - sizeof(hdr) < libNameSize ||
+            memcmp(entryData + sizeof(hdr), libNameFull.c_str(), libNameSize))
+            continue;
+
+        entry.assign(entryData, entryData + entrySize);
+        return true;
+    }
+
+    return false;
+}
+
+// replace shared snapshot with the entries for all libraries seen by this process,
+//   if any of them was not in the previous snapshot (new or changed library)
+// segments mapped by other processes remain valid until they are unmapped
+void CapsCacheVPL::PublishSharedSnapshot() {
+    std::lock_guard<std::mutex> lock(m_shmMutex);
+
+    if (!m_bShmEnabled || !m_bShmStale)
+        return;
+
+    m_bShmStale = false;
+
+    CapsShmHeader hdr = {};
+    hdr.formatVersion = CAPS_CACHE_FORMAT_VERSION;
+    hdr.ptrSize       = sizeof(void*);
+    hdr.numEntries    = (mfxU32)m_shmEntries.size();
+    hdr.totalSize     = sizeof(hdr);
+    for (auto& e : m_shmEntries)
+        hdr.totalSize += sizeof(mfxU64) + e.second.size();
+
+    std::string shmName = GetShmName();
+    shm_unlink(shmName.c_str());
+
+    // if another process is publishing at the same time, let it finish
+    int fd = shm_open(shmName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+        return;
+
+    void* base = MAP_FAILED;
+    if (ftruncate(fd, (off_t)hdr.totalSize) == 0)
+        base = mmap(nullptr, (size_t)hdr.totalSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (base == MAP_FAILED) {
+        shm_unlink(shmName.c_str());
+        return;
+    }
+
+    mfxU8* dst = (mfxU8*)base;
+    memcpy(dst, &hdr, sizeof(hdr));
+
+    size_t pos = sizeof(hdr);
+    for (auto& e : m_shmEntries) {
+        mfxU64 entrySize = e.second.size();
+        memcpy(dst + pos, &entrySize, sizeof(entrySize));
+        pos += sizeof(entrySize);
+        memcpy(dst + pos, e.second.data(), e.second.size());
+        pos += e.second.size();
+    }
+
+    // readers ignore the segment until the magic is set
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(dst, CapsShmMagic, sizeof(CapsShmMagic));
+
+    munmap(base, (size_t)hdr.totalSize);
+}
+
+#endif
+
+// remember entry for next shared snapshot
+// bNew indicates that the entry was not found in the current snapshot
+// may be called concurrently (parallel library query)
+void CapsCacheVPL::AddSharedEntry(const STRING_TYPE& libNameFull,
+                                  const std::vector<mfxU8>& entry,
+                                  bool bNew) {
+    if (!m_bShmEnabled)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_shmMutex);
+
+    m_shmEntries[libNameFull] = entry;
+    if (bNew)
+        m_bShmStale = true;
+}
@@ -7,6 +7,7 @@
 #include "vpl/mfx_dispatcher_vpl.h"
 
 #include <assert.h>
+#include <string.h>
 
 // implementation of config context (mfxConfig)
 // each loader instance can have one or more configs
@@ -16,7 +17,6 @@ ConfigCtxVPL::ConfigCtxVPL()
         : m_propName(),
           m_propValue(),
           m_propIdx(),
-          m_propParsedString(),
           m_propRange32U(),
           m_implName(),
           m_implLicense(),
@@ -204,154 +204,93 @@ mfxStatus ConfigCtxVPL::ValidateAndSetProp(mfxI32 idx, mfxVariant value) {
     return MFX_ERR_NONE;
 }
 
-mfxStatus ConfigCtxVPL::SetFilterPropertyDec(mfxVariant value) {
-    std::string nextProp;
-
-    nextProp = GetNextProp(&m_propParsedString);
-
-    // no settable top-level members
-    if (nextProp != "decoder")
-        return MFX_ERR_NOT_FOUND;
-
-    // parse 'decoder'
-    nextProp = GetNextProp(&m_propParsedString);
-    if (nextProp == "CodecID") {
-        return ValidateAndSetProp(ePropDec_CodecID, value);
-    }
-    else if (nextProp == "MaxcodecLevel") {
-        return ValidateAndSetProp(ePropDec_MaxcodecLevel, value);
-    }
-    else if (nextProp != "decprofile") {
-        return MFX_ERR_NOT_FOUND;
-    }
-
-    // parse 'decprofile'
-    nextProp = GetNextProp(&m_propParsedString);
-    if (nextProp == "Profile") {
-        return ValidateAndSetProp(ePropDec_Profile, value);
-    }
-    else if (nextProp != "decmemdesc") {
-        return MFX_ERR_NOT_FOUND;
-    }
-
-    // parse 'decmemdesc'
-    nextProp = GetNextProp(&m_propParsedString);
-    if (nextProp == "MemHandleType") {
-        return ValidateAndSetProp(ePropDec_MemHandleType, value);
-    }
-    else if (nextProp == "Width") {
-        return ValidateAndSetProp(ePropDec_Width, value);
-    }
-    else if (nextProp == "Height") {
-        return ValidateAndSetProp(ePropDec_Height, value);
-    }
-    else if (nextProp == "ColorFormat" || nextProp == "ColorFormats") {
-        return ValidateAndSetProp(ePropDec_ColorFormats, value);
-    }
-
-    // end of mfxDecoderDescription options
-    return MFX_ERR_NOT_FOUND;
-}
-
-mfxStatus ConfigCtxVPL::SetFilterPropertyEnc(mfxVariant value) {
-    std::string nextProp;
-
-    nextProp = GetNextProp(&m_propParsedString);
-
-    // no settable top-level members
-    if (nextProp != "encoder")
-        return MFX_ERR_NOT_FOUND;
-
-    // parse 'encoder'
-    nextProp = GetNextProp(&m_propParsedString);
-    if (nextProp == "CodecID") {
-        return ValidateAndSetProp(ePropEnc_CodecID, value);
-    }
-    else if (nextProp == "MaxcodecLevel") {
-        return ValidateAndSetProp(ePropEnc_MaxcodecLevel, value);
-    }
-    else if (nextProp == "BiDirectionalPrediction") {
-        return ValidateAndSetProp(ePropEnc_BiDirectionalPrediction, value);
-    }
-    else if (nextProp != "encprofile") {
-        return MFX_ERR_NOT_FOUND;
-    }
-
-    // parse 'encprofile'
-    nextProp = GetNextProp(&m_propParsedString);
-    if (nextProp == "Profile") {
-        return ValidateAndSetProp(ePropEnc_Profile, value);
-    }
-    else if (nextProp != "encmemdesc") {
-        return MFX_ERR_NOT_FOUND;
-    }
-
-    // parse 'encmemdesc'
-    nextProp = GetNextProp(&m_propParsedString);
-    if (nextProp == "MemHandleType") {
-        return ValidateAndSetProp(ePropEnc_MemHandleType, value);
-    }
-    else if (nextProp == "Width") {
-        return ValidateAndSetProp(ePropEnc_Width, value);
-    }
-    else if (nextProp == "Height") {
-        return ValidateAndSetProp(ePropEnc_Height, value);
-    }
-    else if (nextProp == "ColorFormat" || nextProp == "ColorFormats") {
-        return ValidateAndSetProp(ePropEnc_ColorFormats, value);
-    }
-
-    // end of mfxEncoderDescription options
-    return MFX_ERR_NOT_FOUND;
-}
-
-mfxStatus ConfigCtxVPL::SetFilterPropertyVPP(mfxVariant value) {
-    std::string nextProp;
-
-    nextProp = GetNextProp(&m_propParsedString);
+struct PropPath {
+    const char *Path;
+    PropIdx Idx;
+};
 
-    // no settable top-level members
-    if (nextProp != "filter")
-        return MFX_ERR_NOT_FOUND;
+// leave table formatting alone
+// clang-format off
 
-    // parse 'filter'
-    nextProp = GetNextProp(&m_propParsedString);
-    if (nextProp == "FilterFourCC") {
-        return ValidateAndSetProp(ePropVPP_FilterFourCC, value);
-    }
-    else if (nextProp == "MaxDelayInFrames") {
-        return ValidateAndSetProp(ePropVPP_MaxDelayInFrames, value);
-    }
-    else if (nextProp != "memdesc") {
-        return MFX_ERR_NOT_FOUND;
-    }
+// full property name passed to MFXSetConfigFilterProperty() for each settable property
+// some properties accept more than one name (e.g. ColorFormat and ColorFormats)
+// entries may be in any order - a sorted copy is used for lookup
+static const PropPath PropPathTab[] = {
+    { "mfxImplDescription.Impl",                                                        ePropMain_Impl },
+    { "mfxImplDescription.AccelerationMode",                                            ePropMain_AccelerationMode },
+    { "mfxImplDescription.ApiVersion.Version",                                          ePropMain_ApiVersion },
+    { "mfxImplDescription.ApiVersion.Major",                                            ePropMain_ApiVersion_Major },
+    { "mfxImplDescription.ApiVersion.Minor",                                            ePropMain_ApiVersion_Minor },
+    { "mfxImplDescription.ImplName",                                                    ePropMain_ImplName },
+    { "mfxImplDescription.License",                                                     ePropMain_License },
+    { "mfxImplDescription.Keywords",                                                    ePropMain_Keywords },
+    { "mfxImplDescription.VendorID",                                                    ePropMain_VendorID },
+    { "mfxImplDescription.VendorImplID",                                                ePropMain_VendorImplID },
+
+    { "mfxImplDescription.mfxDeviceDescription.device.DeviceID",                        ePropDevice_DeviceID },
+
+    { "mfxImplDescription.mfxDecoderDescription.decoder.CodecID",                       ePropDec_CodecID },
+    { "mfxImplDescription.mfxDecoderDescription.decoder.MaxcodecLevel",                 ePropDec_MaxcodecLevel },
+    { "mfxImplDescription.mfxDecoderDescription.decoder.decprofile.Profile",            ePropDec_Profile },
+    { "mfxImplDescription.mfxDecoderDescription.decoder.decprofile.decmemdesc.MemHandleType", ePropDec_MemHandleType },
+    { "mfxImplDescription.mfxDecoderDescription.decoder.decprofile.decmemdesc.Width",   ePropDec_Width },
+    { "mfxImplDescription.mfxDecoderDescription.decoder.decprofile.decmemdesc.Height",  ePropDec_Height },
+    { "mfxImplDescription.mfxDecoderDescription.decoder.decprofile.decmemdesc.ColorFormat",  ePropDec_ColorFormats },
+    { "mfxImplDescription.mfxDecoderDescription.decoder.decprofile.decmemdesc.ColorFormats", ePropDec_ColorFormats },
+
+    { "mfxImplDescription.mfxEncoderDescription.encoder.CodecID",                       ePropEnc_CodecID },
+    { "mfxImplDescription.mfxEncoderDescription.encoder.MaxcodecLevel",                 ePropEnc_MaxcodecLevel },
+    { "mfxImplDescription.mfxEncoderDescription.encoder.BiDirectionalPrediction",       ePropEnc_BiDirectionalPrediction },
+    { "mfxImplDescription.mfxEncoderDescription.encoder.encprofile.Profile",            ePropEnc_Profile },
+    { "mfxImplDescription.mfxEncoderDescription.encoder.encprofile.encmemdesc.MemHandleType", ePropEnc_MemHandleType },
+    { "mfxImplDescription.mfxEncoderDescription.encoder.encprofile.encmemdesc.Width",   ePropEnc_Width },
+    { "mfxImplDescription.mfxEncoderDescription.encoder.encprofile.encmemdesc.Height",  ePropEnc_Height },
+    { "mfxImplDescription.mfxEncoderDescription.encoder.encprofile.encmemdesc.ColorFormat",  ePropEnc_ColorFormats },
+    { "mfxImplDescription.mfxEncoderDescription.encoder.encprofile.encmemdesc.ColorFormats", ePropEnc_ColorFormats },
+
+    { "mfxImplDescription.mfxVPPDescription.filter.FilterFourCC",                       ePropVPP_FilterFourCC },
+    { "mfxImplDescription.mfxVPPDescription.filter.MaxDelayInFrames",                   ePropVPP_MaxDelayInFrames },
+    { "mfxImplDescription.mfxVPPDescription.filter.memdesc.MemHandleType",              ePropVPP_MemHandleType },
+    { "mfxImplDescription.mfxVPPDescription.filter.memdesc.Width",                      ePropVPP_Width },
+    { "mfxImplDescription.mfxVPPDescription.filter.memdesc.Height",                     ePropVPP_Height },
+    { "mfxImplDescription.mfxVPPDescription.filter.memdesc.format.InFormat",            ePropVPP_InFormat },
+    { "mfxImplDescription.mfxVPPDescription.filter.memdesc.format.OutFormat",           ePropVPP_OutFormat },
+    { "mfxImplDescription.mfxVPPDescription.filter.memdesc.format.OutFormats",          ePropVPP_OutFormat },
+
+    { "mfxHandleType",                                                                  ePropSpecial_HandleType },
+    { "mfxHDL",                                                                         ePropSpecial_Handle },
 
-    // parse 'memdesc'
-    nextProp = GetNextProp(&m_propParsedString);
-    if (nextProp == "MemHandleType") {
-        return ValidateAndSetProp(ePropVPP_MemHandleType, value);
-    }
-    else if (nextProp == "Width") {
-        return ValidateAndSetProp(ePropVPP_Width, value);
-    }
-    else if (nextProp == "Height") {
-        return ValidateAndSetProp(ePropVPP_Height, value);
-    }
-    else if (nextProp != "format") {
-        return MFX_ERR_NOT_FOUND;
-    }
+    // to require that a specific function is implemented, use the property name
+    //   "mfxImplementedFunctions.FunctionsName"
+    { "mfxImplementedFunctions.FunctionsName",                                          ePropFunc_FunctionName },
+};
 
-    // parse 'format'
-    nextProp = GetNextProp(&m_propParsedString);
-    if (nextProp == "InFormat") {
-        return ValidateAndSetProp(ePropVPP_InFormat, value);
-    }
-    else if (nextProp == "OutFormat" || nextProp == "OutFormats") {
-        return ValidateAndSetProp(ePropVPP_OutFormat, value);
-    }
+// end table formatting
+// clang-format on
 
-    // end of mfxVPPDescription options
-    return MFX_ERR_NOT_FOUND;
+// find property index from full property name with binary search of the sorted table
+// returns -1 if name is not a settable property
+static mfxI32 GetPropIdx(const char *name) {
+    // sorted once, on first use (thread-safe initialization of local static)
+    static const std::vector<PropPath> sortedTab = []() {
+        std::vector<PropPath> tab(std::begin(PropPathTab), std::end(PropPathTab));
+        std::sort(tab.begin(), tab.end(), [](const PropPath &a, const PropPath &b) {
+            return strcmp(a.Path, b.Path) < 0;
+        });
+        return tab;
+    }();
+
+    auto it = std::lower_bound(sortedTab.begin(),
+                               sortedTab.end(),
+                               name,
+                               [](const PropPath &a, const char *b) {
+                                   return strcmp(a.Path, b) < 0;
+                               });
+
+    if (it == sortedTab.end() || strcmp(it->Path, name) != 0)
+        return -1;
+
+    return it->Idx;
 }
 
 // return codes (from spec):
@@ -372,105 +311,11 @@ mfxStatus ConfigCtxVPL::SetFilterProperty(const mfxU8 *name, mfxVariant value) {
     m_propValue.Type     = MFX_VARIANT_TYPE_UNSET;
     m_propValue.Data.U32 = 0;
 
-    // parse property string into individual properties,
-    //   separated by '.'
-    std::stringstream prop((char *)name);
-    std::string s;
-    while (getline(prop, s, '.')) {
-        m_propParsedString.push_back(s);
-    }
-
-    // get first property descriptor
-    std::string nextProp = GetNextProp(&m_propParsedString);
-
-    // check for special-case properties, not part of mfxImplDescription
-    if (nextProp == "mfxHandleType") {
-        return ValidateAndSetProp(ePropSpecial_HandleType, value);
-    }
-    else if (nextProp == "mfxHDL") {
-        return ValidateAndSetProp(ePropSpecial_Handle, value);
-    }
-
-    // to require that a specific function is implemented, use the property name
-    //   "mfxImplementedFunctions.FunctionsName"
-    if (nextProp == "mfxImplementedFunctions") {
-        nextProp = GetNextProp(&m_propParsedString);
-        if (nextProp == "FunctionsName") {
-            return ValidateAndSetProp(ePropFunc_FunctionName, value);
-        }
-        return MFX_ERR_NOT_FOUND;
-    }
-
-    // standard properties must begin with "mfxImplDescription"
-    if (nextProp != "mfxImplDescription") {
+    mfxI32 idx = GetPropIdx((const char *)name);
+    if (idx < 0)
         return MFX_ERR_NOT_FOUND;
-    }
-
-    // get next property descriptor
-    nextProp = GetNextProp(&m_propParsedString);
-
-    // property is a top-level member of mfxImplDescription
-    if (nextProp == "Impl") {
-        return ValidateAndSetProp(ePropMain_Impl, value);
-    }
-    else if (nextProp == "AccelerationMode") {
-        return ValidateAndSetProp(ePropMain_AccelerationMode, value);
-    }
-    else if (nextProp == "ApiVersion") {
-        // ApiVersion may be passed as single U32 (Version) or two U16's (Major, Minor)
-        nextProp = GetNextProp(&m_propParsedString);
-        if (nextProp == "Version")
-            return ValidateAndSetProp(ePropMain_ApiVersion, value);
-        else if (nextProp == "Major")
-            return ValidateAndSetProp(ePropMain_ApiVersion_Major, value);
-        else if (nextProp == "Minor")
-            return ValidateAndSetProp(ePropMain_ApiVersion_Minor, value);
-        else
-            return MFX_ERR_NOT_FOUND;
-    }
-    else if (nextProp == "VendorID") {
-        return ValidateAndSetProp(ePropMain_VendorID, value);
-    }
-    else if (nextProp == "ImplName") {
-        return ValidateAndSetProp(ePropMain_ImplName, value);
-    }
-    else if (nextProp == "License") {
-        return ValidateAndSetProp(ePropMain_License, value);
-    }
-    else if (nextProp == "Keywords") {
-        return ValidateAndSetProp(ePropMain_Keywords, value);
-    }
-    else if (nextProp == "VendorImplID") {
-        return ValidateAndSetProp(ePropMain_VendorImplID, value);
-    }
-
-    // property is a member of mfxDeviceDescription
-    // currently only settable parameter is DeviceID
-    if (nextProp == "mfxDeviceDescription") {
-        nextProp = GetNextProp(&m_propParsedString);
-        if (nextProp == "device") {
-            nextProp = GetNextProp(&m_propParsedString);
-            if (nextProp == "DeviceID") {
-                return ValidateAndSetProp(ePropDevice_DeviceID, value);
-            }
-        }
-        return MFX_ERR_NOT_FOUND;
-    }
-
-    // property is a member of mfxDecoderDescription
-    if (nextProp == "mfxDecoderDescription") {
-        return SetFilterPropertyDec(value);
-    }
-
-    if (nextProp == "mfxEncoderDescription") {
-        return SetFilterPropertyEnc(value);
-    }
-
-    if (nextProp == "mfxVPPDescription") {
-        return SetFilterPropertyVPP(value);
-    }
 
-    return MFX_ERR_NOT_FOUND;
+    return ValidateAndSetProp(idx, value);
 }
 
 #define CHECK_IDX(idxA, idxB, numB) \
@@ -481,7 +326,7 @@ mfxStatus ConfigCtxVPL::SetFilterProperty(const mfxU8 *name, mfxVariant value) {
     }
 
 mfxStatus ConfigCtxVPL::GetFlatDescriptionsDec(mfxImplDescription *libImplDesc,
-                                               std::list<DecConfig> &decConfigList) {
+                                               std::vector<DecConfig> &decConfigList) {
     mfxU32 codecIdx   = 0;
     mfxU32 profileIdx = 0;
     mfxU32 memIdx     = 0;
@@ -523,7 +368,7 @@ mfxStatus ConfigCtxVPL::GetFlatDescriptionsDec(mfxImplDescription *libImplDesc,
 }
 
 mfxStatus ConfigCtxVPL::GetFlatDescriptionsEnc(mfxImplDescription *libImplDesc,
-                                               std::list<EncConfig> &encConfigList) {
+                                               std::vector<EncConfig> &encConfigList) {
     mfxU32 codecIdx   = 0;
     mfxU32 profileIdx = 0;
     mfxU32 memIdx     = 0;
@@ -566,7 +411,7 @@ mfxStatus ConfigCtxVPL::GetFlatDescriptionsEnc(mfxImplDescription *libImplDesc,
 }
 
 mfxStatus ConfigCtxVPL::GetFlatDescriptionsVPP(mfxImplDescription *libImplDesc,
-                                               std::list<VPPConfig> &vppConfigList) {
+                                               std::vector<VPPConfig> &vppConfigList) {
     mfxU32 filterIdx = 0;
     mfxU32 memIdx    = 0;
     mfxU32 inFmtIdx  = 0;
@@ -607,6 +452,35 @@ mfxStatus ConfigCtxVPL::GetFlatDescriptionsVPP(mfxImplDescription *libImplDesc,
     return MFX_ERR_NONE;
 }
 
+// build index of flat configs by key (CodecID or FilterFourCC)
+template <typename T>
+static void BuildFlatConfigIndex(const std::vector<T> &configs,
+                                 mfxU32 T::*key,
+                                 FlatConfigIndex &index) {
+    index.clear();
+    for (mfxU32 i = 0; i < (mfxU32)configs.size(); i++)
+        index[configs[i].*key].push_back(i);
+}
+
+// look up flat configs with matching key (CodecID or FilterFourCC)
+// returns false if key filter is set but no configs match
+// otherwise candidates is set to the list of matching configs, or nullptr if
+//   key filter is not set (all configs must be checked)
+static bool GetFlatConfigCandidates(const mfxVariant &keyProp,
+                                    const FlatConfigIndex &index,
+                                    const std::vector<mfxU32> **candidates) {
+    *candidates = nullptr;
+    if (keyProp.Type == MFX_VARIANT_TYPE_UNSET)
+        return true;
+
+    auto it = index.find(keyProp.Data.U32);
+    if (it == index.end())
+        return false;
+
+    *candidates = &(it->second);
+    return true;
+}
+
 #define CHECK_PROP(idx, type, val)                             \
     if ((cfgPropsAll[(idx)].Type != MFX_VARIANT_TYPE_UNSET) && \
         (cfgPropsAll[(idx)].Data.type != val))                 \
@@ -704,12 +578,18 @@ mfxStatus ConfigCtxVPL::CheckPropsGeneral(mfxVariant cfgPropsAll[],
     return MFX_ERR_UNSUPPORTED;
 }
 
-mfxStatus ConfigCtxVPL::CheckPropsDec(mfxVariant cfgPropsAll[],
-                                      std::list<DecConfig> decConfigList) {
-    auto it = decConfigList.begin();
-    while (it != decConfigList.end()) {
-        DecConfig dc      = (DecConfig)(*it);
-        bool isCompatible = true;
+mfxStatus ConfigCtxVPL::CheckPropsDec(mfxVariant cfgPropsAll[], const ImplFlatCaps &flatCaps) {
+    const std::vector<DecConfig> &decConfigList = flatCaps.decConfigs;
+
+    // if CodecID is set, only the configs with matching CodecID need to be checked
+    const std::vector<mfxU32> *candidates = nullptr;
+    if (!GetFlatConfigCandidates(cfgPropsAll[ePropDec_CodecID], flatCaps.decIndex, &candidates))
+        return MFX_ERR_UNSUPPORTED;
+
+    size_t numConfigs = candidates ? candidates->size() : decConfigList.size();
+    for (size_t i = 0; i < numConfigs; i++) {
+        const DecConfig &dc = decConfigList[candidates ? (*candidates)[i] : i];
+        bool isCompatible   = true;
 
         // check if this decode description includes
         //   all of the required decoder properties
@@ -741,19 +621,23 @@ mfxStatus ConfigCtxVPL::CheckPropsDec(mfxVariant cfgPropsAll[],
 
         if (isCompatible == true)
             return MFX_ERR_NONE;
-
-        it++;
     }
 
     return MFX_ERR_UNSUPPORTED;
 }
 
-mfxStatus ConfigCtxVPL::CheckPropsEnc(mfxVariant cfgPropsAll[],
-                                      std::list<EncConfig> encConfigList) {
-    auto it = encConfigList.begin();
-    while (it != encConfigList.end()) {
-        EncConfig ec      = (EncConfig)(*it);
-        bool isCompatible = true;
+mfxStatus ConfigCtxVPL::CheckPropsEnc(mfxVariant cfgPropsAll[], const ImplFlatCaps &flatCaps) {
+    const std::vector<EncConfig> &encConfigList = flatCaps.encConfigs;
+
+    // if CodecID is set, only the configs with matching CodecID need to be checked
+    const std::vector<mfxU32> *candidates = nullptr;
+    if (!GetFlatConfigCandidates(cfgPropsAll[ePropEnc_CodecID], flatCaps.encIndex, &candidates))
+        return MFX_ERR_UNSUPPORTED;
+
+    size_t numConfigs = candidates ? candidates->size() : encConfigList.size();
+    for (size_t i = 0; i < numConfigs; i++) {
+        const EncConfig &ec = encConfigList[candidates ? (*candidates)[i] : i];
+        bool isCompatible   = true;
 
         // check if this encode description includes
         //   all of the required encoder properties
@@ -786,19 +670,25 @@ mfxStatus ConfigCtxVPL::CheckPropsEnc(mfxVariant cfgPropsAll[],
 
         if (isCompatible == true)
             return MFX_ERR_NONE;
-
-        it++;
     }
 
     return MFX_ERR_UNSUPPORTED;
 }
 
-mfxStatus ConfigCtxVPL::CheckPropsVPP(mfxVariant cfgPropsAll[],
-                                      std::list<VPPConfig> vppConfigList) {
-    auto it = vppConfigList.begin();
-    while (it != vppConfigList.end()) {
-        VPPConfig vc      = (VPPConfig)(*it);
-        bool isCompatible = true;
+mfxStatus ConfigCtxVPL::CheckPropsVPP(mfxVariant cfgPropsAll[], const ImplFlatCaps &flatCaps) {
+    const std::vector<VPPConfig> &vppConfigList = flatCaps.vppConfigs;
+
+    // if FilterFourCC is set, only the configs with matching FilterFourCC need to be checked
+    const std::vector<mfxU32> *candidates = nullptr;
+    if (!GetFlatConfigCandidates(cfgPropsAll[ePropVPP_FilterFourCC],
+                                 flatCaps.vppIndex,
+                                 &candidates))
+        return MFX_ERR_UNSUPPORTED;
+
+    size_t numConfigs = candidates ? candidates->size() : vppConfigList.size();
+    for (size_t i = 0; i < numConfigs; i++) {
+        const VPPConfig &vc = vppConfigList[candidates ? (*candidates)[i] : i];
+        bool isCompatible   = true;
 
         // check if this filter description includes
         //   all of the required VPP properties
@@ -830,8 +720,6 @@ mfxStatus ConfigCtxVPL::CheckPropsVPP(mfxVariant cfgPropsAll[],
 
         if (isCompatible == true)
             return MFX_ERR_NONE;
-
-        it++;
     }
 
     return MFX_ERR_UNSUPPORTED;
@@ -861,40 +749,60 @@ mfxStatus ConfigCtxVPL::CheckPropString(mfxChar *implString, std::string filtStr
     return MFX_ERR_NONE;
 }
 
-mfxStatus ConfigCtxVPL::ValidateConfig(mfxImplDescription *libImplDesc,
-                                       mfxImplementedFunctions *libImplFuncs,
-                                       std::list<ConfigCtxVPL *> configCtxList,
-                                       LibType libType,
+// groups of properties which are checked together
+// used to limit which checks are repeated after a single mfxConfig is changed
+enum PropGroup {
+    PROP_GROUP_NONE    = 0,
+    PROP_GROUP_GENERAL = (1 << 0),
+    PROP_GROUP_DEC     = (1 << 1),
+    PROP_GROUP_ENC     = (1 << 2),
+    PROP_GROUP_VPP     = (1 << 3),
+    PROP_GROUP_FUNC    = (1 << 4),
+
+    PROP_GROUP_ALL = (PROP_GROUP_GENERAL | PROP_GROUP_DEC | PROP_GROUP_ENC | PROP_GROUP_VPP |
+                      PROP_GROUP_FUNC),
+};
+
+static mfxU32 GetPropGroup(mfxI32 idx) {
+    if (idx >= ePropMain_Impl && idx <= ePropDevice_DeviceID)
+        return PROP_GROUP_GENERAL;
+    else if (idx >= ePropDec_CodecID && idx <= ePropDec_ColorFormats)
+        return PROP_GROUP_DEC;
+    else if (idx >= ePropEnc_CodecID && idx <= ePropEnc_ColorFormats)
+        return PROP_GROUP_ENC;
+    else if (idx >= ePropVPP_FilterFourCC && idx <= ePropVPP_OutFormat)
+        return PROP_GROUP_VPP;
+    else if (idx == ePropFunc_FunctionName)
+        return PROP_GROUP_FUNC;
+
+    // special properties do not filter implementations
+    return PROP_GROUP_NONE;
+}
+
+mfxStatus ConfigCtxVPL::BuildFilterSet(const std::vector<ConfigCtxVPL *> &configCtxList,
+                                       ConfigFilterSet *filterSet,
                                        SpecialConfig *specialConfig) {
     mfxU32 idx;
-    mfxStatus sts     = MFX_ERR_NONE;
-    bool decRequested = false;
-    bool encRequested = false;
-    bool vppRequested = false;
 
-    if (!libImplDesc)
+    if (!filterSet || !specialConfig)
         return MFX_ERR_NULL_PTR;
 
-    std::list<DecConfig> decConfigList;
-    std::list<EncConfig> encConfigList;
-    std::list<VPPConfig> vppConfigList;
-
-    // list of functions required to be implemented
-    std::list<std::string> implFunctionList;
-    implFunctionList.clear();
-
-    // save list when multiple filters apply to the the same property
-    //   (e.g two mfxConfig objects with different values for CodecID)
-    std::list<ConfigCtxVPL *> configCtxListDups;
-
     // initially all properties are unset
-    mfxVariant cfgPropsAll[eProp_TotalProps] = {};
+    filterSet->cfgPropsAll.assign(eProp_TotalProps, mfxVariant());
     for (idx = 0; idx < eProp_TotalProps; idx++) {
-        cfgPropsAll[idx].Type = MFX_VARIANT_TYPE_UNSET;
+        filterSet->cfgPropsAll[idx].Type = MFX_VARIANT_TYPE_UNSET;
     }
 
+    filterSet->configCtxListDups.clear();
+    filterSet->implFunctionList.clear();
+    filterSet->decRequested = false;
+    filterSet->encRequested = false;
+    filterSet->vppRequested = false;
+
+    mfxVariant *cfgPropsAll = filterSet->cfgPropsAll.data();
+
     // iterate through all filters and populate cfgPropsAll
-    std::list<ConfigCtxVPL *>::iterator it = configCtxList.begin();
+    auto it = configCtxList.begin();
     while (it != configCtxList.end()) {
         ConfigCtxVPL *config = (*it);
 
@@ -907,7 +815,7 @@ mfxStatus ConfigCtxVPL::ValidateConfig(mfxImplDescription *libImplDesc,
 
         // if property is required function, add to list which will be checked below
         if (idx == ePropFunc_FunctionName) {
-            implFunctionList.push_back(config->m_implFunctionName);
+            filterSet->implFunctionList.push_back(config->m_implFunctionName);
             continue;
         }
 
@@ -917,7 +825,7 @@ mfxStatus ConfigCtxVPL::ValidateConfig(mfxImplDescription *libImplDesc,
 
         // save duplicates for check in second pass (prop has already been set)
         if (cfgPropsAll[idx].Type != MFX_VARIANT_TYPE_UNSET) {
-            configCtxListDups.push_back(config);
+            filterSet->configCtxListDups.push_back(config);
             continue;
         }
 
@@ -925,34 +833,11 @@ mfxStatus ConfigCtxVPL::ValidateConfig(mfxImplDescription *libImplDesc,
         cfgPropsAll[idx].Data = config->m_propValue.Data;
 
         if (idx >= ePropDec_CodecID && idx <= ePropDec_ColorFormats)
-            decRequested = true;
+            filterSet->decRequested = true;
         else if (idx >= ePropEnc_CodecID && idx <= ePropEnc_ColorFormats)
-            encRequested = true;
+            filterSet->encRequested = true;
         else if (idx >= ePropVPP_FilterFourCC && idx <= ePropVPP_OutFormat)
-            vppRequested = true;
-    }
-
-    // check whether required functions are implemented
-    if (!implFunctionList.empty()) {
-        if (!libImplFuncs) {
-            // library did not provide list of implemented functions
-            return MFX_ERR_UNSUPPORTED;
-        }
-
-        auto fn = implFunctionList.begin();
-        while (fn != implFunctionList.end()) {
-            std::string fnName = (*fn++);
-            mfxU32 fnIdx;
-
-            // search for fnName in list of implemented functions
-            for (fnIdx = 0; fnIdx < libImplFuncs->NumFunctions; fnIdx++) {
-                if (fnName == libImplFuncs->FunctionsName[fnIdx])
-                    break;
-            }
-
-            if (fnIdx == libImplFuncs->NumFunctions)
-                return MFX_ERR_UNSUPPORTED;
-        }
+            filterSet->vppRequested = true;
     }
 
     // update any special (including non-filtering) properties, for use by caller
@@ -976,35 +861,97 @@ mfxStatus ConfigCtxVPL::ValidateConfig(mfxImplDescription *libImplDesc,
         specialConfig->accelerationMode =
             (mfxAccelerationMode)cfgPropsAll[ePropMain_AccelerationMode].Data.U32;
 
+    return MFX_ERR_NONE;
+}
+
+mfxStatus ConfigCtxVPL::ValidateConfig(mfxImplDescription *libImplDesc,
+                                       mfxImplementedFunctions *libImplFuncs,
+                                       ImplFlatCaps *flatCaps,
+                                       const ConfigFilterSet &filterSet,
+                                       LibType libType,
+                                       const ConfigCtxVPL *changedConfig) {
+    mfxU32 idx;
+    mfxStatus sts = MFX_ERR_NONE;
+
+    if (!libImplDesc || !flatCaps || filterSet.cfgPropsAll.size() != eProp_TotalProps)
+        return MFX_ERR_NULL_PTR;
+
+    // if only a single config was changed, the implementation already passed all of
+    //   the filters in other groups, so only the group with the changed property is checked
+    mfxU32 checkGroups = PROP_GROUP_ALL;
+    if (changedConfig) {
+        if (changedConfig->m_propValue.Type == MFX_VARIANT_TYPE_UNSET)
+            return MFX_ERR_NONE;
+        checkGroups = GetPropGroup(changedConfig->m_propIdx);
+    }
+
+    // local copy, since second pass below modifies the properties
+    mfxVariant cfgPropsAll[eProp_TotalProps];
+    std::copy(filterSet.cfgPropsAll.begin(), filterSet.cfgPropsAll.end(), cfgPropsAll);
+
+    // check whether required functions are implemented
+    if ((checkGroups & PROP_GROUP_FUNC) && !filterSet.implFunctionList.empty()) {
+        if (!libImplFuncs) {
+            // library did not provide list of implemented functions
+            return MFX_ERR_UNSUPPORTED;
+        }
+
+        auto fn = filterSet.implFunctionList.begin();
+        while (fn != filterSet.implFunctionList.end()) {
+            const std::string &fnName = (*fn++);
+            mfxU32 fnIdx;
+
+            // search for fnName in list of implemented functions
+            for (fnIdx = 0; fnIdx < libImplFuncs->NumFunctions; fnIdx++) {
+                if (fnName == libImplFuncs->FunctionsName[fnIdx])
+                    break;
+            }
+
+            if (fnIdx == libImplFuncs->NumFunctions)
+                return MFX_ERR_UNSUPPORTED;
+        }
+    }
+
     // generate "flat" descriptions of each combination
     //   (e.g. multiple profiles from the same codec)
-    GetFlatDescriptionsDec(libImplDesc, decConfigList);
-    GetFlatDescriptionsEnc(libImplDesc, encConfigList);
-    GetFlatDescriptionsVPP(libImplDesc, vppConfigList);
+    // only done once per implementation, since caps do not change
+    if (!flatCaps->bInitialized) {
+        GetFlatDescriptionsDec(libImplDesc, flatCaps->decConfigs);
+        GetFlatDescriptionsEnc(libImplDesc, flatCaps->encConfigs);
+        GetFlatDescriptionsVPP(libImplDesc, flatCaps->vppConfigs);
 
-    sts = CheckPropsGeneral(cfgPropsAll, libImplDesc);
-    if (sts)
-        return sts;
+        BuildFlatConfigIndex(flatCaps->decConfigs, &DecConfig::CodecID, flatCaps->decIndex);
+        BuildFlatConfigIndex(flatCaps->encConfigs, &EncConfig::CodecID, flatCaps->encIndex);
+        BuildFlatConfigIndex(flatCaps->vppConfigs, &VPPConfig::FilterFourCC, flatCaps->vppIndex);
+
+        flatCaps->bInitialized = true;
+    }
+
+    if (checkGroups & PROP_GROUP_GENERAL) {
+        sts = CheckPropsGeneral(cfgPropsAll, libImplDesc);
+        if (sts)
+            return sts;
+    }
 
     // early exit - MSDK RT compatibility mode (1.x) does not provide Dec/Enc/VPP caps
     // ignore these filters if set (do not use them to _exclude_ the library)
     if (libType == LibTypeMSDK)
         return MFX_ERR_NONE;
 
-    if (decRequested) {
-        sts = CheckPropsDec(cfgPropsAll, decConfigList);
+    if ((checkGroups & PROP_GROUP_DEC) && filterSet.decRequested) {
+        sts = CheckPropsDec(cfgPropsAll, *flatCaps);
         if (sts)
             return sts;
     }
 
-    if (encRequested) {
-        sts = CheckPropsEnc(cfgPropsAll, encConfigList);
+    if ((checkGroups & PROP_GROUP_ENC) && filterSet.encRequested) {
+        sts = CheckPropsEnc(cfgPropsAll, *flatCaps);
         if (sts)
             return sts;
     }
 
-    if (vppRequested) {
-        sts = CheckPropsVPP(cfgPropsAll, vppConfigList);
+    if ((checkGroups & PROP_GROUP_VPP) && filterSet.vppRequested) {
+        sts = CheckPropsVPP(cfgPropsAll, *flatCaps);
         if (sts)
             return sts;
     }
@@ -1018,8 +965,8 @@ mfxStatus ConfigCtxVPL::ValidateConfig(mfxImplDescription *libImplDesc,
     //   is associated with which codec? (it is just some integer)
     // Probably need to add more information to the spec to clarify
     //   allowable combinations of filter properties.
-    std::list<ConfigCtxVPL *>::iterator it2 = configCtxListDups.begin();
-    while (it2 != configCtxListDups.end()) {
+    auto it2 = filterSet.configCtxListDups.begin();
+    while (it2 != filterSet.configCtxListDups.end()) {
         ConfigCtxVPL *config = (*it2);
 
         idx = config->m_propIdx;
@@ -1037,12 +984,15 @@ mfxStatus ConfigCtxVPL::ValidateConfig(mfxImplDescription *libImplDesc,
         //   type just requires checking the decoder configurations)
         // no need to test general (top-level) properties, as they can
         //   only have a single value
+        if (!(checkGroups & GetPropGroup(idx)))
+            continue;
+
         if (idx >= ePropDec_CodecID && idx <= ePropDec_ColorFormats)
-            sts = CheckPropsDec(cfgPropsAll, decConfigList);
+            sts = CheckPropsDec(cfgPropsAll, *flatCaps);
         else if (idx >= ePropEnc_CodecID && idx <= ePropEnc_ColorFormats)
-            sts = CheckPropsEnc(cfgPropsAll, encConfigList);
+            sts = CheckPropsEnc(cfgPropsAll, *flatCaps);
         else if (idx >= ePropVPP_FilterFourCC && idx <= ePropVPP_OutFormat)
-            sts = CheckPropsVPP(cfgPropsAll, vppConfigList);
+            sts = CheckPropsVPP(cfgPropsAll, *flatCaps);
 
         if (sts)
             return sts;
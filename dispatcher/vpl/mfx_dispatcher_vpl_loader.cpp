@@ -5,6 +5,9 @@
   ############################################################################*/
 
 #include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
 
 #include "vpl/mfx_dispatcher_vpl.h"
 
@@ -37,6 +40,35 @@ static const VPLFunctionDesc MSDKCompatFunctions[NumMSDKFunctions] = {
 // end table formatting
 // clang-format on
 
+bool GetEnvVarU32(const CHAR_TYPE* envVarName, mfxU32* value) {
+    if (!envVarName || !value)
+        return false;
+
+    CHAR_TYPE* endPtr = nullptr;
+    unsigned long val = 0;
+
+#if defined(_WIN32) || defined(_WIN64)
+    CHAR_TYPE envVar[MAX_VPL_SEARCH_PATH] = { L"" };
+    if (!GetEnvironmentVariableW(envVarName, envVar, MAX_VPL_SEARCH_PATH))
+        return false;
+
+    val = wcstoul(envVar, &endPtr, 0);
+#else
+    CHAR_TYPE* envVar = getenv(envVarName);
+    if (!envVar)
+        return false;
+
+    val = strtoul(envVar, &endPtr, 0);
+#endif
+
+    // reject empty strings and trailing garbage
+    if (endPtr == envVar || *endPtr != 0)
+        return false;
+
+    *value = (mfxU32)val;
+    return true;
+}
+
 // implementation of loader context (mfxLoader)
 // each loader instance will build a list of valid runtimes and allow
 // application to create sessions with them
@@ -51,8 +83,38 @@ LoaderCtxVPL::LoaderCtxVPL()
           m_vplPackageDir(),
           m_driverStoreDir(),
           m_specialConfig(),
+          m_filterSet(),
+          m_capsCache(),
+          m_sessionPool(),
+          m_timing(),
+          m_validImpls(),
+          m_writeMutex(),
+          m_configMutex(),
+          m_asyncLoadThread(),
+          m_asyncLoadPromise(),
+          m_asyncLoadStatus(),
           m_implIdxNext(0),
-          m_bKeepCapsUntilUnload(true) {
+          m_bKeepCapsUntilUnload(true),
+          m_bLazyLoad(false),
+          m_bLoadBalance(false),
+          m_bLibsLoaded(false),
+          m_bCapsReady(false),
+          m_numQueryThreads(1) {
+    mfxU32 lazyLoad = 0;
+    if (GetEnvVarU32(ENV_ONEVPL_LAZY_LOAD, &lazyLoad))
+        m_bLazyLoad = (lazyLoad != 0);
+
+    mfxU32 loadBalance = 0;
+    if (GetEnvVarU32(ENV_ONEVPL_LOAD_BALANCE, &loadBalance))
+        m_bLoadBalance = (loadBalance != 0);
+
+    mfxU32 numQueryThreads = 0;
+    if (GetEnvVarU32(ENV_ONEVPL_QUERY_THREADS, &numQueryThreads) && numQueryThreads > 0)
+        m_numQueryThreads = std::min(numQueryThreads, (mfxU32)MAX_VPL_QUERY_THREADS);
+
+    m_sessionPool.Init();
+    m_timing.Init();
+
     return;
 }
 
@@ -97,7 +159,7 @@ mfxU32 LoaderCtxVPL::ParseEnvSearchPaths(const CHAR_TYPE* envVarName,
 #define NUM_LIB_PREFIXES 2
 
 mfxStatus LoaderCtxVPL::SearchDirForLibs(STRING_TYPE searchDir,
-                                         std::list<LibInfo*>& libInfoList,
+                                         std::vector<LibInfo*>& libInfoList,
                                          mfxU32 priority) {
     // okay to call with empty searchDir
     if (searchDir.empty())
@@ -227,6 +289,55 @@ mfxStatus LoaderCtxVPL::SearchDirForLibs(STRING_TYPE searchDir,
     return MFX_ERR_NONE;
 }
 
+// add a single library given by its path (ENV_ONEVPL_RUNTIME_PATH)
+// the library is not opened here, so a path which does not exist is just skipped
+mfxStatus LoaderCtxVPL::AddLibByPath(const STRING_TYPE& libPath,
+                                     std::vector<LibInfo*>& libInfoList,
+                                     mfxU32 priority) {
+    // okay to call with empty libPath
+    if (libPath.empty())
+        return MFX_ERR_NONE;
+
+    STRING_TYPE libNameFull;
+
+#if defined(_WIN32) || defined(_WIN64)
+    wchar_t fullPath[MAX_VPL_SEARCH_PATH];
+    if (!GetFullPathNameW(libPath.c_str(), MAX_VPL_SEARCH_PATH, fullPath, nullptr))
+        return MFX_ERR_NONE;
+
+    if (GetFileAttributesW(fullPath) == INVALID_FILE_ATTRIBUTES)
+        return MFX_ERR_NONE;
+
+    libNameFull = fullPath;
+#else
+    char* fullPath = realpath(libPath.c_str(), NULL);
+    if (!fullPath)
+        return MFX_ERR_NONE;
+
+    libNameFull = fullPath;
+    free(fullPath);
+#endif
+
+    // skip duplicates
+    auto libFound = std::find_if(libInfoList.begin(), libInfoList.end(), [&](LibInfo* li) {
+        return (li->libNameFull == libNameFull);
+    });
+    if (libFound != libInfoList.end())
+        return MFX_ERR_NONE;
+
+    LibInfo* libInfo = new LibInfo;
+    if (!libInfo)
+        return MFX_ERR_MEMORY_ALLOC;
+
+    libInfo->libNameFull = libNameFull;
+    libInfo->libPriority = priority;
+
+    // add to list
+    libInfoList.push_back(libInfo);
+
+    return MFX_ERR_NONE;
+}
+
 // get legacy MSDK dispatcher search paths
 // see "oneVPL Session" section in spec
 mfxU32 LoaderCtxVPL::ParseLegacySearchPaths(std::list<STRING_TYPE>& searchDirs) {
@@ -293,9 +404,25 @@ mfxU32 LoaderCtxVPL::ParseLegacySearchPaths(std::list<STRING_TYPE>& searchDirs)
 mfxStatus LoaderCtxVPL::BuildListOfCandidateLibs() {
     mfxStatus sts = MFX_ERR_NONE;
 
+    TimingScopeVPL timingScope(m_timing, TimingPhaseDirScan);
+
     STRING_TYPE emptyPath; // default construction = empty
     std::list<STRING_TYPE>::iterator it;
 
+    // fast path: runtime libraries given by full path in environment variable
+    // no directories are searched, so only these libraries are opened by MFXLoad
+    std::list<STRING_TYPE> runtimePaths;
+    if (ParseEnvSearchPaths(ENV_ONEVPL_RUNTIME_PATH, runtimePaths)) {
+        it = runtimePaths.begin();
+        while (it != runtimePaths.end()) {
+            STRING_TYPE nextLib = (*it);
+            sts                 = AddLibByPath(nextLib, m_libInfoList, LIB_PRIORITY_USER_DEFINED);
+            it++;
+        }
+
+        return sts;
+    }
+
     // first priority: user-defined directories in environment variable
     ParseEnvSearchPaths(ENV_ONEVPL_SEARCH_PATH, m_userSearchDirs);
     it = m_userSearchDirs.begin();
@@ -339,64 +466,120 @@ mfxStatus LoaderCtxVPL::BuildListOfCandidateLibs() {
     return sts;
 }
 
-// return number of valid libraries found
-mfxU32 LoaderCtxVPL::CheckValidLibraries() {
-    // load all libraries
-    std::list<LibInfo*>::iterator it = m_libInfoList.begin();
-    while (it != m_libInfoList.end()) {
-        mfxU32 i         = 0;
-        LibInfo* libInfo = (*it);
-        mfxStatus sts    = MFX_ERR_NONE;
-
-        // load DLL
-        sts = LoadSingleLibrary(libInfo);
-
-        // load video functions: pointers to exposed functions
-        if (sts == MFX_ERR_NONE && libInfo->hModuleVPL) {
-            for (i = 0; i < NumVPLFunctions; i += 1) {
-                VPLFunctionPtr pProc =
-                    (VPLFunctionPtr)GetFunctionAddr(libInfo->hModuleVPL, FunctionDesc2[i].pName);
-                if (pProc)
-                    libInfo->vplFuncTable[i] = pProc;
-            }
-        }
+// run func(i) for each i in [0, count) using up to numThreads threads (including the caller)
+// func must only write to per-index state so that results can be merged in order afterwards
+static void RunParallel(mfxU32 count, mfxU32 numThreads, const std::function<void(mfxU32)>& func) {
+    std::atomic<mfxU32> next(0);
+    auto worker = [&]() {
+        for (mfxU32 i = next++; i < count; i = next++)
+            func(i);
+    };
+
+    std::vector<std::thread> threads;
+    numThreads = std::min(numThreads, count);
+    try {
+        for (mfxU32 t = 1; t < numThreads; t++)
+            threads.emplace_back(worker);
+    }
+    catch (...) {
+        // failed to create thread - remaining work is picked up by existing threads
+    }
 
-        // all runtime libraries with API >= 2.0 must export MFXInitialize()
-        // validation of additional functions vs. API version takes place
-        //   during UpdateValidImplList() since the minimum API version requested
-        //   by application is not known yet (use SetConfigFilterProperty)
-        if (libInfo->vplFuncTable[IdxMFXInitialize]) {
-            libInfo->libType = LibTypeVPL;
-            it++;
-            continue;
-        }
+    worker();
 
-        // not a valid 2.x runtime - check for 1.x API (legacy caps query)
-        if (sts == MFX_ERR_NONE && libInfo->hModuleVPL) {
-            for (i = 0; i < NumMSDKFunctions; i += 1) {
-                VPLFunctionPtr pProc =
-                    (VPLFunctionPtr)GetFunctionAddr(libInfo->hModuleVPL,
-                                                    MSDKCompatFunctions[i].pName);
-                if (pProc)
-                    libInfo->msdkFuncTable[i] = pProc;
-                else
-                    break;
-            }
+    for (auto& t : threads)
+        t.join();
+}
+
+// check whether library is a valid runtime and fill its function tables
+// returns MFX_ERR_NONE if valid
+// may be called concurrently for different libraries
+mfxStatus LoaderCtxVPL::CheckSingleLibrary(LibInfo* libInfo) {
+    mfxU32 i      = 0;
+    mfxStatus sts = MFX_ERR_NONE;
+
+    // if valid entry is found in the cache, caps are already known
+    //   and there is no need to load the library
+    if (m_capsCache.LoadEntry(libInfo) == MFX_ERR_NONE) {
+        // LibTypeUnknown - previously found to not be a valid runtime
+        if (libInfo->libType == LibTypeVPL || libInfo->libType == LibTypeMSDK)
+            return MFX_ERR_NONE;
+
+        return MFX_ERR_UNSUPPORTED;
+    }
+
+    // load DLL
+    sts = LoadSingleLibrary(libInfo);
+
+    // load video functions: pointers to exposed functions
+    if (sts == MFX_ERR_NONE && libInfo->hModuleVPL) {
+        TimingScopeVPL timingScope(m_timing, TimingPhaseResolveExports, &libInfo->libNameFull);
+        for (i = 0; i < NumVPLFunctions; i += 1) {
+            VPLFunctionPtr pProc =
+                (VPLFunctionPtr)GetFunctionAddr(libInfo->hModuleVPL, FunctionDesc2[i].pName);
+            if (pProc)
+                libInfo->vplFuncTable[i] = pProc;
         }
+    }
 
-        // check if all of the required MSDK functions were found
-        if (i == NumMSDKFunctions) {
-            libInfo->libType = LibTypeMSDK;
-            it++;
-            continue;
+    // all runtime libraries with API >= 2.0 must export MFXInitialize()
+    // validation of additional functions vs. API version takes place
+    //   during UpdateValidImplList() since the minimum API version requested
+    //   by application is not known yet (use SetConfigFilterProperty)
+    if (libInfo->vplFuncTable[IdxMFXInitialize]) {
+        libInfo->libType = LibTypeVPL;
+        return MFX_ERR_NONE;
+    }
+
+    // not a valid 2.x runtime - check for 1.x API (legacy caps query)
+    if (sts == MFX_ERR_NONE && libInfo->hModuleVPL) {
+        TimingScopeVPL timingScope(m_timing, TimingPhaseResolveExports, &libInfo->libNameFull);
+        for (i = 0; i < NumMSDKFunctions; i += 1) {
+            VPLFunctionPtr pProc =
+                (VPLFunctionPtr)GetFunctionAddr(libInfo->hModuleVPL, MSDKCompatFunctions[i].pName);
+            if (pProc)
+                libInfo->msdkFuncTable[i] = pProc;
+            else
+                break;
         }
+    }
 
-        // required functions missing from DLL, or DLL failed to load
-        // remove this library from the list of options
-        UnloadSingleLibrary(libInfo);
-        it = m_libInfoList.erase(it);
+    // check if all of the required MSDK functions were found
+    if (i == NumMSDKFunctions) {
+        libInfo->libType = LibTypeMSDK;
+        return MFX_ERR_NONE;
     }
 
+    // required functions missing from DLL, or DLL failed to load
+    // if the library did load, save the result so it is skipped next time
+    if (sts == MFX_ERR_NONE)
+        m_capsCache.StoreEntry(libInfo, std::list<ImplCapsBlob>());
+
+    return MFX_ERR_UNSUPPORTED;
+}
+
+// return number of valid libraries found
+mfxU32 LoaderCtxVPL::CheckValidLibraries() {
+    // optional persistent cache of caps
+    m_capsCache.Init();
+
+    // load all libraries, optionally in parallel
+    std::vector<mfxStatus> libSts(m_libInfoList.size(), MFX_ERR_NONE);
+
+    RunParallel((mfxU32)m_libInfoList.size(), m_numQueryThreads, [&](mfxU32 idx) {
+        libSts[idx] = CheckSingleLibrary(m_libInfoList[idx]);
+    });
+
+    // remove invalid libraries from the list of options, keeping the order of the others
+    size_t numValid = 0;
+    for (size_t idx = 0; idx < m_libInfoList.size(); idx++) {
+        if (libSts[idx] == MFX_ERR_NONE)
+            m_libInfoList[numValid++] = m_libInfoList[idx];
+        else
+            UnloadSingleLibrary(m_libInfoList[idx]);
+    }
+    m_libInfoList.resize(numValid);
+
     // number of valid oneVPL libs
     return (mfxU32)m_libInfoList.size();
 }
@@ -420,6 +603,8 @@ mfxStatus LoaderCtxVPL::LoadSingleLibrary(LibInfo* libInfo) {
     if (!libInfo)
         return MFX_ERR_NULL_PTR;
 
+    TimingScopeVPL timingScope(m_timing, TimingPhaseLoadLib, &libInfo->libNameFull);
+
 #if defined(_WIN32) || defined(_WIN64)
     libInfo->hModuleVPL = MFX::mfx_dll_load(libInfo->libNameFull.c_str());
 #else
@@ -433,13 +618,16 @@ mfxStatus LoaderCtxVPL::LoadSingleLibrary(LibInfo* libInfo) {
 }
 
 // unload single runtime
+// library may not have been loaded (lazy load, caps loaded from cache, or load failed)
 mfxStatus LoaderCtxVPL::UnloadSingleLibrary(LibInfo* libInfo) {
-    if (libInfo && libInfo->hModuleVPL) {
+    if (libInfo) {
+        if (libInfo->hModuleVPL) {
 #if defined(_WIN32) || defined(_WIN64)
-        MFX::mfx_dll_free(libInfo->hModuleVPL);
+            MFX::mfx_dll_free(libInfo->hModuleVPL);
 #else
-        dlclose(libInfo->hModuleVPL);
+            dlclose(libInfo->hModuleVPL);
 #endif
+        }
         delete libInfo;
         return MFX_ERR_NONE;
     }
@@ -451,7 +639,10 @@ mfxStatus LoaderCtxVPL::UnloadSingleLibrary(LibInfo* libInfo) {
 // iterate over all implementation runtimes
 // unload DLL's and free memory
 mfxStatus LoaderCtxVPL::UnloadAllLibraries() {
-    std::list<ImplInfo*>::iterator it2 = m_implInfoList.begin();
+    // close pooled sessions before the runtimes go away
+    m_sessionPool.Clear();
+
+    std::vector<ImplInfo*>::iterator it2 = m_implInfoList.begin();
     while (it2 != m_implInfoList.end()) {
         ImplInfo* implInfo = (*it2);
 
@@ -462,7 +653,7 @@ mfxStatus LoaderCtxVPL::UnloadAllLibraries() {
     }
 
     // lastly, unload and destroy LibInfo for each library
-    std::list<LibInfo*>::iterator it = m_libInfoList.begin();
+    std::vector<LibInfo*>::iterator it = m_libInfoList.begin();
     while (it != m_libInfoList.end()) {
         LibInfo* libInfo = (*it);
 
@@ -486,7 +677,8 @@ mfxStatus LoaderCtxVPL::UnloadSingleImplementation(ImplInfo* implInfo) {
         //   was never called by the application
         // this is a valid scenario, e.g. app did not call MFXEnumImplementations()
         //   and just used the first available implementation provided by dispatcher
-        if (libInfo->libType == LibTypeVPL) {
+        // caps owned by the dispatcher are freed along with implInfo
+        if (libInfo->libType == LibTypeVPL && implInfo->capsBlob.implDesc.empty()) {
             if (implInfo->implDesc) {
                 // MFX_IMPLCAPS_IMPLDESCSTRUCTURE;
                 (*(mfxStatus(MFX_CDECL*)(mfxHDL))pFunc)(implInfo->implDesc);
@@ -507,6 +699,64 @@ mfxStatus LoaderCtxVPL::UnloadSingleImplementation(ImplInfo* implInfo) {
     }
 }
 
+// copy caps for all implementations in this library into dispatcher-owned memory,
+//   release the runtime's copy, and unload the library
+// the library is loaded again by MFXInitEx2() if a session is created with it
+mfxStatus LoaderCtxVPL::UnloadLibraryKeepCaps(LibInfo* libInfo) {
+    if (!libInfo || !libInfo->hModuleVPL)
+        return MFX_ERR_NONE;
+
+    if (libInfo->libType == LibTypeVPL) {
+        VPLFunctionPtr pFunc = libInfo->vplFuncTable[IdxMFXReleaseImplDescription];
+
+        // make all copies first so nothing is released if any copy fails
+        std::list<std::pair<ImplInfo*, ImplCapsBlob>> implCapsList;
+        for (auto implInfo : m_implInfoList) {
+            if (implInfo->libInfo != libInfo || !implInfo->capsBlob.implDesc.empty())
+                continue;
+
+            ImplCapsBlob implCaps;
+            mfxStatus sts =
+                CapsCacheVPL::CopyImplDesc((mfxImplDescription*)implInfo->implDesc,
+                                           implCaps.implDesc);
+            if (sts == MFX_ERR_NONE && implInfo->implFuncs)
+                sts = CapsCacheVPL::CopyImplFuncs((mfxImplementedFunctions*)implInfo->implFuncs,
+                                                  implCaps.implFuncs);
+            if (sts != MFX_ERR_NONE)
+                return sts;
+
+            implCapsList.push_back(std::make_pair(implInfo, std::move(implCaps)));
+        }
+
+        for (auto& implCaps : implCapsList) {
+            ImplInfo* implInfo = implCaps.first;
+
+            (*(mfxStatus(MFX_CDECL*)(mfxHDL))pFunc)(implInfo->implDesc);
+            if (implInfo->implFuncs)
+                (*(mfxStatus(MFX_CDECL*)(mfxHDL))pFunc)(implInfo->implFuncs);
+
+            implInfo->capsBlob = std::move(implCaps.second);
+            implInfo->implDesc = implInfo->capsBlob.implDesc.data();
+            implInfo->implFuncs = implInfo->capsBlob.implFuncs.empty()
+                                      ? nullptr
+                                      : implInfo->capsBlob.implFuncs.data();
+        }
+    }
+
+#if defined(_WIN32) || defined(_WIN64)
+    MFX::mfx_dll_free(libInfo->hModuleVPL);
+#else
+    dlclose(libInfo->hModuleVPL);
+#endif
+    libInfo->hModuleVPL = nullptr;
+
+    // function pointers are no longer valid
+    memset(libInfo->vplFuncTable, 0, sizeof(libInfo->vplFuncTable));
+    memset(libInfo->msdkFuncTable, 0, sizeof(libInfo->msdkFuncTable));
+
+    return MFX_ERR_NONE;
+}
+
 // check that all functions for this API version are available in library
 mfxStatus LoaderCtxVPL::ValidateAPIExports(VPLFunctionPtr* vplFuncTable,
                                            mfxVersion reportedVersion) {
@@ -518,111 +768,107 @@ mfxStatus LoaderCtxVPL::ValidateAPIExports(VPLFunctionPtr* vplFuncTable,
     return MFX_ERR_NONE;
 }
 
-// query capabilities of all valid libraries
-//   and add to list for future calls to EnumImplementations()
-//   as well as filtering by functionality
-// assume MFX_IMPLCAPS_IMPLDESCSTRUCTURE is the only format supported
-mfxStatus LoaderCtxVPL::QueryLibraryCaps() {
-    mfxStatus sts = MFX_ERR_NONE;
+// save dispatcher-owned copy of the caps for each valid implementation in the persistent cache
+mfxStatus LoaderCtxVPL::StoreCachedCaps(LibInfo* libInfo,
+                                        mfxHDL* hImpl,
+                                        mfxU32 numImpls,
+                                        mfxHDL* hImplFuncs,
+                                        mfxU32 numImplsFuncs) {
+    if (!m_capsCache.IsEnabled())
+        return MFX_ERR_NONE;
 
-    std::list<LibInfo*>::iterator it = m_libInfoList.begin();
-    while (it != m_libInfoList.end()) {
-        LibInfo* libInfo = (*it);
+    std::list<ImplCapsBlob> implCapsList;
+    for (mfxU32 i = 0; hImpl && i < numImpls; i++) {
+        mfxImplDescription* implDesc = reinterpret_cast<mfxImplDescription*>(hImpl[i]);
 
-        if (libInfo->libType == LibTypeVPL) {
-            VPLFunctionPtr pFunc = libInfo->vplFuncTable[IdxMFXQueryImplsDescription];
-
-            // call MFXQueryImplsDescription() for this implementation
-            // return handle to description in requested format
-            mfxHDL* hImpl;
-            mfxU32 numImpls = 0;
-            hImpl           = (*(mfxHDL * (MFX_CDECL*)(mfxImplCapsDeliveryFormat, mfxU32*))
-                         pFunc)(MFX_IMPLCAPS_IMPLDESCSTRUCTURE, &numImpls);
-
-            if (!hImpl) {
-                // the required function is implemented incorrectly
-                // remove this library from the list of valid libraries
-                UnloadSingleLibrary(libInfo);
-                it = m_libInfoList.erase(it);
-                continue;
-            }
+        if (ValidateAPIExports(libInfo->vplFuncTable, implDesc->ApiVersion))
+            continue;
 
-            // query for list of implemented functions
-            // prior to API 2.2, this will return null since the format was not defined yet
-            //   so we need to check whether the returned handle is valid before attempting to use it
-            mfxHDL* hImplFuncs   = nullptr;
-            mfxU32 numImplsFuncs = 0;
-            hImplFuncs           = (*(mfxHDL * (MFX_CDECL*)(mfxImplCapsDeliveryFormat, mfxU32*))
-                              pFunc)(MFX_IMPLCAPS_IMPLEMENTEDFUNCTIONS, &numImplsFuncs);
-
-            for (mfxU32 i = 0; i < numImpls; i++) {
-                ImplInfo* implInfo = new ImplInfo;
-                if (!implInfo)
-                    return MFX_ERR_MEMORY_ALLOC;
+        ImplCapsBlob implCaps;
+        mfxStatus sts = CapsCacheVPL::CopyImplDesc(implDesc, implCaps.implDesc);
+        if (sts != MFX_ERR_NONE)
+            return sts;
 
-                // library which contains this implementation
-                implInfo->libInfo = libInfo;
+        if (hImplFuncs && i < numImplsFuncs && hImplFuncs[i]) {
+            sts = CapsCacheVPL::CopyImplFuncs((mfxImplementedFunctions*)hImplFuncs[i],
+                                              implCaps.implFuncs);
+            if (sts != MFX_ERR_NONE)
+                return sts;
+        }
 
-                // implementation descriptor returned from runtime
-                implInfo->implDesc = hImpl[i];
+        implCapsList.push_back(std::move(implCaps));
+    }
 
-                // implemented function description, if available
-                if (hImplFuncs && i < numImplsFuncs)
-                    implInfo->implFuncs = hImplFuncs[i];
+    return m_capsCache.StoreEntry(libInfo, implCapsList);
+}
 
-                // fill out mfxInitParam struct for when we call MFXInitEx
-                //   in CreateSession()
-                mfxImplDescription* implDesc = reinterpret_cast<mfxImplDescription*>(hImpl[i]);
+// query capabilities of a single valid library
+// new implementations are returned in implInfoList - validImplIdx is assigned by the caller
+// may be called concurrently for different libraries
+mfxStatus LoaderCtxVPL::QuerySingleLibrary(LibInfo* libInfo, std::vector<ImplInfo*>& implInfoList) {
+    mfxStatus sts = MFX_ERR_NONE;
 
-                // fill out mfxInitializationParam for use in CreateSession (MFXInitialize path)
-                memset(&(implInfo->vplParam), 0, sizeof(mfxInitializationParam));
+    if (libInfo->libType == LibTypeVPL && libInfo->bCapsCached) {
+        // caps were loaded from persistent cache, library has not been loaded
+        // all cached implementations already passed ValidateAPIExports()
+        mfxU32 i = 0;
+        for (auto& implCaps : libInfo->cachedCaps) {
+            ImplInfo* implInfo = new ImplInfo;
+            if (!implInfo)
+                return MFX_ERR_MEMORY_ALLOC;
 
-                // default mode for this impl
-                // this may be changed later by MFXSetConfigFilterProperty(AccelerationMode)
-                implInfo->vplParam.AccelerationMode = implDesc->AccelerationMode;
+            implInfo->libInfo  = libInfo;
+            implInfo->capsBlob = std::move(implCaps);
 
-                implInfo->version = implDesc->ApiVersion;
+            implInfo->implDesc = implInfo->capsBlob.implDesc.data();
+            if (!implInfo->capsBlob.implFuncs.empty())
+                implInfo->implFuncs = implInfo->capsBlob.implFuncs.data();
 
-                // save local index for this library
-                implInfo->libImplIdx = i;
+            mfxImplDescription* implDesc = (mfxImplDescription*)(implInfo->implDesc);
 
-                // validate that library exports all required functions for the reported API version
-                if (ValidateAPIExports(libInfo->vplFuncTable, implInfo->version)) {
-                    UnloadSingleImplementation(implInfo);
-                    continue;
-                }
+            memset(&(implInfo->vplParam), 0, sizeof(mfxInitializationParam));
+            implInfo->vplParam.AccelerationMode = implDesc->AccelerationMode;
 
-                // initially all libraries have a valid, sequential value (>= 0)
-                // list of valid libraries is updated with every call to MFXSetConfigFilterProperty()
-                //   (see UpdateValidImplList)
-                // libraries that do not support all the required props get a value of -1, and
-                //   indexing of the valid libs is recalculated from 0,1,...
-                implInfo->validImplIdx = m_implIdxNext++;
+            implInfo->version    = implDesc->ApiVersion;
+            implInfo->libImplIdx = i++;
 
-                // add implementation to overall list
-                m_implInfoList.push_back(implInfo);
-            }
+            implInfoList.push_back(implInfo);
+        }
+        libInfo->cachedCaps.clear();
+    }
+    else if (libInfo->libType == LibTypeVPL) {
+        VPLFunctionPtr pFunc = libInfo->vplFuncTable[IdxMFXQueryImplsDescription];
+
+        TimingScopeVPL queryTiming(m_timing, TimingPhaseQueryImpls, &libInfo->libNameFull);
+
+        // call MFXQueryImplsDescription() for this implementation
+        // return handle to description in requested format
+        mfxHDL* hImpl;
+        mfxU32 numImpls = 0;
+        hImpl           = (*(mfxHDL * (MFX_CDECL*)(mfxImplCapsDeliveryFormat, mfxU32*))
+                     pFunc)(MFX_IMPLCAPS_IMPLDESCSTRUCTURE, &numImpls);
+
+        if (!hImpl) {
+            // the required function is implemented incorrectly
+            // remove this library from the list of valid libraries
+            m_capsCache.StoreEntry(libInfo, std::list<ImplCapsBlob>());
+            return MFX_ERR_UNSUPPORTED;
         }
-        else if (libInfo->libType == LibTypeMSDK) {
-            mfxImplDescription* implDesc       = nullptr;
-            mfxImplementedFunctions* implFuncs = nullptr;
 
-            libInfo->msdkCtx = new LoaderCtxMSDK;
-            if (!libInfo->msdkCtx)
-                return MFX_ERR_MEMORY_ALLOC;
+        // query for list of implemented functions
+        // prior to API 2.2, this will return null since the format was not defined yet
+        //   so we need to check whether the returned handle is valid before attempting to use it
+        mfxHDL* hImplFuncs   = nullptr;
+        mfxU32 numImplsFuncs = 0;
+        hImplFuncs           = (*(mfxHDL * (MFX_CDECL*)(mfxImplCapsDeliveryFormat, mfxU32*))
+                          pFunc)(MFX_IMPLCAPS_IMPLEMENTEDFUNCTIONS, &numImplsFuncs);
 
-            sts = libInfo->msdkCtx->QueryMSDKCaps(libInfo->libNameFull,
-                                                  &implDesc,
-                                                  &implFuncs,
-                                                  &libInfo->msdkCtx->msdkAdapter);
+        queryTiming.Stop();
 
-            if (sts || !implDesc || !implFuncs) {
-                // error loading MSDK library in compatibility mode - remove from list
-                UnloadSingleLibrary(libInfo);
-                it = m_libInfoList.erase(it);
-                continue;
-            }
+        // save caps for next time (ignore errors - cache is optional)
+        StoreCachedCaps(libInfo, hImpl, numImpls, hImplFuncs, numImplsFuncs);
 
+        for (mfxU32 i = 0; i < numImpls; i++) {
             ImplInfo* implInfo = new ImplInfo;
             if (!implInfo)
                 return MFX_ERR_MEMORY_ALLOC;
@@ -631,10 +877,15 @@ mfxStatus LoaderCtxVPL::QueryLibraryCaps() {
             implInfo->libInfo = libInfo;
 
             // implementation descriptor returned from runtime
-            implInfo->implDesc = implDesc;
+            implInfo->implDesc = hImpl[i];
 
             // implemented function description, if available
-            implInfo->implFuncs = implFuncs;
+            if (hImplFuncs && i < numImplsFuncs)
+                implInfo->implFuncs = hImplFuncs[i];
+
+            // fill out mfxInitParam struct for when we call MFXInitEx
+            //   in CreateSession()
+            mfxImplDescription* implDesc = reinterpret_cast<mfxImplDescription*>(hImpl[i]);
 
             // fill out mfxInitializationParam for use in CreateSession (MFXInitialize path)
             memset(&(implInfo->vplParam), 0, sizeof(mfxInitializationParam));
@@ -646,8 +897,115 @@ mfxStatus LoaderCtxVPL::QueryLibraryCaps() {
             implInfo->version = implDesc->ApiVersion;
 
             // save local index for this library
-            implInfo->libImplIdx = 0;
+            implInfo->libImplIdx = i;
+
+            // validate that library exports all required functions for the reported API version
+            if (ValidateAPIExports(libInfo->vplFuncTable, implInfo->version)) {
+                UnloadSingleImplementation(implInfo);
+                continue;
+            }
+
+            implInfoList.push_back(implInfo);
+        }
+    }
+    else if (libInfo->libType == LibTypeMSDK) {
+        mfxImplDescription* implDesc       = nullptr;
+        mfxImplementedFunctions* implFuncs = nullptr;
+
+        libInfo->msdkCtx = new LoaderCtxMSDK;
+        if (!libInfo->msdkCtx)
+            return MFX_ERR_MEMORY_ALLOC;
+
+        if (libInfo->bCapsCached) {
+            // caps were loaded from persistent cache, no need to open probe sessions
+            // cache entries for MSDK libraries always have one implementation
+            mfxImplDescription* cachedDesc =
+                (mfxImplDescription*)libInfo->cachedCaps.front().implDesc.data();
+
+            sts = libInfo->msdkCtx->LoadCachedCaps(libInfo->libNameFull,
+                                                   cachedDesc,
+                                                   &implDesc,
+                                                   &implFuncs,
+                                                   &libInfo->msdkCtx->msdkAdapter);
+
+            libInfo->cachedCaps.clear();
+        }
+        else {
+            TimingScopeVPL probeTiming(m_timing, TimingPhaseMSDKProbe, &libInfo->libNameFull);
+
+            sts = libInfo->msdkCtx->QueryMSDKCaps(libInfo->libNameFull,
+                                                  &implDesc,
+                                                  &implFuncs,
+                                                  &libInfo->msdkCtx->msdkAdapter);
+
+            probeTiming.Stop();
+
+            // save caps for next time (ignore errors - cache is optional)
+            if (sts == MFX_ERR_NONE && implDesc && implFuncs)
+                StoreCachedCaps(libInfo, (mfxHDL*)&implDesc, 1, (mfxHDL*)&implFuncs, 1);
+        }
+
+        if (sts || !implDesc || !implFuncs) {
+            // error loading MSDK library in compatibility mode - remove from list
+            return MFX_ERR_UNSUPPORTED;
+        }
+
+        ImplInfo* implInfo = new ImplInfo;
+        if (!implInfo)
+            return MFX_ERR_MEMORY_ALLOC;
+
+        // library which contains this implementation
+        implInfo->libInfo = libInfo;
+
+        // implementation descriptor returned from runtime
+        implInfo->implDesc = implDesc;
+
+        // implemented function description, if available
+        implInfo->implFuncs = implFuncs;
+
+        // fill out mfxInitializationParam for use in CreateSession (MFXInitialize path)
+        memset(&(implInfo->vplParam), 0, sizeof(mfxInitializationParam));
+
+        // default mode for this impl
+        // this may be changed later by MFXSetConfigFilterProperty(AccelerationMode)
+        implInfo->vplParam.AccelerationMode = implDesc->AccelerationMode;
+
+        implInfo->version = implDesc->ApiVersion;
+
+        // save local index for this library
+        implInfo->libImplIdx = 0;
 
+        implInfoList.push_back(implInfo);
+    }
+
+    return MFX_ERR_NONE;
+}
+
+// query capabilities of all valid libraries
+//   and add to list for future calls to EnumImplementations()
+//   as well as filtering by functionality
+// assume MFX_IMPLCAPS_IMPLDESCSTRUCTURE is the only format supported
+mfxStatus LoaderCtxVPL::QueryLibraryCaps() {
+    mfxStatus sts = MFX_ERR_NONE;
+
+    // query all libraries, optionally in parallel
+    std::vector<mfxStatus> libSts(m_libInfoList.size(), MFX_ERR_NONE);
+    std::vector<std::vector<ImplInfo*>> libImpls(m_libInfoList.size());
+
+    RunParallel((mfxU32)m_libInfoList.size(), m_numQueryThreads, [&](mfxU32 idx) {
+        libSts[idx] = QuerySingleLibrary(m_libInfoList[idx], libImpls[idx]);
+    });
+
+    // merge results in the same order as m_libInfoList, so the result does not
+    //   depend on the number of threads
+    size_t numValid = 0;
+    for (size_t idx = 0; idx < m_libInfoList.size(); idx++) {
+        LibInfo* libInfo                  = m_libInfoList[idx];
+        mfxStatus libStatus               = libSts[idx];
+        std::vector<ImplInfo*>& implInfos = libImpls[idx];
+
+        // keep any implementations that were created so they are freed on unload
+        for (auto implInfo : implInfos) {
             // initially all libraries have a valid, sequential value (>= 0)
             // list of valid libraries is updated with every call to MFXSetConfigFilterProperty()
             //   (see UpdateValidImplList)
@@ -658,11 +1016,24 @@ mfxStatus LoaderCtxVPL::QueryLibraryCaps() {
             // add implementation to overall list
             m_implInfoList.push_back(implInfo);
         }
-        it++;
+
+        if (libStatus == MFX_ERR_MEMORY_ALLOC)
+            sts = MFX_ERR_MEMORY_ALLOC;
+
+        if (libStatus != MFX_ERR_NONE && implInfos.empty()) {
+            UnloadSingleLibrary(libInfo);
+            continue;
+        }
+
+        m_libInfoList[numValid++] = libInfo;
     }
+    m_libInfoList.resize(numValid);
+
+    if (sts != MFX_ERR_NONE)
+        return sts;
 
     if (!m_implInfoList.empty()) {
-        std::list<ImplInfo*>::iterator it2 = m_implInfoList.begin();
+        std::vector<ImplInfo*>::iterator it2 = m_implInfoList.begin();
         while (it2 != m_implInfoList.end()) {
             ImplInfo* implInfo = (*it2);
 
@@ -694,32 +1065,187 @@ mfxStatus LoaderCtxVPL::QueryLibraryCaps() {
     return m_implInfoList.empty() ? MFX_ERR_UNSUPPORTED : MFX_ERR_NONE;
 }
 
+// check and query all candidate libraries
+// called from MFXLoad(), or from the first call which requires caps in lazy load mode
+mfxStatus LoaderCtxVPL::LoadLibsAndQueryCaps() {
+    // fast path - the list of implementations does not change once loaded
+    if (m_bCapsReady.load(std::memory_order_acquire))
+        return m_implInfoList.empty() ? MFX_ERR_NOT_FOUND : MFX_ERR_NONE;
+
+    // MFXDispLoadAsync - wait for the background thread to finish
+    // (set before the handle is returned to the application, so no lock is needed)
+    if (m_asyncLoadStatus.valid())
+        return m_asyncLoadStatus.get();
+
+    // first caller loads the libraries, any others wait for it to finish
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+
+    if (m_bLibsLoaded)
+        return m_implInfoList.empty() ? MFX_ERR_NOT_FOUND : MFX_ERR_NONE;
+
+    m_bLibsLoaded = true;
+
+    mfxStatus sts = QueryAllLibraries();
+
+    SetCapsReady(sts == MFX_ERR_NONE);
+
+    return sts;
+}
+
+// apply the config filters which were set while loading, then mark the caps as ready
+// filters set after this are applied by SetConfigFilterProperty()
+// must be called with m_writeMutex held
+void LoaderCtxVPL::SetCapsReady(bool bApplyFilters) {
+    std::lock_guard<std::mutex> lock(m_configMutex);
+
+    if (bApplyFilters && !m_configCtxList.empty())
+        UpdateValidImplList();
+
+    m_bCapsReady.store(true, std::memory_order_release);
+}
+
+// body of the background thread started by StartAsyncLoad()
+// the application may add configs and set filters while this runs (see SetCapsReady),
+//   LoadLibsAndQueryCaps() waits for m_asyncLoadStatus
+mfxStatus LoaderCtxVPL::RunAsyncLoad(mfxDispLoadCallback callback, mfxHDL userData) {
+    mfxStatus sts = MFX_ERR_NONE;
+
+    {
+        std::lock_guard<std::mutex> lock(m_writeMutex);
+
+        m_bLibsLoaded = true;
+
+        sts = BuildListOfCandidateLibs();
+        if (sts == MFX_ERR_NONE)
+            sts = QueryAllLibraries();
+
+        if (sts == MFX_ERR_NONE && m_implInfoList.empty())
+            sts = MFX_ERR_NOT_FOUND;
+
+        SetCapsReady(sts == MFX_ERR_NONE);
+    }
+
+    // release any waiting threads before calling back to the application
+    m_asyncLoadPromise.set_value(sts);
+
+    if (callback)
+        callback((mfxLoader)this, sts, userData);
+
+    return sts;
+}
+
+mfxStatus LoaderCtxVPL::StartAsyncLoad(mfxDispLoadCallback callback, mfxHDL userData) {
+    m_asyncLoadStatus = m_asyncLoadPromise.get_future().share();
+
+    try {
+        m_asyncLoadThread = std::thread([this, callback, userData]() {
+            RunAsyncLoad(callback, userData);
+        });
+    }
+    catch (...) {
+        // failed to create thread - load on the calling thread instead
+        return RunAsyncLoad(callback, userData);
+    }
+
+    return MFX_ERR_NONE;
+}
+
+void LoaderCtxVPL::JoinAsyncLoad() {
+    if (!m_asyncLoadThread.joinable())
+        return;
+
+    // MFXUnload() called from the callback - the thread does not touch the loader
+    //   after the callback returns, so it can just finish on its own
+    if (m_asyncLoadThread.get_id() == std::this_thread::get_id()) {
+        m_asyncLoadThread.detach();
+        return;
+    }
+
+    m_asyncLoadThread.join();
+}
+
+// must be called with m_writeMutex held
+mfxStatus LoaderCtxVPL::QueryAllLibraries() {
+    // prune libraries which are not actually implementations, filling function
+    // ptr table for each library which is
+    mfxU32 numLibs = CheckValidLibraries();
+    if (numLibs == 0)
+        return MFX_ERR_NOT_FOUND;
+
+    // query capabilities of each implementation
+    // may be more than one implementation per library
+    mfxStatus sts = QueryLibraryCaps();
+
+    // share caps with other processes (ENV_ONEVPL_CAPS_SHM)
+    m_capsCache.PublishSharedSnapshot();
+
+    if (sts != MFX_ERR_NONE)
+        return MFX_ERR_NOT_FOUND;
+
+    if (m_bLoadBalance)
+        AssignSessionLoadCounters();
+
+    // filters which were set before the caps were available are applied by SetCapsReady()
+    if (m_bLazyLoad) {
+        // keep only the caps in memory - runtimes are loaded again on CreateSession
+        // if caps cannot be copied (unexpected), the library just stays loaded
+        for (auto libInfo : m_libInfoList)
+            UnloadLibraryKeepCaps(libInfo);
+    }
+
+    return MFX_ERR_NONE;
+}
+
+// publish new snapshot of valid implementations (in priority order) for readers
+// must be called after every change to validImplIdx or m_specialConfig
+void LoaderCtxVPL::PublishValidImpls() {
+    std::shared_ptr<ValidImplSnapshot> validImpls;
+    try {
+        validImpls = std::make_shared<ValidImplSnapshot>();
+        for (auto implInfo : m_implInfoList) {
+            if (implInfo->validImplIdx >= 0)
+                validImpls->implList.push_back(implInfo);
+        }
+    }
+    catch (...) {
+        // out of memory - keep previous snapshot
+        return;
+    }
+
+    validImpls->specialConfig = m_specialConfig;
+
+    std::atomic_store(&m_validImpls, std::shared_ptr<const ValidImplSnapshot>(validImpls));
+}
+
+std::shared_ptr<const ValidImplSnapshot> LoaderCtxVPL::GetValidImpls() {
+    return std::atomic_load(&m_validImpls);
+}
+
 // query implementation i
 mfxStatus LoaderCtxVPL::QueryImpl(mfxU32 idx, mfxImplCapsDeliveryFormat format, mfxHDL* idesc) {
     *idesc = nullptr;
 
-    std::list<ImplInfo*>::iterator it = m_implInfoList.begin();
-    while (it != m_implInfoList.end()) {
-        ImplInfo* implInfo = (*it);
-        if (implInfo->validImplIdx == (mfxI32)idx) {
-            if (format == MFX_IMPLCAPS_IMPLDESCSTRUCTURE) {
-                *idesc = implInfo->implDesc;
-            }
-            else if (format == MFX_IMPLCAPS_IMPLEMENTEDFUNCTIONS) {
-                *idesc = implInfo->implFuncs;
-            }
+    // lazy load mode - first call which requires caps
+    if (LoadLibsAndQueryCaps() != MFX_ERR_NONE)
+        return MFX_ERR_NOT_FOUND;
 
-            // implementation found, but requested query format is not supported
-            if (*idesc == nullptr)
-                return MFX_ERR_UNSUPPORTED;
+    std::shared_ptr<const ValidImplSnapshot> validImpls = GetValidImpls();
+    if (!validImpls || idx >= validImpls->implList.size())
+        return MFX_ERR_NOT_FOUND; // invalid idx
 
-            return MFX_ERR_NONE;
-        }
-        it++;
+    ImplInfo* implInfo = validImpls->implList[idx];
+    if (format == MFX_IMPLCAPS_IMPLDESCSTRUCTURE) {
+        *idesc = implInfo->implDesc;
+    }
+    else if (format == MFX_IMPLCAPS_IMPLEMENTEDFUNCTIONS) {
+        *idesc = implInfo->implFuncs;
     }
 
-    // invalid idx
-    return MFX_ERR_NOT_FOUND;
+    // implementation found, but requested query format is not supported
+    if (*idesc == nullptr)
+        return MFX_ERR_UNSUPPORTED;
+
+    return MFX_ERR_NONE;
 }
 
 mfxStatus LoaderCtxVPL::ReleaseImpl(mfxHDL idesc) {
@@ -731,7 +1257,7 @@ mfxStatus LoaderCtxVPL::ReleaseImpl(mfxHDL idesc) {
     // all we get from the application is a handle to the descriptor,
     //   not the implementation associated with it, so we search
     //   through the full list until we find a match
-    std::list<ImplInfo*>::iterator it = m_implInfoList.begin();
+    std::vector<ImplInfo*>::iterator it = m_implInfoList.begin();
     while (it != m_implInfoList.end()) {
         ImplInfo* implInfo                   = (*it);
         mfxImplCapsDeliveryFormat capsFormat = (mfxImplCapsDeliveryFormat)0; // unknown format
@@ -758,7 +1284,8 @@ mfxStatus LoaderCtxVPL::ReleaseImpl(mfxHDL idesc) {
             return MFX_ERR_NONE;
 
         // LibTypeMSDK does not require calling a release function
-        if (implInfo->libInfo->libType == LibTypeVPL) {
+        // caps owned by the dispatcher are not released until MFXUnload()
+        if (implInfo->libInfo->libType == LibTypeVPL && implInfo->capsBlob.implDesc.empty()) {
             // call MFXReleaseImplDescription() for this implementation
             VPLFunctionPtr pFunc = implInfo->libInfo->vplFuncTable[IdxMFXReleaseImplDescription];
 
@@ -779,14 +1306,27 @@ mfxStatus LoaderCtxVPL::ReleaseImpl(mfxHDL idesc) {
     return MFX_ERR_INVALID_HANDLE;
 }
 
-mfxStatus LoaderCtxVPL::UpdateValidImplList(void) {
+mfxStatus LoaderCtxVPL::UpdateValidImplList(const ConfigCtxVPL* changedConfig) {
     mfxStatus sts = MFX_ERR_NONE;
 
+    // lazy load mode - filters are applied once caps have been queried
+    if (!m_bLibsLoaded)
+        return MFX_ERR_NONE;
+
+    TimingScopeVPL timingScope(m_timing, TimingPhaseFilterValidation);
+
+    // combine all config filters once, rather than for each implementation
+    sts = ConfigCtxVPL::BuildFilterSet(m_configCtxList, &m_filterSet, &m_specialConfig);
+    if (sts != MFX_ERR_NONE)
+        return sts;
+
     mfxI32 validImplIdx = 0;
 
     // iterate over all libraries and update list of those that
     //   meet current current set of config props
-    std::list<ImplInfo*>::iterator it = m_implInfoList.begin();
+    // filters can only remove implementations and the sort keys (see PrioritizeImplList)
+    //   do not change, so the list remains in priority order and only needs to be re-indexed
+    std::vector<ImplInfo*>::iterator it = m_implInfoList.begin();
     while (it != m_implInfoList.end()) {
         ImplInfo* implInfo = (*it);
 
@@ -799,9 +1339,10 @@ mfxStatus LoaderCtxVPL::UpdateValidImplList(void) {
         // compare caps from this library vs. config filters
         sts = ConfigCtxVPL::ValidateConfig((mfxImplDescription*)implInfo->implDesc,
                                            (mfxImplementedFunctions*)implInfo->implFuncs,
-                                           m_configCtxList,
+                                           &implInfo->flatCaps,
+                                           m_filterSet,
                                            implInfo->libInfo->libType,
-                                           &m_specialConfig);
+                                           changedConfig);
 
         if (sts == MFX_ERR_NONE) {
             // library supports all required properties
@@ -816,8 +1357,7 @@ mfxStatus LoaderCtxVPL::UpdateValidImplList(void) {
         it++;
     }
 
-    // re-sort valid implementations according to priority rules in spec
-    PrioritizeImplList();
+    PublishValidImpls();
 
     return MFX_ERR_NONE;
 }
@@ -832,37 +1372,40 @@ mfxStatus LoaderCtxVPL::PrioritizeImplList(void) {
     // stable sort - work from lowest to highest priority conditions
 
     // 3 - sort by API version
-    m_implInfoList.sort([](const ImplInfo* impl1, const ImplInfo* impl2) {
+    auto byApiVersion = [](const ImplInfo* impl1, const ImplInfo* impl2) {
         mfxImplDescription* implDesc1 = (mfxImplDescription*)(impl1->implDesc);
         mfxImplDescription* implDesc2 = (mfxImplDescription*)(impl2->implDesc);
 
         // prioritize greatest API version
         return (implDesc1->ApiVersion.Version > implDesc2->ApiVersion.Version);
-    });
+    };
+    std::stable_sort(m_implInfoList.begin(), m_implInfoList.end(), byApiVersion);
 
     // 2 - sort by general HW vs. VSI
-    m_implInfoList.sort([](const ImplInfo* impl1, const ImplInfo* impl2) {
+    auto byAccelMode = [](const ImplInfo* impl1, const ImplInfo* impl2) {
         mfxImplDescription* implDesc1 = (mfxImplDescription*)(impl1->implDesc);
         mfxImplDescription* implDesc2 = (mfxImplDescription*)(impl2->implDesc);
 
         // prioritize general HW accelerator over VSI (if none, i.e. SW, will be sorted in final step)
         return (implDesc1->AccelerationMode != MFX_ACCEL_MODE_VIA_HDDLUNITE &&
                 implDesc2->AccelerationMode == MFX_ACCEL_MODE_VIA_HDDLUNITE);
-    });
+    };
+    std::stable_sort(m_implInfoList.begin(), m_implInfoList.end(), byAccelMode);
 
     // 1 - sort by implementation type (HW > SW)
-    m_implInfoList.sort([](const ImplInfo* impl1, const ImplInfo* impl2) {
+    auto byImplType = [](const ImplInfo* impl1, const ImplInfo* impl2) {
         mfxImplDescription* implDesc1 = (mfxImplDescription*)(impl1->implDesc);
         mfxImplDescription* implDesc2 = (mfxImplDescription*)(impl2->implDesc);
 
         // prioritize greatest Impl value (HW = 2, SW = 1)
         return (implDesc1->Impl > implDesc2->Impl);
-    });
+    };
+    std::stable_sort(m_implInfoList.begin(), m_implInfoList.end(), byImplType);
 
     // final pass - update index to match new priority order
     // validImplIdx will be the index associated with MFXEnumImplememntations()
     mfxI32 validImplIdx               = 0;
-    std::list<ImplInfo*>::iterator it = m_implInfoList.begin();
+    std::vector<ImplInfo*>::iterator it = m_implInfoList.begin();
     while (it != m_implInfoList.end()) {
         ImplInfo* implInfo = (*it);
 
@@ -872,64 +1415,282 @@ mfxStatus LoaderCtxVPL::PrioritizeImplList(void) {
         it++;
     }
 
+    PublishValidImpls();
+
     return MFX_ERR_NONE;
 }
 
+// create single session with the given implementation
+// may be called concurrently, so implInfo is not modified
+// hardware implementations are on the same device if vendor and device ID match
+// MSDK libraries report the device ID without the adapter index, so compare that too
+static bool IsSameDevice(const ImplInfo* implInfo1, const ImplInfo* implInfo2) {
+    mfxImplDescription* implDesc1 = (mfxImplDescription*)(implInfo1->implDesc);
+    mfxImplDescription* implDesc2 = (mfxImplDescription*)(implInfo2->implDesc);
+
+    if (implDesc1->Impl != MFX_IMPL_TYPE_HARDWARE || implDesc2->Impl != MFX_IMPL_TYPE_HARDWARE)
+        return false;
+
+    if (implDesc1->VendorID != implDesc2->VendorID ||
+        strncmp(implDesc1->Dev.DeviceID, implDesc2->Dev.DeviceID, MFX_STRFIELD_LEN))
+        return false;
+
+    LibInfo* libInfo1 = implInfo1->libInfo;
+    LibInfo* libInfo2 = implInfo2->libInfo;
+
+    mfxU32 adapter1 = (libInfo1->libType == LibTypeMSDK ? libInfo1->msdkCtx->msdkAdapter : 0);
+    mfxU32 adapter2 = (libInfo2->libType == LibTypeMSDK ? libInfo2->msdkCtx->msdkAdapter : 0);
+
+    return (adapter1 == adapter2);
+}
+
+// create open session counter for each implementation (ENV_ONEVPL_LOAD_BALANCE)
+// hardware implementations on the same device share one counter
+void LoaderCtxVPL::AssignSessionLoadCounters() {
+    for (size_t idx = 0; idx < m_implInfoList.size(); idx++) {
+        ImplInfo* implInfo = m_implInfoList[idx];
+        if (!implInfo->implDesc)
+            continue;
+
+        for (size_t prev = 0; prev < idx; prev++) {
+            if (m_implInfoList[prev]->implDesc && IsSameDevice(m_implInfoList[prev], implInfo)) {
+                implInfo->sessionLoad = m_implInfoList[prev]->sessionLoad;
+                break;
+            }
+        }
+
+        if (!implInfo->sessionLoad)
+            implInfo->sessionLoad = std::make_shared<std::atomic<mfxU32>>(0);
+    }
+}
+
+// same runtime on another device: hardware implementation with the same vendor, name and
+//   API version, so a session on either one behaves the same for the application
+static bool IsEquivalentImpl(const ImplInfo* implInfo1, const ImplInfo* implInfo2) {
+    mfxImplDescription* implDesc1 = (mfxImplDescription*)(implInfo1->implDesc);
+    mfxImplDescription* implDesc2 = (mfxImplDescription*)(implInfo2->implDesc);
+
+    if (implDesc1->Impl != MFX_IMPL_TYPE_HARDWARE || implDesc2->Impl != MFX_IMPL_TYPE_HARDWARE)
+        return false;
+
+    return (implDesc1->VendorID == implDesc2->VendorID &&
+            implDesc1->ApiVersion.Version == implDesc2->ApiVersion.Version &&
+            !strncmp(implDesc1->ImplName, implDesc2->ImplName, MFX_IMPL_NAME_LEN) &&
+            implInfo1->sessionLoad != implInfo2->sessionLoad);
+}
+
+// with ENV_ONEVPL_LOAD_BALANCE, return the implementation with the fewest open sessions on its
+//   device among the requested one and its equivalents on other devices (IsEquivalentImpl) -
+//   the requested implementation wins ties, then the usual priority order
+// sessions idle in the session pool are not counted
+// otherwise return the requested implementation
+// concurrent callers may see the same counts and pick the same implementation
+ImplInfo* LoaderCtxVPL::SelectLeastLoadedImpl(const ValidImplSnapshot& validImpls, mfxU32 idx) {
+    ImplInfo* requestedImpl = validImpls.implList[idx];
+    ImplInfo* bestImpl      = requestedImpl;
+    if (!m_bLoadBalance || !bestImpl->sessionLoad)
+        return bestImpl;
+
+    mfxU32 bestLoad = bestImpl->sessionLoad->load();
+    for (ImplInfo* implInfo : validImpls.implList) {
+        if (!bestLoad)
+            break;
+
+        if (!implInfo->sessionLoad || !IsEquivalentImpl(requestedImpl, implInfo))
+            continue;
+
+        mfxU32 load = implInfo->sessionLoad->load();
+        if (load < bestLoad) {
+            bestImpl = implInfo;
+            bestLoad = load;
+        }
+    }
+
+    return bestImpl;
+}
+
+mfxStatus LoaderCtxVPL::CreateSessionForImpl(ImplInfo* implInfo,
+                                             const SpecialConfig& specialConfig,
+                                             mfxSession* session) {
+    mfxStatus sts                   = MFX_ERR_NONE;
+    LibInfo* libInfo                = implInfo->libInfo;
+    mfxU16 deviceID                 = 0;
+    mfxInitializationParam vplParam = implInfo->vplParam;
+
+    // pass VendorImplID for this implementation (disambiguate if one
+    //   library contains multiple implementations)
+    mfxImplDescription* implDesc = (mfxImplDescription*)(implInfo->implDesc);
+
+    // should not happen in normal circumstances, but avoid using nullptr if something went wrong
+    if (!implDesc)
+        return MFX_ERR_NULL_PTR;
+
+    vplParam.VendorImplID = implDesc->VendorImplID;
+
+    // set any special parameters passed in via SetConfigProperty
+    if (specialConfig.accelerationMode)
+        vplParam.AccelerationMode = specialConfig.accelerationMode;
+
+    // count the session on its device until MFXClose() frees it (ENV_ONEVPL_LOAD_BALANCE)
+    // released right away if initialization fails
+    // the ref points to the counter, so that it tests as non-null while it is owned
+    std::shared_ptr<void> sessionRef;
+    if (implInfo->sessionLoad) {
+        std::shared_ptr<std::atomic<mfxU32>> sessionLoad = implInfo->sessionLoad;
+
+        (*sessionLoad)++;
+        sessionRef = std::shared_ptr<void>(sessionLoad.get(), [sessionLoad](void*) {
+            (*sessionLoad)--;
+        });
+    }
+
+    // initialize this library via MFXInitialize or else fail
+    //   (specify full path to library)
+    // runtime module is loaded on the first call and shared by later sessions
+    TimingScopeVPL initTiming(m_timing, TimingPhaseInitSession, &libInfo->libNameFull);
+
+    sts = MFXInitEx2(implInfo->version,
+                     vplParam,
+                     (libInfo->libType == LibTypeMSDK ? libInfo->msdkCtx->msdkAdapter : 0),
+                     session,
+                     &deviceID,
+                     (CHAR_TYPE*)libInfo->libNameFull.c_str(),
+                     &libInfo->sessionModule,
+                     std::move(sessionRef));
+
+    initTiming.Stop();
+
+    // optionally call MFXSetHandle() if present via SetConfigProperty
+    if (sts == MFX_ERR_NONE && specialConfig.deviceHandleType && specialConfig.deviceHandle) {
+        sts = MFXVideoCORE_SetHandle(*session,
+                                     specialConfig.deviceHandleType,
+                                     specialConfig.deviceHandle);
+    }
+
+    return sts;
+}
+
 mfxStatus LoaderCtxVPL::CreateSession(mfxU32 idx, mfxSession* session) {
+    // lazy load mode - first call which requires caps
+    if (LoadLibsAndQueryCaps() != MFX_ERR_NONE)
+        return MFX_ERR_NOT_FOUND;
+
+    std::shared_ptr<const ValidImplSnapshot> validImpls = GetValidImpls();
+    if (!validImpls || idx >= validImpls->implList.size())
+        return MFX_ERR_NOT_FOUND; // invalid idx
+
+    ImplInfo* implInfo = SelectLeastLoadedImpl(*validImpls, idx);
+
+    return CreateSessionForImpl(implInfo, validImpls->specialConfig, session);
+}
+
+// get idle session from the pool, or create a new one if none is available
+mfxStatus LoaderCtxVPL::AcquireSession(mfxU32 idx, mfxSession* session) {
+    // lazy load mode - first call which requires caps
+    if (LoadLibsAndQueryCaps() != MFX_ERR_NONE)
+        return MFX_ERR_NOT_FOUND;
+
+    std::shared_ptr<const ValidImplSnapshot> validImpls = GetValidImpls();
+    if (!validImpls || idx >= validImpls->implList.size())
+        return MFX_ERR_NOT_FOUND; // invalid idx
+
+    ImplInfo* implInfo = SelectLeastLoadedImpl(*validImpls, idx);
+
+    *session = m_sessionPool.Get(implInfo, validImpls->specialConfig);
+    if (*session)
+        return MFX_ERR_NONE;
+
+    mfxStatus sts = CreateSessionForImpl(implInfo, validImpls->specialConfig, session);
+    if (sts != MFX_ERR_NONE)
+        return sts;
+
+    m_sessionPool.AddActive(*session, implInfo, validImpls->specialConfig);
+
+    return MFX_ERR_NONE;
+}
+
+// return session obtained with AcquireSession() to the pool
+mfxStatus LoaderCtxVPL::ReleaseSession(mfxSession session) {
+    return m_sessionPool.Put(session);
+}
+
+// create multiple sessions with the same implementation
+// on failure all sessions created here are closed again
+mfxStatus LoaderCtxVPL::CreateSessions(mfxU32 idx,
+                                       mfxU32 numSessions,
+                                       mfxSession* sessions,
+                                       mfxU32 flags) {
     mfxStatus sts = MFX_ERR_NONE;
 
-    // find library with given implementation index
-    // list of valid implementations (and associated indices) is updated
-    //   every time a filter property is added/modified
-    std::list<ImplInfo*>::iterator it = m_implInfoList.begin();
-    while (it != m_implInfoList.end()) {
-        ImplInfo* implInfo = (*it);
+    for (mfxU32 n = 0; n < numSessions; n++)
+        sessions[n] = nullptr;
 
-        if (implInfo->validImplIdx == (mfxI32)idx) {
-            LibInfo* libInfo = implInfo->libInfo;
-            mfxU16 deviceID  = 0;
-
-            if (sts == MFX_ERR_NONE) {
-                // pass VendorImplID for this implementation (disambiguate if one
-                //   library contains multiple implementations)
-                mfxImplDescription* implDesc = (mfxImplDescription*)(implInfo->implDesc);
-
-                // should not happen in normal circumstances, but avoid using nullptr if something went wrong
-                if (!implDesc)
-                    return MFX_ERR_NULL_PTR;
-
-                implInfo->vplParam.VendorImplID = implDesc->VendorImplID;
-
-                // set any special parameters passed in via SetConfigProperty
-                if (m_specialConfig.accelerationMode)
-                    implInfo->vplParam.AccelerationMode = m_specialConfig.accelerationMode;
-
-                // initialize this library via MFXInitialize or else fail
-                //   (specify full path to library)
-                sts = MFXInitEx2(
-                    implInfo->version,
-                    implInfo->vplParam,
-                    (libInfo->libType == LibTypeMSDK ? libInfo->msdkCtx->msdkAdapter : 0),
-                    session,
-                    &deviceID,
-                    (CHAR_TYPE*)libInfo->libNameFull.c_str());
-            }
+    // lazy load mode - first call which requires caps
+    if (LoadLibsAndQueryCaps() != MFX_ERR_NONE)
+        return MFX_ERR_NOT_FOUND;
 
-            // optionally call MFXSetHandle() if present via SetConfigProperty
-            if (sts == MFX_ERR_NONE && m_specialConfig.deviceHandleType &&
-                m_specialConfig.deviceHandle) {
-                sts = MFXVideoCORE_SetHandle(*session,
-                                             m_specialConfig.deviceHandleType,
-                                             m_specialConfig.deviceHandle);
-            }
+    std::shared_ptr<const ValidImplSnapshot> validImpls = GetValidImpls();
+    if (!validImpls || idx >= validImpls->implList.size())
+        return MFX_ERR_NOT_FOUND; // invalid idx
+
+    ImplInfo* implInfo = SelectLeastLoadedImpl(*validImpls, idx);
+
+    mfxU32 numCreated = 0;
+    mfxU32 numJoined  = 0;
+    for (numCreated = 0; numCreated < numSessions; numCreated++) {
+        sts = CreateSessionForImpl(implInfo, validImpls->specialConfig, &sessions[numCreated]);
+        if (sts != MFX_ERR_NONE) {
+            // SetHandle() may fail after the session was created
+            if (sessions[numCreated])
+                numCreated++;
+            break;
+        }
+    }
 
-            return sts;
+    if (sts == MFX_ERR_NONE && (flags & MFX_DISP_SESSIONS_JOIN)) {
+        for (numJoined = 1; numJoined < numSessions; numJoined++) {
+            sts = MFXJoinSession(sessions[0], sessions[numJoined]);
+            if (sts != MFX_ERR_NONE)
+                break;
+        }
+    }
+
+    if (sts != MFX_ERR_NONE) {
+        // child sessions must be disjoined before the parent is closed
+        for (mfxU32 n = 1; n < numJoined; n++)
+            MFXDisjoinSession(sessions[n]);
+
+        for (mfxU32 n = 0; n < numCreated; n++) {
+            MFXClose(sessions[n]);
+            sessions[n] = nullptr;
         }
-        it++;
     }
 
-    // invalid idx
-    return MFX_ERR_NOT_FOUND;
+    return sts;
+}
+
+mfxStatus LoaderCtxVPL::SetConfigFilterProperty(ConfigCtxVPL* configCtx,
+                                                const mfxU8* name,
+                                                mfxVariant value) {
+    mfxStatus sts = MFX_ERR_NONE;
+
+    {
+        std::lock_guard<std::mutex> lock(m_configMutex);
+
+        sts = configCtx->SetFilterProperty(name, value);
+
+        // still loading (lazy or async load) - applied by SetCapsReady()
+        if (!m_bCapsReady.load(std::memory_order_acquire))
+            return sts;
+    }
+
+    // update list of valid libraries based on updated set of
+    //   mfxConfig properties (only need to re-check the one that changed)
+    std::lock_guard<std::mutex> writeLock(m_writeMutex);
+    std::lock_guard<std::mutex> configLock(m_configMutex);
+    UpdateValidImplList(configCtx);
+
+    return sts;
 }
 
 ConfigCtxVPL* LoaderCtxVPL::AddConfigFilter() {
@@ -946,13 +1707,14 @@ ConfigCtxVPL* LoaderCtxVPL::AddConfigFilter() {
     ConfigCtxVPL* config   = (ConfigCtxVPL*)(configCtx.release());
     config->m_parentLoader = this;
 
+    std::lock_guard<std::mutex> lock(m_configMutex);
     m_configCtxList.push_back(config);
 
     return config;
 }
 
 mfxStatus LoaderCtxVPL::FreeConfigFilters() {
-    std::list<ConfigCtxVPL*>::iterator it = m_configCtxList.begin();
+    std::vector<ConfigCtxVPL*>::iterator it = m_configCtxList.begin();
 
     while (it != m_configCtxList.end()) {
         ConfigCtxVPL* config = (*it);
@@ -193,15 +193,97 @@ mfxStatus LoaderCtxMSDK::CheckAccelType(mfxU32 adapterID, mfxIMPL implTest) {
 #endif
 }
 
+// successful probe of one library, see QueryMSDKCaps()
+struct MSDKProbeResult {
+    CapsCacheKey key;
+    mfxImplDescription id;
+    mfxAccelerationMode accelMode[MAX_MSDK_ACCEL_MODES];
+};
+
+// probe results shared by all loaders in the process, keyed by full path of the library
+static std::mutex msdkProbeMutex;
+static std::map<STRING_TYPE, MSDKProbeResult> msdkProbeResults;
+
 mfxStatus LoaderCtxMSDK::QueryMSDKCaps(STRING_TYPE libNameFull,
                                        mfxImplDescription** implDesc,
                                        mfxImplementedFunctions** implFuncs,
                                        mfxIMPL* msdkAdapter) {
-    mfxStatus sts;
-    mfxSession session;
+    m_libNameFull = libNameFull;
+
+    // reuse result of an earlier probe if the library file has not changed
+    CapsCacheKey key;
+    if (CapsCacheVPL::GetCacheKey(m_libNameFull, &key) != MFX_ERR_NONE)
+        return ProbeMSDKCaps(implDesc, implFuncs, msdkAdapter);
+
+    {
+        std::lock_guard<std::mutex> lock(msdkProbeMutex);
+
+        auto it = msdkProbeResults.find(m_libNameFull);
+        if (it != msdkProbeResults.end() && it->second.key == key)
+            return SetCaps(&it->second.id, implDesc, implFuncs, msdkAdapter);
+    }
+
+    // probe without holding the lock, failures are not saved since they may be temporary
+    mfxStatus sts = ProbeMSDKCaps(implDesc, implFuncs, msdkAdapter);
+    if (sts != MFX_ERR_NONE)
+        return sts;
+
+    std::lock_guard<std::mutex> lock(msdkProbeMutex);
+
+    MSDKProbeResult& result = msdkProbeResults[m_libNameFull];
+    result.key              = key;
+    result.id               = m_id;
+    memcpy(result.accelMode, m_accelMode, sizeof(result.accelMode));
+    result.id.AccelerationModeDescription.Mode = result.accelMode;
+
+    return MFX_ERR_NONE;
+}
 
+mfxStatus LoaderCtxMSDK::LoadCachedCaps(STRING_TYPE libNameFull,
+                                        const mfxImplDescription* cachedDesc,
+                                        mfxImplDescription** implDesc,
+                                        mfxImplementedFunctions** implFuncs,
+                                        mfxIMPL* msdkAdapter) {
     m_libNameFull = libNameFull;
 
+    return SetCaps(cachedDesc, implDesc, implFuncs, msdkAdapter);
+}
+
+mfxStatus LoaderCtxMSDK::SetCaps(const mfxImplDescription* srcDesc,
+                                 mfxImplDescription** implDesc,
+                                 mfxImplementedFunctions** implFuncs,
+                                 mfxIMPL* msdkAdapter) {
+    const mfxAccelerationModeDescription* srcAccelDesc = &(srcDesc->AccelerationModeDescription);
+
+    mfxU16 numAccelModes = srcAccelDesc->NumAccelerationModes;
+    if (numAccelModes == 0 || numAccelModes > MAX_MSDK_ACCEL_MODES || !srcAccelDesc->Mode)
+        return MFX_ERR_UNSUPPORTED;
+
+    // adapter is not part of the description, but VendorImplID was mapped from it
+    mfxIMPL adapter = MFX_IMPL_UNSUPPORTED;
+    if (srcDesc->Impl == MFX_IMPL_TYPE_HARDWARE) {
+        if (srcDesc->VendorImplID >= TAB_SIZE(mfxIMPL, hwImplTypes))
+            return MFX_ERR_UNSUPPORTED;
+        adapter = hwImplTypes[srcDesc->VendorImplID];
+    }
+
+    m_id = *srcDesc;
+    memcpy(m_accelMode, srcAccelDesc->Mode, numAccelModes * sizeof(mfxAccelerationMode));
+    m_id.AccelerationModeDescription.Mode = m_accelMode;
+
+    *implDesc    = &m_id;
+    *implFuncs   = (mfxImplementedFunctions*)(&msdkImplFuncs);
+    *msdkAdapter = adapter;
+
+    return MFX_ERR_NONE;
+}
+
+mfxStatus LoaderCtxMSDK::ProbeMSDKCaps(mfxImplDescription** implDesc,
+                                       mfxImplementedFunctions** implFuncs,
+                                       mfxIMPL* msdkAdapter) {
+    mfxStatus sts;
+    mfxSession session;
+
     mfxIMPL msdkImplType = MFX_IMPL_UNSUPPORTED;
     *msdkAdapter         = MFX_IMPL_UNSUPPORTED;
 
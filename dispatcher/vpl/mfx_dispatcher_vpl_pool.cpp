@@ -0,0 +1,196 @@
+/*############################################################################
+  # Copyright (C) Intel Corporation
+  #
+  # SPDX-License-Identifier: MIT
+  ############################################################################*/
+
+#include "vpl/mfx_dispatcher_vpl.h"
+
+SessionPoolVPL::SessionPoolVPL()
+        : m_mutex(),
+          m_idleSessions(),
+          m_activeSessions(),
+          m_maxIdle(DEFAULT_SESSION_POOL_MAX_IDLE),
+          m_idleTimeoutMs(DEFAULT_SESSION_POOL_IDLE_MS) {}
+
+SessionPoolVPL::~SessionPoolVPL() {
+    Clear();
+}
+
+void SessionPoolVPL::Init() {
+    mfxU32 val = 0;
+
+    if (GetEnvVarU32(ENV_ONEVPL_SESSION_POOL_MAX_IDLE, &val))
+        m_maxIdle = val;
+
+    if (GetEnvVarU32(ENV_ONEVPL_SESSION_POOL_IDLE_MS, &val))
+        m_idleTimeoutMs = val;
+}
+
+void SessionPoolVPL::SetParams(mfxU32 maxIdle, mfxU32 idleTimeoutMs) {
+    std::list<mfxSession> closeList;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_maxIdle       = maxIdle;
+        m_idleTimeoutMs = idleTimeoutMs;
+
+        // trim pools which are now over the limit (oldest sessions are at the back)
+        for (auto& pool : m_idleSessions) {
+            while (pool.second.size() > m_maxIdle) {
+                closeList.push_back(pool.second.back().session);
+                CountIdle(pool.first, false);
+                pool.second.pop_back();
+            }
+        }
+    }
+
+    for (mfxSession session : closeList)
+        MFXClose(session);
+}
+
+SessionPoolVPL::PoolKey SessionPoolVPL::MakeKey(const ImplInfo* implInfo,
+                                                const SpecialConfig& specialConfig) {
+    // the handle is only set if both type and handle are given, see CreateSessionForImpl()
+    mfxHandleType handleType = static_cast<mfxHandleType>(0);
+    mfxHDL handle            = nullptr;
+    if (specialConfig.deviceHandleType && specialConfig.deviceHandle) {
+        handleType = specialConfig.deviceHandleType;
+        handle     = specialConfig.deviceHandle;
+    }
+
+    return PoolKey(implInfo, specialConfig.accelerationMode, handleType, handle);
+}
+
+// idle sessions do not count as load on their device (ENV_ONEVPL_LOAD_BALANCE)
+// the count is restored when a session leaves the pool, before it is reused or closed,
+//   since MFXClose() releases the session's reference to the counter
+void SessionPoolVPL::CountIdle(const PoolKey& key, bool bIdle) {
+    const ImplInfo* implInfo = std::get<0>(key);
+    if (!implInfo->sessionLoad)
+        return;
+
+    if (bIdle)
+        (*implInfo->sessionLoad)--;
+    else
+        (*implInfo->sessionLoad)++;
+}
+
+// must be called with m_mutex held
+void SessionPoolVPL::RemoveExpired(ClockType::time_point now, std::list<mfxSession>& closeList) {
+    if (m_idleTimeoutMs == 0)
+        return;
+
+    std::chrono::milliseconds timeout(m_idleTimeoutMs);
+
+    for (auto& pool : m_idleSessions) {
+        while (!pool.second.empty() && (now - pool.second.back().releaseTime) >= timeout) {
+            closeList.push_back(pool.second.back().session);
+            CountIdle(pool.first, false);
+            pool.second.pop_back();
+        }
+    }
+}
+
+mfxSession SessionPoolVPL::Get(const ImplInfo* implInfo, const SpecialConfig& specialConfig) {
+    PoolKey key        = MakeKey(implInfo, specialConfig);
+    mfxSession session = nullptr;
+    std::list<mfxSession> closeList;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        RemoveExpired(ClockType::now(), closeList);
+
+        auto it = m_idleSessions.find(key);
+        if (it != m_idleSessions.end() && !it->second.empty()) {
+            // reuse most recently returned session
+            session = it->second.front().session;
+            it->second.pop_front();
+            CountIdle(key, false);
+
+            m_activeSessions[session] = key;
+        }
+    }
+
+    for (mfxSession expired : closeList)
+        MFXClose(expired);
+
+    return session;
+}
+
+void SessionPoolVPL::AddActive(mfxSession session,
+                               const ImplInfo* implInfo,
+                               const SpecialConfig& specialConfig) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_activeSessions[session] = MakeKey(implInfo, specialConfig);
+}
+
+mfxStatus SessionPoolVPL::Put(mfxSession session) {
+    PoolKey key;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto it = m_activeSessions.find(session);
+        if (it == m_activeSessions.end())
+            return MFX_ERR_INVALID_HANDLE; // not acquired from this pool
+
+        key = it->second;
+        m_activeSessions.erase(it);
+    }
+
+    // reset session so the next user starts from a clean state
+    // components which were not initialized return an error, which is ignored
+    MFXVideoDECODE_Close(session);
+    MFXVideoENCODE_Close(session);
+    MFXVideoVPP_Close(session);
+
+    std::list<mfxSession> closeList;
+    bool bPooled = false;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        ClockType::time_point now = ClockType::now();
+        RemoveExpired(now, closeList);
+
+        std::list<IdleSession>& pool = m_idleSessions[key];
+        if (pool.size() < m_maxIdle) {
+            pool.push_front({ session, now });
+            CountIdle(key, true);
+            bPooled = true;
+        }
+    }
+
+    for (mfxSession expired : closeList)
+        MFXClose(expired);
+
+    if (!bPooled)
+        return MFXClose(session);
+
+    return MFX_ERR_NONE;
+}
+
+void SessionPoolVPL::Clear() {
+    std::list<mfxSession> closeList;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        for (auto& pool : m_idleSessions) {
+            for (IdleSession& idle : pool.second) {
+                closeList.push_back(idle.session);
+                CountIdle(pool.first, false);
+            }
+        }
+
+        m_idleSessions.clear();
+        m_activeSessions.clear();
+    }
+
+    for (mfxSession session : closeList)
+        MFXClose(session);
+}
@@ -0,0 +1,143 @@
+/*############################################################################
+  # Copyright (C) Intel Corporation
+  #
+  # SPDX-License-Identifier: MIT
+  ############################################################################*/
+
+#include "vpl/mfx_dispatcher_vpl.h"
+
+#include <stdio.h>
+
+// names used in JSON output, same order as enum TimingPhase
+static const char* TimingPhaseNames[TimingPhaseCount] = {
+    "dir_scan",
+    "load_lib",
+    "resolve_exports",
+    "query_impls",
+    "msdk_probe",
+    "filter_validation",
+    "init_session",
+};
+
+std::string MakeJSONString(const STRING_TYPE& str) {
+    std::string out = "\"";
+
+    for (auto c : str) {
+        switch (c) {
+            case '"':
+                out += "\\\"";
+                break;
+            case '\\':
+                out += "\\\\";
+                break;
+            default:
+                if (c < 0x20 || c > 0x7E)
+                    out += '?';
+                else
+                    out += (char)c;
+                break;
+        }
+    }
+
+    out += "\"";
+
+    return out;
+}
+
+LoaderTimingVPL::LoaderTimingVPL() : m_mutex(), m_stats(), m_bEnabled(false), m_dumpFile() {}
+
+LoaderTimingVPL::~LoaderTimingVPL() {}
+
+void LoaderTimingVPL::Init() {
+    mfxU32 enable = 0;
+    if (GetEnvVarU32(ENV_ONEVPL_TIMING, &enable))
+        m_bEnabled = (enable != 0);
+
+#if defined(_WIN32) || defined(_WIN64)
+    CHAR_TYPE envVar[MAX_VPL_SEARCH_PATH] = { L"" };
+    if (GetEnvironmentVariableW(ENV_ONEVPL_TIMING_FILE, envVar, MAX_VPL_SEARCH_PATH))
+        m_dumpFile = envVar;
+#else
+    CHAR_TYPE* envVar = getenv(ENV_ONEVPL_TIMING_FILE);
+    if (envVar)
+        m_dumpFile = envVar;
+#endif
+
+    if (!m_dumpFile.empty())
+        m_bEnabled = true;
+}
+
+void LoaderTimingVPL::AddSample(TimingPhase phase,
+                                const STRING_TYPE* libName,
+                                ClockType::duration duration) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto key = std::make_pair((mfxU32)phase, libName ? *libName : STRING_TYPE());
+
+    auto it = m_stats.find(key);
+    if (it == m_stats.end()) {
+        m_stats[key] = { 1, duration, duration };
+        return;
+    }
+
+    PhaseStats& stats = it->second;
+    stats.count++;
+    stats.total += duration;
+    stats.max = std::max(stats.max, duration);
+}
+
+// format:
+// { "phases": [ { "phase": "load_lib", "lib": "/path/libvplstub.so",
+//                 "count": 1, "total_us": 123.4, "max_us": 123.4 }, ... ] }
+std::string LoaderTimingVPL::GetJSON() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::string json = "{\"phases\":[";
+    char buf[128];
+
+    bool bFirst = true;
+    for (auto& entry : m_stats) {
+        const PhaseStats& stats = entry.second;
+
+        double totalUs = std::chrono::duration<double, std::micro>(stats.total).count();
+        double maxUs   = std::chrono::duration<double, std::micro>(stats.max).count();
+
+        json += (bFirst ? "{" : ",{");
+        json += "\"phase\":\"";
+        json += TimingPhaseNames[entry.first.first];
+        json += "\",\"lib\":";
+        json += MakeJSONString(entry.first.second);
+
+        snprintf(buf,
+                 sizeof(buf),
+                 ",\"count\":%llu,\"total_us\":%.1f,\"max_us\":%.1f}",
+                 (unsigned long long)stats.count,
+                 totalUs,
+                 maxUs);
+        json += buf;
+
+        bFirst = false;
+    }
+
+    json += "]}";
+
+    return json;
+}
+
+void LoaderTimingVPL::DumpJSON() {
+    if (!m_bEnabled || m_dumpFile.empty())
+        return;
+
+    std::string json = GetJSON();
+
+#if defined(_WIN32) || defined(_WIN64)
+    FILE* fp = _wfopen(m_dumpFile.c_str(), L"w");
+#else
+    FILE* fp = fopen(m_dumpFile.c_str(), "w");
+#endif
+    if (!fp)
+        return;
+
+    fprintf(fp, "%s\n", json.c_str());
+    fclose(fp);
+}
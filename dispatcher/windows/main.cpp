@@ -7,6 +7,7 @@
 #include <Windows.h>
 #include <stringapiset.h>
 
+#include <map>
 #include <memory>
 #include <new>
 
@@ -18,6 +19,8 @@
 
 #include "windows/mfx_vector.h"
 
+#include "vpl/mfxdispatcherext.h"
+
 #if defined(MEDIASDK_UWP_DISPATCHER)
     #include "windows/mfx_driver_store_loader.h"
 #endif
@@ -71,6 +74,9 @@ const struct {
 
 MFX::mfxCriticalSection dispGuard = 0;
 
+// references held by sessions created with MFXInitEx2(), protected by dispGuard
+std::map<MFX_DISP_HANDLE *, std::shared_ptr<void>> sessionRefs;
+
 } // namespace
 
 using namespace MFX;
@@ -479,12 +485,17 @@ mfxStatus MFXInitEx(mfxInitParam par, mfxSession *session) {
 
 // internal function - load a specific DLL, return unsupported if it fails
 // vplParam is required for API >= 2.0 (load via MFXInitialize)
+// libModule is not used on Windows - each handle loads the DLL through MFX_DISP_HANDLE
+// sessionRef is optional - held until the session is freed by MFXClose()
+//   (kept in a separate map so that the layout of MFX_DISP_HANDLE does not change)
 mfxStatus MFXInitEx2(mfxVersion version,
                      mfxInitializationParam vplParam,
                      mfxIMPL hwImpl,
                      mfxSession *session,
                      mfxU16 *deviceID,
-                     wchar_t *dllName) {
+                     wchar_t *dllName,
+                     std::shared_ptr<void> * /*libModule*/,
+                     std::shared_ptr<void> sessionRef) {
     MFX::MFXAutomaticCriticalSection guard(&dispGuard);
 
     mfxStatus mfxRes = MFX_ERR_NONE;
@@ -565,6 +576,18 @@ mfxStatus MFXInitEx2(mfxVersion version,
         }
     }
 
+    // a ref may own a deleter with a null pointer, so check ownership, not the pointer
+    if (sessionRef.use_count()) {
+        try {
+            sessionRefs[pHandle] = std::move(sessionRef);
+        }
+        catch (...) {
+            pHandle->Close();
+            delete pHandle;
+            return MFX_ERR_MEMORY_ALLOC;
+        }
+    }
+
     // everything is OK. Save pointers to the output variable
     *((MFX_DISP_HANDLE **)session) = pHandle;
 
@@ -587,6 +610,7 @@ mfxStatus MFXClose(mfxSession session) {
             // can't unload library in that case.
             if (MFX_ERR_UNDEFINED_BEHAVIOR != mfxRes) {
                 // release the handle
+                sessionRefs.erase(pHandle);
                 delete pHandle;
             }
         }
@@ -985,6 +1009,14 @@ mfxStatus MFXVideoVPP_ProcessFrameAsync(mfxSession session,
     return sts;
 }
 
+// per-call statistics are only recorded by the dispatcher for Linux (dispatcher extension)
+mfxStatus MFXDispQueryCallStats(mfxChar *buffer, mfxU32 *size) {
+    if (!size)
+        return MFX_ERR_NULL_PTR;
+
+    return MFX_ERR_UNSUPPORTED;
+}
+
 //
 //
 // implement all other calling functions.
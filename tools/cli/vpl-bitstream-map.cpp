@@ -0,0 +1,172 @@
+/*############################################################################
+  # Copyright (C) Intel Corporation
+  #
+  # SPDX-License-Identifier: MIT
+  ############################################################################*/
+
+#include "./vpl-bitstream-map.h"
+
+#include <string.h>
+
+#if !defined(_WIN32) && !defined(_WIN64)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+BitstreamMap::BitstreamMap()
+        : m_base(nullptr),
+          m_size(0),
+          m_windowSize(0),
+          m_repeat(0),
+          m_bMapped(false),
+          m_window(nullptr),
+          m_windowPos(0),
+          m_splice(),
+          m_preload() {}
+
+BitstreamMap::~BitstreamMap() {
+    Close();
+}
+
+bool BitstreamMap::Open(const char* fileName, mfxU32 windowSize, mfxU32 repeat) {
+    Close();
+
+    if (!fileName || windowSize == 0)
+        return false;
+
+#if defined(_WIN32) || defined(_WIN64)
+    return false;
+#else
+    int fd = open(fileName, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+
+    // private writable mapping - the bitstream is passed to the runtime as non-const,
+    //   any write goes to a private copy of the page, never to the file
+    void* addr = mmap(nullptr, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+        return false;
+
+    // the file is read from start to end
+    madvise(addr, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    m_base    = (mfxU8*)addr;
+    m_size    = (size_t)st.st_size;
+    m_bMapped = true;
+
+    return Init(windowSize, repeat);
+#endif
+}
+
+bool BitstreamMap::Preload(const char* fileName, mfxU32 windowSize, mfxU32 repeat) {
+    Close();
+
+    if (windowSize == 0 || !m_preload.Load(fileName, 0))
+        return false;
+
+    m_base = m_preload.GetData();
+    m_size = m_preload.GetSize();
+
+    return Init(windowSize, repeat);
+}
+
+bool BitstreamMap::Init(mfxU32 windowSize, mfxU32 repeat) {
+    m_windowSize = windowSize;
+    m_repeat     = repeat;
+    m_window     = nullptr;
+    m_windowPos  = 0;
+
+    try {
+        if (repeat)
+            m_splice.resize(windowSize);
+    }
+    catch (...) {
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+void BitstreamMap::Close() {
+#if !defined(_WIN32) && !defined(_WIN64)
+    if (m_bMapped)
+        munmap(m_base, m_size);
+#endif
+    m_preload.Free();
+    m_splice.clear();
+
+    m_base       = nullptr;
+    m_size       = 0;
+    m_windowSize = 0;
+    m_repeat     = 0;
+    m_bMapped    = false;
+    m_window     = nullptr;
+    m_windowPos  = 0;
+}
+
+mfxStatus BitstreamMap::Read(mfxBitstream& bs) {
+    if (!m_base)
+        return MFX_ERR_NOT_INITIALIZED;
+
+    // first unconsumed byte, or start of input if bs does not point to the window yet
+    mfxU64 total = (mfxU64)m_size * (m_repeat + 1);
+    mfxU64 pos   = 0;
+    if (m_window && bs.Data == m_window)
+        pos = m_windowPos + bs.DataOffset;
+    if (pos > total)
+        pos = total;
+
+    size_t len = m_windowSize;
+    if (total - pos < len)
+        len = (size_t)(total - pos);
+
+    size_t offset = (size_t)(pos % m_size);
+    if (offset + len <= m_size) {
+        m_window = m_base + offset;
+    }
+    else {
+        // the end of one repeat and the start of the next must be in one buffer
+        size_t copied = 0;
+        while (copied < len) {
+            size_t n = m_size - offset;
+            if (n > len - copied)
+                n = len - copied;
+
+            memcpy(m_splice.data() + copied, m_base + offset, n);
+            copied += n;
+            offset = 0;
+        }
+        m_window = m_splice.data();
+    }
+    m_windowPos = pos;
+
+    bs.Data       = m_window;
+    bs.DataOffset = 0;
+    bs.DataLength = (mfxU32)len;
+    bs.MaxLength  = (mfxU32)len;
+
+    if (len == 0)
+        return MFX_ERR_MORE_DATA;
+
+    return MFX_ERR_NONE;
+}
+
+void BitstreamMap::Rewind(mfxBitstream& bs) {
+    m_window    = m_base;
+    m_windowPos = 0;
+
+    bs.Data       = m_base;
+    bs.DataOffset = 0;
+    bs.DataLength = 0;
+    bs.MaxLength  = 0;
+}
@@ -0,0 +1,73 @@
+/*############################################################################
+  # Copyright (C) Intel Corporation
+  #
+  # SPDX-License-Identifier: MIT
+  ############################################################################*/
+#ifndef TOOLS_CLI_VPL_BITSTREAM_MAP_H_
+#define TOOLS_CLI_VPL_BITSTREAM_MAP_H_
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "./vpl-preload-buffer.h"
+#include "vpl/mfxstructures.h"
+
+// Memory-mapped or preloaded input bitstream.
+// Read() points mfxBitstream.Data directly into the mapped file or the preload
+// buffer, so unlike the fread() path there is no copy of the unconsumed data
+// or of the file.
+// The decoder sees a window of at most windowSize bytes starting at the first
+// unconsumed byte, the same amount of data as with a buffer of that size.
+// With repeat the input is replayed repeat more times from memory, only a
+// window spanning the end and the start of the input is copied.
+// Only for elementary streams: IVF (AV1) input needs its frame headers stripped.
+class BitstreamMap {
+public:
+    BitstreamMap();
+    ~BitstreamMap();
+
+    // returns false if the file cannot be mapped (or mapping is not supported
+    //   on this platform), in which case the caller should read with fread()
+    bool Open(const char* fileName, mfxU32 windowSize, mfxU32 repeat);
+
+    // like Open(), but the whole file is read into memory up front, so no
+    //   file I/O or page faults are left for the decode loop
+    bool Preload(const char* fileName, mfxU32 windowSize, mfxU32 repeat);
+
+    void Close();
+
+    bool IsOpen() const {
+        return m_base != nullptr;
+    }
+
+    // advance bs past the data consumed by the decoder and expose the next window
+    // returns MFX_ERR_MORE_DATA at the end of the file
+    mfxStatus Read(mfxBitstream& bs);
+
+    // reset bs to the start of the file
+    void Rewind(mfxBitstream& bs);
+
+private:
+    BitstreamMap(const BitstreamMap&);
+    BitstreamMap& operator=(const BitstreamMap&);
+
+    bool Init(mfxU32 windowSize, mfxU32 repeat);
+
+    mfxU8* m_base;
+    size_t m_size;
+    mfxU32 m_windowSize;
+    mfxU32 m_repeat;
+    bool m_bMapped;
+
+    // current window and its offset in the input repeated m_repeat times
+    mfxU8* m_window;
+    mfxU64 m_windowPos;
+
+    // window spanning the end of the input and the start of its next repeat
+    std::vector<mfxU8> m_splice;
+
+    PreloadBuffer m_preload;
+};
+
+#endif // TOOLS_CLI_VPL_BITSTREAM_MAP_H_
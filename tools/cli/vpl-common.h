@@ -77,6 +77,12 @@ typedef struct _Params {
 
     bool verboseMode;
 
+    // read input bitstream from a memory-mapped file (decode tools)
+    bool mmapInput;
+
+    // load the input into memory once before processing, for I/O-free benchmark runs
+    bool preloadInput;
+
     mfxU32 srcFourCC;
     mfxU32 dstFourCC;
 
@@ -100,9 +106,18 @@ typedef struct _Params {
     mfxU32 keyFrameDist;
     mfxU32 qp;
 
+    // decode operations in flight before synchronizing
+    mfxU32 asyncDepth;
+
     // loop counter
     mfxU32 repeat;
 
+    // raw frames read ahead on a separate thread (encode/vpp tools)
+    mfxU32 readAhead;
+
+    // output frames written behind on a separate thread
+    mfxU32 writeBehind;
+
     // jpeg encoder specific
     mfxU32 quality;
 
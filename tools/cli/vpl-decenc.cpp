@@ -4,7 +4,9 @@
   # SPDX-License-Identifier: MIT
   ############################################################################*/
 
+#include "./vpl-bitstream-map.h"
 #include "./vpl-common.h"
+#include "./vpl-frame-writer.h"
 
 #define AV1_FOURCC             0x31305641
 #define MAX_LENGTH             260
@@ -24,6 +26,8 @@ typedef struct {
 AV1EncConfig* g_conf = NULL;
 mfxU32 repeatCount   = 0;
 bool g_read_streamheader;
+BitstreamMap g_bsMap;
+FrameWriter g_writer;
 
 mfxStatus ReadStreamInfo(mfxSession session, FILE* f, mfxBitstream* bs, mfxVideoParam* param);
 mfxStatus AllocateExternalMemorySurface(std::vector<mfxU8>* dec_buf,
@@ -33,14 +37,13 @@ mfxStatus AllocateExternalMemorySurface(std::vector<mfxU8>* dec_buf,
 mfxStatus ReadEncodedStream(mfxBitstream& bs, mfxU32 codecid, FILE* f, mfxU32 repeat);
 inline void mem_put_le16(void* vmem, mfxU32 val);
 inline void mem_put_le32(void* vmem, mfxU32 val);
-void WriteIVF_StreamHeader(const AV1EncConfig* conf, FILE* f);
-void WriteIVF_FrameHeader(mfxU32 byte_count, mfxU64 pts, FILE* f);
+void WriteIVF_StreamHeader(const AV1EncConfig* conf);
+void WriteIVF_FrameHeader(mfxU32 byte_count, mfxU64 pts);
 void WriteEncodedStream(mfxU32 nframe,
                         void* conf,
                         mfxU8* data,
                         mfxU32 length,
-                        mfxU32 codecID,
-                        FILE* f);
+                        mfxU32 codecID);
 mfxU32 GetSurfaceSize(mfxU32 FourCC, mfxU32 width, mfxU32 height);
 int GetFreeSurfaceIndex(mfxFrameSurface1* SurfacesPool, mfxU16 nPoolSize);
 char** ValidateInput(int cnt, char* in[]);
@@ -97,6 +100,14 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    // output frames are written through g_writer, see FrameWriter
+    if (!g_writer.Open(fSink, params.writeBehind)) {
+        fclose(fSource);
+        fclose(fSink);
+        printf("could not create output file, %s\n", params.outfileName);
+        return 1;
+    }
+
     mfxStatus sts      = MFX_ERR_NOT_INITIALIZED;
     mfxSession session = nullptr;
 
@@ -122,9 +133,27 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    // IVF input is always read with fread()
+    if (params.preloadInput) {
+        if (params.srcFourCC != MFX_CODEC_AV1 &&
+            g_bsMap.Preload(params.infileName, params.srcbsbufSize, params.repeat))
+            puts("input file preloaded");
+        else
+            puts("input file not preloaded, using file read");
+    }
+    else if (params.mmapInput) {
+        if (params.srcFourCC != MFX_CODEC_AV1 &&
+            g_bsMap.Open(params.infileName, params.srcbsbufSize, params.repeat))
+            puts("input file memory-mapped");
+        else
+            puts("input file not memory-mapped, using file read");
+    }
+
     std::vector<mfxU8> input_buffer;
-    input_buffer.resize(bs_dec_in.MaxLength);
-    bs_dec_in.Data = input_buffer.data();
+    if (!g_bsMap.IsOpen()) {
+        input_buffer.resize(bs_dec_in.MaxLength);
+        bs_dec_in.Data = input_buffer.data();
+    }
 
     // initialize decode parameters from stream header
     mfxVideoParam mfxDecParams = { 0 };
@@ -391,8 +420,7 @@ int main(int argc, char* argv[]) {
                                            g_conf,
                                            bs_enc_out.Data + bs_enc_out.DataOffset,
                                            bs_enc_out.DataLength,
-                                           params.dstFourCC,
-                                           fSink);
+                                           params.dstFourCC);
                     }
                     bs_enc_out.DataLength = 0;
                 }
@@ -421,6 +449,9 @@ int main(int argc, char* argv[]) {
         fSource = NULL;
     }
 
+    g_bsMap.Close();
+
+    g_writer.Close();
     if (fSink) {
         fclose(fSink);
         fSink = NULL;
@@ -697,6 +728,21 @@ bool ParseArgsAndValidate(int argc, char* argv[], Params* params) {
         else if (IS_ARG_EQ(s, "sbs")) {
             params->srcbsbufSize = atoi(argv[idx++]);
         }
+        else if (IS_ARG_EQ(s, "mmap")) {
+            params->mmapInput = true;
+        }
+        else if (IS_ARG_EQ(s, "preload")) {
+            params->preloadInput = true;
+        }
+        else if (IS_ARG_EQ(s, "wb")) {
+            if (atoi(argv[idx]) < 0 || atoi(argv[idx]) > MAX_WRITE_BEHIND_FRAMES) {
+                printf("ERROR - invalid argument: value for -wb switch must be 0 to %d\n",
+                       MAX_WRITE_BEHIND_FRAMES);
+                return false;
+            }
+
+            params->writeBehind = atoi(argv[idx++]);
+        }
         else if (IS_ARG_EQ(s, "dbs")) {
             params->dstbsbufSize = atoi(argv[idx++]);
         }
@@ -770,6 +816,9 @@ void Usage(void) {
     printf("  -n      maxFrames     ... max frames to process\n");
     printf("  -rp     repeat        ... number of times to repeat encoding\n");
     printf("  -sbs    bsbufSize     ... source bitstream buffer size (bytes)\n");
+    printf("  -mmap                 ... memory-map input file instead of reading it (Linux)\n");
+    printf("  -preload              ... load input file into memory once before decoding\n");
+    printf("  -wb     writeBehind   ... output frames queued for a writer thread (default 0)\n");
 
     printf("  -if     inputFormat   ... [h264, h265, av1, jpeg]\n");
     printf("  -of     outputFormat  ... [h264, h265, av1, jpeg]\n");
@@ -971,7 +1020,7 @@ inline void mem_put_le32(void* vmem, mfxU32 val) {
     mem[3] = (mfxU8)((val >> 24) & 0xff);
 }
 
-void WriteIVF_StreamHeader(const AV1EncConfig* conf, FILE* f) {
+void WriteIVF_StreamHeader(const AV1EncConfig* conf) {
     char header[32] = { 0 };
 
     header[0] = 'D';
@@ -989,39 +1038,44 @@ void WriteIVF_StreamHeader(const AV1EncConfig* conf, FILE* f) {
     mem_put_le32(header + 24, 0); // length
     mem_put_le32(header + 28, 0); // unused
 
-    fwrite(header, 1, 32, f);
+    g_writer.Append(header, 32);
     return;
 }
 
-void WriteIVF_FrameHeader(mfxU32 byte_count, mfxU64 pts, FILE* f) {
+void WriteIVF_FrameHeader(mfxU32 byte_count, mfxU64 pts) {
     char header[12] = { 0 };
 
     mem_put_le32(header, (mfxU32)byte_count);
     mem_put_le32(header + 4, (mfxU32)(pts & 0xFFFFFFFF));
     mem_put_le32(header + 8, (mfxU32)(pts >> 32));
 
-    fwrite(header, 1, 12, f);
+    g_writer.Append(header, 12);
 }
 
 void WriteEncodedStream(mfxU32 nframe,
                         void* conf,
                         mfxU8* data,
                         mfxU32 length,
-                        mfxU32 codecID,
-                        FILE* f) {
+                        mfxU32 codecID) {
+    // headers and data go to one buffer, written to disk with a single write
     if (codecID == MFX_CODEC_AV1) {
         if (nframe == 1) {
-            WriteIVF_StreamHeader(reinterpret_cast<AV1EncConfig*>(conf), f);
+            WriteIVF_StreamHeader(reinterpret_cast<AV1EncConfig*>(conf));
         }
-        WriteIVF_FrameHeader(length, nframe - 1, f); // pts starts from 0
-        fwrite(data, 1, length, f);
+        WriteIVF_FrameHeader(length, nframe - 1); // pts starts from 0
+        g_writer.Append(data, length);
     }
     else {
-        fwrite(data, 1, length, f);
+        g_writer.Append(data, length);
     }
+    g_writer.Commit();
 }
 
 mfxStatus ReadEncodedStream(mfxBitstream& bs, mfxU32 codecid, FILE* f, mfxU32 repeat) {
+    // memory-mapped input, bs is moved forward in the mapping without copying
+    if (g_bsMap.IsOpen())
+        return g_bsMap.Read(bs);
+
     memmove(bs.Data, bs.Data + bs.DataOffset, bs.DataLength);
     bs.DataOffset = 0;
 
@@ -1108,7 +1162,10 @@ mfxStatus ReadStreamInfo(mfxSession session, FILE* f, mfxBitstream* bs, mfxVideo
     }
     else {
         bs->DataLength = 0;
-        rewind(f);
+        if (g_bsMap.IsOpen())
+            g_bsMap.Rewind(*bs);
+        else
+            rewind(f);
         if (param->mfx.CodecId == MFX_CODEC_AV1)
             g_read_streamheader = false;
     }
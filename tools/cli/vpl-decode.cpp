@@ -5,7 +5,9 @@
   ############################################################################*/
 
 #include <string>
+#include "./vpl-bitstream-map.h"
 #include "./vpl-common.h"
+#include "./vpl-frame-writer.h"
 
 #include "vpl/mfxvideo.h"
 
@@ -14,16 +16,25 @@
 #define MAX_HEIGHT             2160
 #define MAX_BS_BUFFER_SIZE     64 * 1024 * 1024
 #define DEFAULT_BS_BUFFER_SIZE 2 * 1024 * 1024
+#define MAX_ASYNC_DEPTH        64
 
 #define IS_ARG_EQ(a, b) (!strcmp((a), (b)))
 mfxU32 repeatCount = 0;
+BitstreamMap g_bsMap;
+FrameWriter g_writer;
+
+// decoded frame which is not synchronized and written yet
+typedef struct {
+    mfxSyncPoint syncp;
+    mfxFrameSurface1* surface;
+} PendingFrame;
 
 mfxStatus AllocateExternalMemorySurface(std::vector<mfxU8>* dec_buf,
                                         mfxFrameSurface1* surfpool,
                                         mfxFrameInfo* frame_info,
                                         mfxU16 surfnum);
 mfxStatus ReadEncodedStream(mfxBitstream& bs, mfxU32 codecid, FILE* f, mfxU32 repeat);
-void WriteRawFrame(mfxFrameSurface1* pSurface, FILE* f);
+void WriteRawFrame(mfxFrameSurface1* pSurface);
 mfxU32 GetSurfaceSize(mfxU32 FourCC, mfxU32 width, mfxU32 height);
 int GetFreeSurfaceIndex(mfxFrameSurface1* SurfacesPool, mfxU16 nPoolSize);
 char** ValidateInput(int cnt, char* in[]);
@@ -81,6 +92,14 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    // output frames are written through g_writer, see FrameWriter
+    if (!g_writer.Open(fSink, params.writeBehind)) {
+        fclose(fSource);
+        fclose(fSink);
+        printf("could not create output file, %s\n", params.outfileName);
+        return 1;
+    }
+
     on_complete = cb_OnComplete;
 
     mfxStatus sts      = MFX_ERR_NOT_INITIALIZED;
@@ -118,9 +137,27 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    // IVF input is always read with fread()
+    if (params.preloadInput) {
+        if (params.srcFourCC != MFX_CODEC_AV1 &&
+            g_bsMap.Preload(params.infileName, params.srcbsbufSize, params.repeat))
+            puts("input file preloaded");
+        else
+            puts("input file not preloaded, using file read");
+    }
+    else if (params.mmapInput) {
+        if (params.srcFourCC != MFX_CODEC_AV1 &&
+            g_bsMap.Open(params.infileName, params.srcbsbufSize, params.repeat))
+            puts("input file memory-mapped");
+        else
+            puts("input file not memory-mapped, using file read");
+    }
+
     std::vector<mfxU8> input_buffer;
-    input_buffer.resize(mfxBS.MaxLength);
-    mfxBS.Data = input_buffer.data();
+    if (!g_bsMap.IsOpen()) {
+        input_buffer.resize(mfxBS.MaxLength);
+        mfxBS.Data = input_buffer.data();
+    }
 
     ReadEncodedStream(mfxBS, params.srcFourCC, fSource, params.repeat);
 
@@ -198,7 +235,8 @@ int main(int argc, char* argv[]) {
         }
 
         // input parameters finished, now initialize decode
-        sts = MFXVideoDECODE_Init(session, &mfxDecParams);
+        mfxDecParams.AsyncDepth = static_cast<mfxU16>(params.asyncDepth);
+        sts                     = MFXVideoDECODE_Init(session, &mfxDecParams);
         if (sts != MFX_ERR_NONE) {
             fclose(fSource);
             fclose(fSink);
@@ -220,7 +258,8 @@ int main(int argc, char* argv[]) {
         MFXVideoDECODE_QueryIOSurf(session, &mfxDecParams, &DecRequest);
 
         // Determine the required number of surfaces for decoder output
-        nSurfNumDec = DecRequest.NumFrameSuggested;
+        // plus the surfaces of frames waiting to be written, see asyncDepth
+        nSurfNumDec = DecRequest.NumFrameSuggested + static_cast<mfxU16>(params.asyncDepth - 1);
 
         decSurfaces = new mfxFrameSurface1[nSurfNumDec];
         sts         = AllocateExternalMemorySurface(&DECoutbuf,
@@ -247,13 +286,92 @@ int main(int argc, char* argv[]) {
     mfxFrameSurface1* pmfxWorkSurface = nullptr;
     mfxFrameSurface1* pmfxOutSurface  = nullptr;
 
+    // ring of decoded frames which are not synchronized yet
+    // up to asyncDepth frames are submitted before the oldest one is synchronized and written
+    std::vector<PendingFrame> pendingFrames(params.asyncDepth);
+    mfxU32 pendingHead  = 0;
+    mfxU32 pendingCount = 0;
+    int submitnum       = 0;
+
+    auto WriteOldestFrame = [&]() {
+        PendingFrame& pending = pendingFrames[pendingHead];
+
+        // data available to app only after sync
+        auto t0 = std::chrono::high_resolution_clock::now();
+        MFXVideoCORE_SyncOperation(session, pending.syncp, 60000);
+        auto t1 = std::chrono::high_resolution_clock::now();
+        sync_time += std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
+
+        mfxFrameSurface1* pSurface = pending.surface;
+
+        if (params.memoryMode == MEM_MODE_INTERNAL || params.memoryMode == MEM_MODE_AUTO) {
+            pSurface->FrameInterface->Map(pSurface, MFX_MAP_READ);
+        }
+
+        // write output if output file specified
+        if (fSink) {
+            // this is only for mult-res stream test case
+            if (params.outWidth != 0 && params.outHeight != 0) {
+                if (pSurface->Info.Width == params.outWidth &&
+                    pSurface->Info.Height == params.outHeight) {
+                    WriteRawFrame(pSurface);
+                }
+            }
+            else {
+                WriteRawFrame(pSurface);
+            }
+        }
+
+        if (params.memoryMode == MEM_MODE_INTERNAL || params.memoryMode == MEM_MODE_AUTO) {
+            pSurface->FrameInterface->Unmap(pSurface);
+            pSurface->FrameInterface->Release(pSurface);
+        }
+
+        pending     = { 0 };
+        pendingHead = (pendingHead + 1) % params.asyncDepth;
+        pendingCount--;
+
+        framenum++;
+    };
+
+    // external memory: free surface which is neither locked by decode nor waiting to be written
+    //   if there is none, write the oldest pending frame to release its surface
+    auto GetFreeWorkSurfaceIndex = [&]() {
+        for (;;) {
+            for (mfxU16 i = 0; i < nSurfNumDec; i++) {
+                if (decSurfaces[i].Data.Locked)
+                    continue;
+
+                bool bPending = false;
+                for (mfxU32 j = 0; j < pendingCount; j++) {
+                    if (pendingFrames[(pendingHead + j) % params.asyncDepth].surface ==
+                        &decSurfaces[i])
+                        bPending = true;
+                }
+
+                if (!bPending)
+                    return (int)i;
+            }
+
+            if (pendingCount == 0)
+                break;
+
+            WriteOldestFrame();
+        }
+
+        printf("Error - no free decode surface\n");
+        exit(1);
+        return (int)MFX_ERR_NOT_FOUND;
+    };
+
     puts("start decoding");
+    auto start      = std::chrono::high_resolution_clock::now();
     bool isdraining = false;
     for (;;) {
         bool stillgoing = true;
 
         if (params.memoryMode == MEM_MODE_EXTERNAL) {
-            nIndex = GetFreeSurfaceIndex(decSurfaces, nSurfNumDec);
+            nIndex = GetFreeWorkSurfaceIndex();
         }
 
         pmfxWorkSurface = nullptr;
@@ -303,7 +421,7 @@ int main(int argc, char* argv[]) {
                     break;
                 case MFX_ERR_MORE_SURFACE: // feed a fresh surface to decode
                     if (params.memoryMode == MEM_MODE_EXTERNAL) {
-                        nIndex = GetFreeSurfaceIndex(decSurfaces, nSurfNumDec);
+                        nIndex = GetFreeWorkSurfaceIndex();
                     }
                     else {
                         printf(
@@ -313,6 +431,10 @@ int main(int argc, char* argv[]) {
                     break;
                 case MFX_ERR_INCOMPATIBLE_VIDEO_PARAM:
                     if (params.memoryMode == MEM_MODE_EXTERNAL) {
+                        // pending frames are in the surfaces which are about to be reallocated
+                        while (pendingCount)
+                            WriteOldestFrame();
+
                         MFXVideoDECODE_GetVideoParam(session, &mfxDecParams);
                         sts = AllocateExternalMemorySurface(&DECoutbuf,
                                                             decSurfaces,
@@ -329,7 +451,7 @@ int main(int argc, char* argv[]) {
                             return sts;
                         }
 
-                        nIndex          = GetFreeSurfaceIndex(decSurfaces, nSurfNumDec);
+                        nIndex          = GetFreeWorkSurfaceIndex();
                         pmfxWorkSurface = &decSurfaces[nIndex];
 
                         sts = MFXVideoDECODE_DecodeFrameAsync(session,
@@ -362,7 +484,7 @@ int main(int argc, char* argv[]) {
             break;
 
         if (params.verboseMode) {
-            if (framenum == 0) {
+            if (submitnum == 0) {
                 mfxVideoParam tmpParams = { 0 };
 
                 //Show settable parameters
@@ -389,39 +511,25 @@ int main(int argc, char* argv[]) {
             puts("-----------------------");
         }
 
-        // data available to app only after sync
-        auto t0 = std::chrono::high_resolution_clock::now();
-        MFXVideoCORE_SyncOperation(session, syncp, 60000);
-        auto t1 = std::chrono::high_resolution_clock::now();
-        sync_time += std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
+        // keep the frame in flight, synchronize the oldest one once asyncDepth frames are pending
+        pendingFrames[(pendingHead + pendingCount) % params.asyncDepth] = { syncp, pmfxOutSurface };
+        pendingCount++;
+        submitnum++;
 
-        if (params.memoryMode == MEM_MODE_INTERNAL || params.memoryMode == MEM_MODE_AUTO) {
-            pmfxOutSurface->FrameInterface->Map(pmfxOutSurface, MFX_MAP_READ);
-        }
+        if (params.maxFrames && submitnum >= static_cast<int>(params.maxFrames))
+            break;
 
-        // write output if output file specified
-        if (fSink) {
-            // this is only for mult-res stream test case
-            if (params.outWidth != 0 && params.outHeight != 0) {
-                if (pmfxOutSurface->Info.Width == params.outWidth &&
-                    pmfxOutSurface->Info.Height == params.outHeight) {
-                    WriteRawFrame(pmfxOutSurface, fSink);
-                }
-            }
-            else {
-                WriteRawFrame(pmfxOutSurface, fSink);
-            }
-        }
+        if (pendingCount == params.asyncDepth)
+            WriteOldestFrame();
+    }
 
-        if (params.memoryMode == MEM_MODE_INTERNAL || params.memoryMode == MEM_MODE_AUTO) {
-            pmfxOutSurface->FrameInterface->Unmap(pmfxOutSurface);
-            pmfxOutSurface->FrameInterface->Release(pmfxOutSurface);
-        }
+    // write the frames still in flight
+    while (pendingCount)
+        WriteOldestFrame();
 
-        framenum++;
-        if (params.maxFrames && framenum >= static_cast<int>(params.maxFrames))
-            break;
-    }
+    auto end = std::chrono::high_resolution_clock::now();
+    double total_time =
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
 
     printf("read %d frames\n", framenum);
     if (framenum) {
@@ -429,6 +537,14 @@ int main(int argc, char* argv[]) {
                decode_time / framenum,
                sync_time / framenum);
     }
+    if (total_time > 0) {
+        printf("async depth %u, %f sec, %f fps\n",
+               params.asyncDepth,
+               total_time,
+               framenum / total_time);
+    }
+
+    g_writer.Close();
 
     if (fSink) {
         fclose(fSink);
@@ -437,6 +553,8 @@ int main(int argc, char* argv[]) {
         fclose(fSource);
     }
 
+    g_bsMap.Close();
+
     if (params.memoryMode == MEM_MODE_EXTERNAL) {
         if (decSurfaces) {
             delete[] decSurfaces;
@@ -512,6 +630,10 @@ int GetFreeSurfaceIndex(mfxFrameSurface1* SurfacesPool, mfxU16 nPoolSize) {
 }
 
 mfxStatus ReadEncodedStream(mfxBitstream& bs, mfxU32 codecid, FILE* f, mfxU32 repeat) {
+    // memory-mapped input, bs is moved forward in the mapping without copying
+    if (g_bsMap.IsOpen())
+        return g_bsMap.Read(bs);
+
     memmove(bs.Data, bs.Data + bs.DataOffset, bs.DataLength);
     bs.DataOffset = 0;
 
@@ -583,7 +705,7 @@ mfxStatus ReadEncodedStream(mfxBitstream& bs, mfxU32 codecid, FILE* f, mfxU32 re
     return MFX_ERR_NONE;
 }
 
-void WriteRawFrame(mfxFrameSurface1* pSurface, FILE* f) {
+void WriteRawFrame(mfxFrameSurface1* pSurface) {
     mfxU16 w, h, i, pitch;
     mfxFrameInfo* pInfo = &pSurface->Info;
     mfxFrameData* pData = &pSurface->Data;
@@ -591,18 +713,18 @@ void WriteRawFrame(mfxFrameSurface1* pSurface, FILE* f) {
     w = pInfo->CropW;
     h = pInfo->CropH;
 
-    // write the output to disk
+    // copy the output rows to one buffer, written to disk with a single write
     switch (pInfo->FourCC) {
         case MFX_FOURCC_NV12:
             //Y
             pitch = pData->Pitch;
             for (i = 0; i < h; i++) {
-                fwrite(pData->Y + i * pitch, 1, w, f);
+                g_writer.Append(pData->Y + i * pitch, w);
             }
 
             //UV
             for (i = 0; i < h / 2; i++) {
-                fwrite(pData->UV + i * pitch, 1, w, f);
+                g_writer.Append(pData->UV + i * pitch, w);
             }
 
             break;
@@ -610,7 +732,7 @@ void WriteRawFrame(mfxFrameSurface1* pSurface, FILE* f) {
             //Y
             pitch = pData->Pitch;
             for (i = 0; i < h; i++) {
-                fwrite(pData->Y + i * pitch, 1, w, f);
+                g_writer.Append(pData->Y + i * pitch, w);
             }
 
             //U
@@ -618,11 +740,11 @@ void WriteRawFrame(mfxFrameSurface1* pSurface, FILE* f) {
             h /= 2;
             w /= 2;
             for (i = 0; i < h; i++) {
-                fwrite(pData->U + i * pitch, 1, w, f);
+                g_writer.Append(pData->U + i * pitch, w);
             }
             //V
             for (i = 0; i < h; i++) {
-                fwrite(pData->V + i * pitch, 1, w, f);
+                g_writer.Append(pData->V + i * pitch, w);
             }
             break;
 
@@ -631,12 +753,12 @@ void WriteRawFrame(mfxFrameSurface1* pSurface, FILE* f) {
             pitch = pData->Pitch;
             w *= 2;
             for (i = 0; i < h; i++) {
-                fwrite(pData->Y + i * pitch, 1, w, f);
+                g_writer.Append(pData->Y + i * pitch, w);
             }
 
             //UV
             for (i = 0; i < h / 2; i++) {
-                fwrite(pData->UV + i * pitch, 1, w, f);
+                g_writer.Append(pData->UV + i * pitch, w);
             }
             break;
 
@@ -645,7 +767,7 @@ void WriteRawFrame(mfxFrameSurface1* pSurface, FILE* f) {
             pitch = pData->Pitch;
             w *= 2;
             for (i = 0; i < h; i++) {
-                fwrite(pSurface->Data.Y + i * pitch, 1, w, f);
+                g_writer.Append(pSurface->Data.Y + i * pitch, w);
             }
 
             //U
@@ -653,17 +775,18 @@ void WriteRawFrame(mfxFrameSurface1* pSurface, FILE* f) {
             w /= 2;
             h /= 2;
             for (i = 0; i < h; i++) {
-                fwrite(pSurface->Data.U + i * pitch, 1, w, f);
+                g_writer.Append(pSurface->Data.U + i * pitch, w);
             }
             //V
             for (i = 0; i < h; i++) {
-                fwrite(pSurface->Data.V + i * pitch, 1, w, f);
+                g_writer.Append(pSurface->Data.V + i * pitch, w);
             }
             break;
         default:
             break;
     }
 
+    g_writer.Commit();
     return;
 }
 
@@ -794,6 +917,7 @@ bool ParseArgsAndValidate(int argc, char* argv[], Params* params) {
     params->dispatcherMode = DISPATCHER_MODE_LEGACY;
     params->impl           = MFX_IMPL_SOFTWARE;
     params->filmGrain      = -1; // auto
+    params->asyncDepth     = 1;
 
     if (argc < 2)
         return false;
@@ -860,6 +984,30 @@ bool ParseArgsAndValidate(int argc, char* argv[], Params* params) {
         else if (IS_ARG_EQ(s, "sbs")) {
             params->srcbsbufSize = atoi(argv[idx++]);
         }
+        else if (IS_ARG_EQ(s, "mmap")) {
+            params->mmapInput = true;
+        }
+        else if (IS_ARG_EQ(s, "preload")) {
+            params->preloadInput = true;
+        }
+        else if (IS_ARG_EQ(s, "async")) {
+            if (atoi(argv[idx]) < 1 || atoi(argv[idx]) > MAX_ASYNC_DEPTH) {
+                printf("ERROR - invalid argument: value for -async switch must be 1 to %d\n",
+                       MAX_ASYNC_DEPTH);
+                return false;
+            }
+
+            params->asyncDepth = atoi(argv[idx++]);
+        }
+        else if (IS_ARG_EQ(s, "wb")) {
+            if (atoi(argv[idx]) < 0 || atoi(argv[idx]) > MAX_WRITE_BEHIND_FRAMES) {
+                printf("ERROR - invalid argument: value for -wb switch must be 0 to %d\n",
+                       MAX_WRITE_BEHIND_FRAMES);
+                return false;
+            }
+
+            params->writeBehind = atoi(argv[idx++]);
+        }
         else if (IS_ARG_EQ(s, "dbs")) {
             params->dstbsbufSize = atoi(argv[idx++]);
         }
@@ -976,6 +1124,10 @@ void Usage(void) {
     printf("  -if    inputFormat   ... [h264, h265, av1, jpeg]\n");
     printf("  -rp    repeat        ... number of times to repeat decoding\n");
     printf("  -sbs   bsbufSize     ... source bitstream buffer size (bytes)\n");
+    printf("  -mmap                ... memory-map input file instead of reading it (Linux)\n");
+    printf("  -preload             ... load input file into memory once before decoding\n");
+    printf("  -async asyncDepth    ... number of decode operations in flight (default 1)\n");
+    printf("  -wb    writeBehind   ... output frames queued for a writer thread (default 0)\n");
     printf("  -v     verbose       ... verbose output for debug\n");
     printf("  -fg    filmgrain     ... film-grain denoise (0: disable, 1: enable)\n");
     printf("\nMemory model (default = -ext)\n");
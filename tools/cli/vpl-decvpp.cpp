@@ -18,6 +18,8 @@
 #include "vpl/mfxjpeg.h"
 #include "vpl/mfxvideo.h"
 
+#include "./vpl-bitstream-map.h"
+
 #define MAX_PATH   260
 #define MAX_WIDTH  3840
 #define MAX_HEIGHT 2160
@@ -44,6 +46,7 @@ typedef struct {
 AV1EncConfig *g_conf = NULL;
 mfxU32 repeatCount   = 0;
 bool g_read_streamheader;
+BitstreamMap g_bsMap;
 
 mfxStatus ReadStreamInfo(mfxSession session, FILE *f, mfxBitstream *bs, mfxVideoParam *param);
 mfxStatus ReadEncodedStream(mfxBitstream &bs, mfxU32 codecid, FILE *f, mfxU32 repeat);
@@ -61,7 +64,8 @@ void Usage(char *arguments[]) {
     //std::string someString(charString);
     printf("\n");
     printf(
-        "   Usage  :  vpl-decvpp.exe InputFile OutputFile InputFormat OutputFormat OutputWidth OutputHeight \n\n");
+        "   Usage  :  vpl-decvpp.exe InputFile OutputFile InputFormat OutputFormat OutputWidth OutputHeight [-mmap]\n\n");
+    printf("   -mmap  :  memory-map InputFile instead of reading it (Linux)\n\n");
     printf("   Example:  vpl-decvpp.exe cars_128x96.h265 out_300x300.i420 h265 i420 300 300\n");
     printf(
         "   To view:  ffplay -video_size [OutputWidth]x[OutputHeight] -pixel_format [pixel format] -f rawvideo [OutputFile]\n\n");
@@ -69,7 +73,8 @@ void Usage(char *arguments[]) {
 }
 
 int main(int argc, char *argv[]) {
-    if (argc != 7) {
+    bool mmap_input = (argc == 8 && !strcmp(argv[7], "-mmap"));
+    if (argc != 7 && !mmap_input) {
         Usage(argv);
         return 1;
     }
@@ -167,10 +172,21 @@ int main(int argc, char *argv[]) {
     VERIFY(MFX_ERR_NONE == sts, "Not able to create VPL session supporting decode+VPP");
 
     // Prepare input bitstream and start decoding
-    bitstream.MaxLength = BITSTREAM_BUFFER_SIZE;
-    bitstream.Data      = reinterpret_cast<mfxU8 *>(malloc(bitstream.MaxLength * sizeof(mfxU8)));
-    VERIFY(bitstream.Data, "Not able to allocate input buffer");
-    memset(bitstream.Data, 0, bitstream.MaxLength * sizeof(mfxU8));
+    // IVF input is always read with fread()
+    if (mmap_input) {
+        if (GetCodecId(in_codec) != MFX_CODEC_AV1 &&
+            g_bsMap.Open(in_filename, BITSTREAM_BUFFER_SIZE, 0))
+            puts("Input file memory-mapped");
+        else
+            puts("Input file not memory-mapped, using file read");
+    }
+
+    if (!g_bsMap.IsOpen()) {
+        bitstream.MaxLength = BITSTREAM_BUFFER_SIZE;
+        bitstream.Data      = reinterpret_cast<mfxU8 *>(malloc(bitstream.MaxLength * sizeof(mfxU8)));
+        VERIFY(bitstream.Data, "Not able to allocate input buffer");
+        memset(bitstream.Data, 0, bitstream.MaxLength * sizeof(mfxU8));
+    }
     bitstream.CodecId = GetCodecId(in_codec);
 
     mfxVideoParam mfxDecParams;
@@ -342,7 +358,10 @@ end:
     if (loader)
         MFXUnload(loader);
 
-    if (bitstream.Data)
+    // bitstream.Data points into the mapping if the input file is memory-mapped
+    if (g_bsMap.IsOpen())
+        g_bsMap.Close();
+    else if (bitstream.Data)
         free(bitstream.Data);
 
     if (vpp_surfaces_out) {
@@ -555,6 +574,10 @@ bool ValidateSize(char *in, mfxU16 *vsize, mfxU32 vmax) {
 }
 
 mfxStatus ReadEncodedStream(mfxBitstream &bs, mfxU32 codecid, FILE *f, mfxU32 repeat) {
+    // memory-mapped input, bs is moved forward in the mapping without copying
+    if (g_bsMap.IsOpen())
+        return g_bsMap.Read(bs);
+
     memmove(bs.Data, bs.Data + bs.DataOffset, bs.DataLength);
     bs.DataOffset = 0;
 
@@ -643,7 +666,10 @@ mfxStatus ReadStreamInfo(mfxSession session, FILE *f, mfxBitstream *bs, mfxVideo
     }
     else {
         bs->DataLength = 0;
-        rewind(f);
+        if (g_bsMap.IsOpen())
+            g_bsMap.Rewind(*bs);
+        else
+            rewind(f);
         if (param->mfx.CodecId == MFX_CODEC_AV1)
             g_read_streamheader = false;
     }
@@ -6,6 +6,8 @@
 
 #include <string>
 #include "./vpl-common.h"
+#include "./vpl-frame-writer.h"
+#include "./vpl-raw-frame-reader.h"
 
 #include "vpl/mfxvideo.h"
 
@@ -27,19 +29,20 @@ typedef struct {
 
 AV1EncConfig* g_conf = NULL;
 mfxU32 repeatCount   = 0;
+RawFrameReader g_frameReader;
+FrameWriter g_writer;
 
 inline void mem_put_le16(void* vmem, mfxU32 val);
 inline void mem_put_le32(void* vmem, mfxU32 val);
-void WriteIVF_StreamHeader(const AV1EncConfig* conf, FILE* f);
-void WriteIVF_FrameHeader(mfxU32 byte_count, mfxU64 pts, FILE* f);
+void WriteIVF_StreamHeader(const AV1EncConfig* conf);
+void WriteIVF_FrameHeader(mfxU32 byte_count, mfxU64 pts);
 void WriteEncodedStream(mfxU32 nframe,
                         void* conf,
                         mfxU8* data,
                         mfxU32 length,
-                        mfxU32 codecID,
-                        FILE* f);
+                        mfxU32 codecID);
 void UpdateTotalNumberFrameInfo(FILE* f, mfxU32 total_frames);
-mfxStatus LoadRawFrame(mfxFrameSurface1* pSurface, FILE* fSource, mfxU32 repeat);
+mfxStatus LoadRawFrame(mfxFrameSurface1* pSurface);
 mfxStatus LoadRawFrame2(mfxFrameSurface1* pSurface,
                         FILE* f,
                         int bytes_to_read,
@@ -95,6 +98,14 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    // output frames are written through g_writer, see FrameWriter
+    if (!g_writer.Open(fSink, params.writeBehind)) {
+        fclose(fSource);
+        fclose(fSink);
+        printf("could not create output file, %s\n", params.outfileName);
+        return 1;
+    }
+
     mfxStatus sts      = MFX_ERR_NOT_INITIALIZED;
     mfxSession session = nullptr;
 
@@ -139,7 +150,8 @@ int main(int argc, char* argv[]) {
         g_conf = NULL;
     }
 
-    mfxU32 frame_size = GetSurfaceSize(params.srcFourCC, params.srcHeight, params.srcWidth);
+    // frames in the file have the cropped size, LoadRawFrame() copies CropW x CropH
+    mfxU32 frame_size = GetSurfaceSize(params.srcFourCC, params.srcCropW, params.srcCropH);
 
     mfxU8* buf_read = NULL;
 
@@ -147,6 +159,26 @@ int main(int argc, char* argv[]) {
         buf_read = reinterpret_cast<mfxU8*>(malloc(frame_size));
     }
 
+    // pitch mode reads whole frames, see RawFrameReader
+    if (!b_read_frame) {
+        bool bOpened = false;
+        if (params.preloadInput)
+            bOpened = g_frameReader.Preload(params.infileName,
+                                            frame_size,
+                                            params.repeat,
+                                            params.maxFrames);
+        else
+            bOpened =
+                g_frameReader.Open(params.infileName, frame_size, params.repeat, params.readAhead);
+
+        if (!bOpened) {
+            fclose(fSource);
+            fclose(fSink);
+            puts("Error opening input file for frame read.");
+            return 1;
+        }
+    }
+
     std::vector<mfxFrameSurface1> pEncSurfaces;
     std::vector<mfxU8> surfaceBuffersData;
     mfxU16 nEncSurfNum = 0;
@@ -312,7 +344,7 @@ int main(int argc, char* argv[]) {
                                         params.repeat);
                 }
                 else {
-                    sts = LoadRawFrame(pmfxWorkSurface, fSource, params.repeat);
+                    sts = LoadRawFrame(pmfxWorkSurface);
                 }
             }
             else {
@@ -375,8 +407,7 @@ int main(int argc, char* argv[]) {
                                    g_conf,
                                    mfxBS.Data + mfxBS.DataOffset,
                                    mfxBS.DataLength,
-                                   params.dstFourCC,
-                                   fSink);
+                                   params.dstFourCC);
             }
             mfxBS.DataLength = 0;
         }
@@ -386,6 +417,9 @@ int main(int argc, char* argv[]) {
     loop_time =
         static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count());
 
+    // the frame count is patched through fSink, after all frames are written
+    g_writer.Close();
+
     if (params.dstFourCC == MFX_CODEC_AV1) {
         UpdateTotalNumberFrameInfo(fSink, framenum);
     }
@@ -412,6 +446,8 @@ int main(int argc, char* argv[]) {
         printf("fps avg=%.1f\n", (1.0e6 / loop_time) * framenum);
     }
 
+    g_frameReader.Close();
+
     if (buf_read)
         free(buf_read);
 
@@ -434,7 +470,7 @@ inline void mem_put_le32(void* vmem, mfxU32 val) {
     mem[3] = (mfxU8)((val >> 24) & 0xff);
 }
 
-void WriteIVF_StreamHeader(const AV1EncConfig* conf, FILE* f) {
+void WriteIVF_StreamHeader(const AV1EncConfig* conf) {
     char header[32] = { 0 };
 
     header[0] = 'D';
@@ -452,36 +488,37 @@ void WriteIVF_StreamHeader(const AV1EncConfig* conf, FILE* f) {
     mem_put_le32(header + 24, 0); // length
     mem_put_le32(header + 28, 0); // unused
 
-    fwrite(header, 1, 32, f);
+    g_writer.Append(header, 32);
     return;
 }
 
-void WriteIVF_FrameHeader(mfxU32 byte_count, mfxU64 pts, FILE* f) {
+void WriteIVF_FrameHeader(mfxU32 byte_count, mfxU64 pts) {
     char header[12] = { 0 };
 
     mem_put_le32(header, (mfxU32)byte_count);
     mem_put_le32(header + 4, (mfxU32)(pts & 0xFFFFFFFF));
     mem_put_le32(header + 8, (mfxU32)(pts >> 32));
 
-    fwrite(header, 1, 12, f);
+    g_writer.Append(header, 12);
 }
 
 void WriteEncodedStream(mfxU32 nframe,
                         void* conf,
                         mfxU8* data,
                         mfxU32 length,
-                        mfxU32 codecID,
-                        FILE* f) {
+                        mfxU32 codecID) {
+    // headers and data go to one buffer, written to disk with a single write
     if (codecID == MFX_CODEC_AV1) {
         if (nframe == 1) {
-            WriteIVF_StreamHeader(reinterpret_cast<AV1EncConfig*>(conf), f);
+            WriteIVF_StreamHeader(reinterpret_cast<AV1EncConfig*>(conf));
         }
-        WriteIVF_FrameHeader(length, nframe - 1, f); // pts starts from 0
-        fwrite(data, 1, length, f);
+        WriteIVF_FrameHeader(length, nframe - 1); // pts starts from 0
+        g_writer.Append(data, length);
     }
     else {
-        fwrite(data, 1, length, f);
+        g_writer.Append(data, length);
     }
+    g_writer.Commit();
 }
 
 void UpdateTotalNumberFrameInfo(FILE* f, mfxU32 total_frames) {
@@ -547,199 +584,46 @@ mfxStatus LoadRawFrame2(mfxFrameSurface1* pSurface,
     return MFX_ERR_NONE;
 }
 
-mfxStatus LoadRawFrame(mfxFrameSurface1* pSurface, FILE* f, mfxU32 repeat) {
-    mfxU16 w, h, i, pitch;
-    mfxU32 nBytesRead;
-    mfxU8* ptr;
+mfxStatus LoadRawFrame(mfxFrameSurface1* pSurface) {
+    RawFramePlane planes[3];
+    mfxU32 numPlanes    = 0;
     mfxFrameInfo* pInfo = &pSurface->Info;
     mfxFrameData* pData = &pSurface->Data;
+    mfxU32 pitch        = pData->Pitch;
+    mfxU32 w            = pInfo->CropW;
+    mfxU32 h            = pInfo->CropH;
 
-    w = pInfo->CropW;
-    h = pInfo->CropH;
-
+    // planes in the order in which they are stored in the file
     switch (pInfo->FourCC) {
         case MFX_FOURCC_NV12:
-            // read luminance plane (Y)
-            pitch = pData->Pitch;
-            ptr   = pData->Y;
-            for (i = 0; i < h; i++) {
-                nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, f);
-                if (w != nBytesRead) {
-                    if (repeatCount == repeat)
-                        return MFX_ERR_MORE_DATA;
-                    else {
-                        fseek(f, 0, SEEK_SET);
-                        repeatCount++;
-                    }
-                }
-            }
-
-            // read chrominance (U, V)
-            h /= 2;
-            ptr = pData->UV;
-            for (i = 0; i < h; i++) {
-                nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, f);
-                if (w != nBytesRead) {
-                    if (repeatCount == repeat)
-                        return MFX_ERR_MORE_DATA;
-                    else {
-                        fseek(f, 0, SEEK_SET);
-                        repeatCount++;
-                    }
-                }
-            }
+            planes[numPlanes++] = { pData->Y, pitch, w, h };
+            planes[numPlanes++] = { pData->UV, pitch, w, h / 2 };
             break;
-
         case MFX_FOURCC_I420:
-            // read luminance plane (Y)
-            pitch = pData->Pitch;
-            ptr   = pData->Y;
-            for (i = 0; i < h; i++) {
-                nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, f);
-                if (w != nBytesRead) {
-                    if (repeatCount == repeat)
-                        return MFX_ERR_MORE_DATA;
-                    else {
-                        fseek(f, 0, SEEK_SET);
-                        repeatCount++;
-                    }
-                }
-            }
-
-            // read chrominance (U, V)
-            pitch /= 2;
-            h /= 2;
-            w /= 2;
-            ptr = pData->U;
-            for (i = 0; i < h; i++) {
-                nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, f);
-                if (w != nBytesRead) {
-                    if (repeatCount == repeat)
-                        return MFX_ERR_MORE_DATA;
-                    else {
-                        fseek(f, 0, SEEK_SET);
-                        repeatCount++;
-                    }
-                }
-            }
-
-            ptr = pData->V;
-            for (i = 0; i < h; i++) {
-                nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, f);
-                if (w != nBytesRead) {
-                    if (repeatCount == repeat)
-                        return MFX_ERR_MORE_DATA;
-                    else {
-                        fseek(f, 0, SEEK_SET);
-                        repeatCount++;
-                    }
-                }
-            }
+            planes[numPlanes++] = { pData->Y, pitch, w, h };
+            planes[numPlanes++] = { pData->U, pitch / 2, w / 2, h / 2 };
+            planes[numPlanes++] = { pData->V, pitch / 2, w / 2, h / 2 };
             break;
-
         case MFX_FOURCC_P010:
-            // read luminance plane (Y)
-            pitch = pData->Pitch;
-            w *= 2;
-            ptr = pData->Y;
-            for (i = 0; i < h; i++) {
-                nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, f);
-                if (w != nBytesRead) {
-                    if (repeatCount == repeat)
-                        return MFX_ERR_MORE_DATA;
-                    else {
-                        fseek(f, 0, SEEK_SET);
-                        repeatCount++;
-                    }
-                }
-            }
-
-            // read chrominance (U, V)
-            h /= 2;
-            ptr = pData->UV;
-            for (i = 0; i < h; i++) {
-                nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, f);
-                if (w != nBytesRead) {
-                    if (repeatCount == repeat)
-                        return MFX_ERR_MORE_DATA;
-                    else {
-                        fseek(f, 0, SEEK_SET);
-                        repeatCount++;
-                    }
-                }
-            }
+            planes[numPlanes++] = { pData->Y, pitch, w * 2, h };
+            planes[numPlanes++] = { pData->UV, pitch, w * 2, h / 2 };
             break;
-
         case MFX_FOURCC_I010:
-            // read luminance plane (Y)
-            pitch = pData->Pitch;
-            w *= 2;
-            ptr = pData->Y;
-            for (i = 0; i < h; i++) {
-                nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, f);
-                if (w != nBytesRead) {
-                    if (repeatCount == repeat)
-                        return MFX_ERR_MORE_DATA;
-                    else {
-                        fseek(f, 0, SEEK_SET);
-                        repeatCount++;
-                    }
-                }
-            }
-
-            // read chrominance (U, V)
-            pitch /= 2;
-            w /= 2;
-            h /= 2;
-            ptr = pData->U;
-            for (i = 0; i < h; i++) {
-                nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, f);
-                if (w != nBytesRead) {
-                    if (repeatCount == repeat)
-                        return MFX_ERR_MORE_DATA;
-                    else {
-                        fseek(f, 0, SEEK_SET);
-                        repeatCount++;
-                    }
-                }
-            }
-
-            ptr = pData->V;
-            for (i = 0; i < h; i++) {
-                nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, f);
-                if (w != nBytesRead) {
-                    if (repeatCount == repeat)
-                        return MFX_ERR_MORE_DATA;
-                    else {
-                        fseek(f, 0, SEEK_SET);
-                        repeatCount++;
-                    }
-                }
-            }
+            planes[numPlanes++] = { pData->Y, pitch, w * 2, h };
+            planes[numPlanes++] = { pData->U, pitch / 2, w, h / 2 };
+            planes[numPlanes++] = { pData->V, pitch / 2, w, h / 2 };
             break;
-
         case MFX_FOURCC_RGB4:
-            // read luminance plane (Y)
-            pitch = pData->Pitch;
-            w *= 4;
-            ptr = pData->B;
-            for (i = 0; i < h; i++) {
-                nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, f);
-                if (w != nBytesRead) {
-                    if (repeatCount == repeat)
-                        return MFX_ERR_MORE_DATA;
-                    else {
-                        fseek(f, 0, SEEK_SET);
-                        repeatCount++;
-                    }
-                }
-            }
+            planes[numPlanes++] = { pData->B, pitch, w * 4, h };
             break;
         default:
             break;
     }
 
-    return MFX_ERR_NONE;
+    if (numPlanes == 0)
+        return MFX_ERR_NONE;
+
+    return g_frameReader.LoadFrame(planes, numPlanes);
 }
 
 mfxU32 GetSurfaceSize(mfxU32 FourCC, mfxU32 width, mfxU32 height) {
@@ -1080,6 +964,27 @@ bool ParseArgsAndValidate(int argc, char* argv[], Params* params) {
         else if (IS_ARG_EQ(s, "fframe")) {
             params->inFrameReadMode = INPUT_FRAME_READ_MODE_FRAME;
         }
+        else if (IS_ARG_EQ(s, "preload")) {
+            params->preloadInput = true;
+        }
+        else if (IS_ARG_EQ(s, "ra")) {
+            if (atoi(argv[idx]) < 0 || atoi(argv[idx]) > MAX_READ_AHEAD_FRAMES) {
+                printf("ERROR - invalid argument: value for -ra switch must be 0 to %d\n",
+                       MAX_READ_AHEAD_FRAMES);
+                return false;
+            }
+
+            params->readAhead = atoi(argv[idx++]);
+        }
+        else if (IS_ARG_EQ(s, "wb")) {
+            if (atoi(argv[idx]) < 0 || atoi(argv[idx]) > MAX_WRITE_BEHIND_FRAMES) {
+                printf("ERROR - invalid argument: value for -wb switch must be 0 to %d\n",
+                       MAX_WRITE_BEHIND_FRAMES);
+                return false;
+            }
+
+            params->writeBehind = atoi(argv[idx++]);
+        }
         else {
             printf("ERROR - invalid argument: %s\n", argv[idx]);
             return false;
@@ -1127,6 +1032,9 @@ void Usage(void) {
     printf("\nFrame mode (optional, default = -fpitch)\n");
     printf("  -fpitch = load frame-by-frame (read data per pitch - legacy)\n");
     printf("  -fframe = load frame-by-frame (read data per frame)\n");
+    printf("  -ra N   = with -fpitch, read up to N frames ahead on another thread (default 0)\n");
+    printf("  -preload = with -fpitch, load input (first maxFrames if -n) into memory once\n");
+    printf("  -wb N   = write up to N output frames behind on another thread (default 0)\n");
 
     printf("\nIn case of AV1, output will be contained with IVF headers.\n");
     printf("To view:\n");
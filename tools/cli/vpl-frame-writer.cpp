@@ -0,0 +1,168 @@
+/*############################################################################
+  # Copyright (C) Intel Corporation
+  #
+  # SPDX-License-Identifier: MIT
+  ############################################################################*/
+
+#include "./vpl-frame-writer.h"
+
+#if defined(_WIN32) || defined(_WIN64)
+    #include <io.h>
+#else
+    #include <unistd.h>
+#endif
+
+FrameWriter::FrameWriter()
+        : m_fd(-1),
+          m_frames(),
+          m_head(0),
+          m_count(0),
+          m_fill(0),
+          m_bStop(false),
+          m_thread(),
+          m_mutex(),
+          m_cv() {}
+
+FrameWriter::~FrameWriter() {
+    Close();
+}
+
+bool FrameWriter::Open(FILE* f, mfxU32 writeBehind) {
+    Close();
+
+    if (!f || writeBehind > MAX_WRITE_BEHIND_FRAMES)
+        return false;
+
+    // own descriptor, so the writer thread is independent of the caller closing f
+    fflush(f);
+#if defined(_WIN32) || defined(_WIN64)
+    m_fd = _dup(_fileno(f));
+#else
+    m_fd = dup(fileno(f));
+#endif
+    if (m_fd < 0)
+        return false;
+
+    m_head  = 0;
+    m_count = 0;
+    m_fill  = 0;
+    m_bStop = false;
+
+    try {
+        m_frames.resize(writeBehind + 1);
+
+        if (writeBehind)
+            m_thread = std::thread(&FrameWriter::WriteBehindThread, this);
+    }
+    catch (...) {
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+void FrameWriter::Close() {
+    if (m_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_bStop = true;
+        }
+        m_cv.notify_all();
+        m_thread.join();
+    }
+
+    m_frames.clear();
+
+    if (m_fd >= 0) {
+#if defined(_WIN32) || defined(_WIN64)
+        _close(m_fd);
+#else
+        close(m_fd);
+#endif
+        m_fd = -1;
+    }
+}
+
+void FrameWriter::WriteFrame(const std::vector<mfxU8>& buf) {
+    const mfxU8* data = buf.data();
+    size_t size       = buf.size();
+
+    // write() may return after writing part of the data
+    while (size > 0) {
+#if defined(_WIN32) || defined(_WIN64)
+        int n = _write(m_fd, data, (unsigned int)size);
+#else
+        ssize_t n = write(m_fd, data, size);
+#endif
+        if (n <= 0)
+            return;
+
+        data += n;
+        size -= n;
+    }
+}
+
+void FrameWriter::WriteBehindThread() {
+    mfxU32 numFrames = (mfxU32)m_frames.size();
+
+    for (;;) {
+        std::vector<mfxU8>* buf = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [&]() {
+                return m_bStop || m_count > 0;
+            });
+            // queued frames are still written after Close()
+            if (m_count == 0)
+                return;
+
+            // the caller does not touch buffers inside m_head..m_head+m_count-1
+            buf = &m_frames[m_head];
+        }
+
+        WriteFrame(*buf);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_head = (m_head + 1) % numFrames;
+            m_count--;
+        }
+        m_cv.notify_all();
+    }
+}
+
+void FrameWriter::Append(const void* data, size_t size) {
+    if (m_fd < 0)
+        return;
+
+    // the current buffer is not queued, so no lock is needed to fill it
+    std::vector<mfxU8>& buf = m_frames[m_fill];
+    const mfxU8* src        = reinterpret_cast<const mfxU8*>(data);
+    buf.insert(buf.end(), src, src + size);
+}
+
+void FrameWriter::Commit() {
+    if (m_fd < 0)
+        return;
+
+    if (!m_thread.joinable()) {
+        WriteFrame(m_frames[0]);
+        m_frames[0].clear();
+        return;
+    }
+
+    mfxU32 numFrames = (mfxU32)m_frames.size();
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_count++;
+        m_cv.notify_all();
+
+        // wait for the next buffer to be written out before filling it
+        m_cv.wait(lock, [&]() {
+            return m_count < numFrames;
+        });
+        m_fill = (m_head + m_count) % numFrames;
+    }
+    m_frames[m_fill].clear();
+}
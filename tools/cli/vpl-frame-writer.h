@@ -0,0 +1,72 @@
+/*############################################################################
+  # Copyright (C) Intel Corporation
+  #
+  # SPDX-License-Identifier: MIT
+  ############################################################################*/
+#ifndef TOOLS_CLI_VPL_FRAME_WRITER_H_
+#define TOOLS_CLI_VPL_FRAME_WRITER_H_
+
+#include <stdio.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "vpl/mfxdefs.h"
+
+#define MAX_WRITE_BEHIND_FRAMES 16
+
+// Writes output frames (raw or encoded) with one write() per frame.
+// The caller appends the pieces of a frame (rows, headers) to a buffer and
+// commits it. With writeBehind > 0 a separate thread writes committed frames,
+// up to writeBehind frames behind the caller, so processing only waits for
+// the disk if it produces frames faster than they can be written.
+// Buffers are reused, so there is no allocation per frame once they have grown
+// to the frame size.
+class FrameWriter {
+public:
+    FrameWriter();
+    ~FrameWriter();
+
+    // writes go to a duplicate of the file's descriptor, starting at its
+    //   current position - nothing else may write to f until Close()
+    bool Open(FILE* f, mfxU32 writeBehind);
+
+    // write all committed frames and close the duplicate descriptor
+    void Close();
+
+    bool IsOpen() const {
+        return m_fd >= 0;
+    }
+
+    // add data to the current frame
+    void Append(const void* data, size_t size);
+
+    // write the current frame, or queue it if there is a writer thread
+    void Commit();
+
+private:
+    FrameWriter(const FrameWriter&);
+    FrameWriter& operator=(const FrameWriter&);
+
+    void WriteFrame(const std::vector<mfxU8>& buf);
+    void WriteBehindThread();
+
+    int m_fd;
+
+    // ring of frame buffers, m_count frames starting at m_head are queued,
+    //   the caller fills m_fill, the one after them
+    // without write-behind there is one buffer which is written on commit
+    std::vector<std::vector<mfxU8>> m_frames;
+    mfxU32 m_head;
+    mfxU32 m_count;
+    mfxU32 m_fill;
+    bool m_bStop;
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+};
+
+#endif // TOOLS_CLI_VPL_FRAME_WRITER_H_
@@ -0,0 +1,125 @@
+/*############################################################################
+  # Copyright (C) Intel Corporation
+  #
+  # SPDX-License-Identifier: MIT
+  ############################################################################*/
+
+#include "./vpl-preload-buffer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#if !defined(_WIN32) && !defined(_WIN64)
+    #include <sys/mman.h>
+#endif
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+PreloadBuffer::PreloadBuffer() : m_data(nullptr), m_size(0), m_alloc(nullptr), m_allocSize(0) {}
+
+PreloadBuffer::~PreloadBuffer() {
+    Free();
+}
+
+bool PreloadBuffer::Alloc(size_t size) {
+#if defined(_WIN32) || defined(_WIN64)
+    m_alloc = malloc(size);
+    if (!m_alloc)
+        return false;
+
+    m_allocSize = size;
+    m_data      = (mfxU8*)m_alloc;
+#else
+    size_t hugeSize = (size + HUGE_PAGE_SIZE - 1) & ~((size_t)HUGE_PAGE_SIZE - 1);
+
+    #ifdef MAP_HUGETLB
+    // explicit huge pages, only if the system has reserved them
+    void* hugeAddr = mmap(nullptr,
+                          hugeSize,
+                          PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+                          -1,
+                          0);
+    if (hugeAddr != MAP_FAILED) {
+        m_alloc     = hugeAddr;
+        m_allocSize = hugeSize;
+        m_data      = (mfxU8*)hugeAddr;
+        return true;
+    }
+    #endif
+
+    // otherwise align to the huge page size so transparent huge pages can be used
+    size_t allocSize = hugeSize + HUGE_PAGE_SIZE;
+
+    void* addr =
+        mmap(nullptr, allocSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED)
+        return false;
+
+    size_t aligned = ((size_t)addr + HUGE_PAGE_SIZE - 1) & ~((size_t)HUGE_PAGE_SIZE - 1);
+
+    #ifdef MADV_HUGEPAGE
+    madvise((void*)aligned, hugeSize, MADV_HUGEPAGE);
+    #endif
+
+    m_alloc     = addr;
+    m_allocSize = allocSize;
+    m_data      = (mfxU8*)aligned;
+#endif
+
+    return true;
+}
+
+void PreloadBuffer::Free() {
+    if (m_alloc) {
+#if defined(_WIN32) || defined(_WIN64)
+        free(m_alloc);
+#else
+        munmap(m_alloc, m_allocSize);
+#endif
+    }
+
+    m_data      = nullptr;
+    m_size      = 0;
+    m_alloc     = nullptr;
+    m_allocSize = 0;
+}
+
+bool PreloadBuffer::Load(const char* fileName, size_t maxBytes) {
+    Free();
+
+    if (!fileName)
+        return false;
+
+    FILE* f = fopen(fileName, "rb");
+    if (!f)
+        return false;
+
+    fseek(f, 0, SEEK_END);
+#ifdef _WIN32
+    mfxU64 fileSize = _ftelli64(f);
+#else
+    mfxU64 fileSize = ftello(f);
+#endif
+    rewind(f);
+
+    size_t size = (size_t)fileSize;
+    if (maxBytes && maxBytes < size)
+        size = maxBytes;
+
+    if (size == 0 || !Alloc(size)) {
+        fclose(f);
+        return false;
+    }
+
+    // reading also faults in every page, so nothing is left to do on first access
+    m_size = fread(m_data, 1, size, f);
+    fclose(f);
+
+    if (m_size != size) {
+        Free();
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,49 @@
+/*############################################################################
+  # Copyright (C) Intel Corporation
+  #
+  # SPDX-License-Identifier: MIT
+  ############################################################################*/
+#ifndef TOOLS_CLI_VPL_PRELOAD_BUFFER_H_
+#define TOOLS_CLI_VPL_PRELOAD_BUFFER_H_
+
+#include <stddef.h>
+
+#include "vpl/mfxdefs.h"
+
+// Input file (or its first maxBytes bytes) loaded into one contiguous buffer,
+// so repeated runs over the input do no file I/O.
+// On Linux the buffer is backed by huge pages if available (MAP_HUGETLB,
+// otherwise transparent huge pages), which keeps TLB misses out of the
+// measurements for large inputs.
+class PreloadBuffer {
+public:
+    PreloadBuffer();
+    ~PreloadBuffer();
+
+    // maxBytes == 0 loads the whole file
+    bool Load(const char* fileName, size_t maxBytes);
+    void Free();
+
+    mfxU8* GetData() const {
+        return m_data;
+    }
+
+    size_t GetSize() const {
+        return m_size;
+    }
+
+private:
+    PreloadBuffer(const PreloadBuffer&);
+    PreloadBuffer& operator=(const PreloadBuffer&);
+
+    bool Alloc(size_t size);
+
+    mfxU8* m_data;
+    size_t m_size;
+
+    // allocation, may be larger than and start before m_data
+    void* m_alloc;
+    size_t m_allocSize;
+};
+
+#endif // TOOLS_CLI_VPL_PRELOAD_BUFFER_H_
@@ -0,0 +1,222 @@
+/*############################################################################
+  # Copyright (C) Intel Corporation
+  #
+  # SPDX-License-Identifier: MIT
+  ############################################################################*/
+
+#include "./vpl-raw-frame-reader.h"
+
+#include <string.h>
+
+RawFrameReader::RawFrameReader()
+        : m_file(nullptr),
+          m_frameSize(0),
+          m_repeat(0),
+          m_repeatCount(0),
+          m_frames(),
+          m_head(0),
+          m_count(0),
+          m_bEnd(false),
+          m_bStop(false),
+          m_thread(),
+          m_mutex(),
+          m_cv(),
+          m_preload(),
+          m_numPreloaded(0),
+          m_frameIndex(0) {}
+
+RawFrameReader::~RawFrameReader() {
+    Close();
+}
+
+bool RawFrameReader::Open(const char* fileName,
+                          mfxU32 frameSize,
+                          mfxU32 repeat,
+                          mfxU32 readAhead) {
+    Close();
+
+    if (!fileName || frameSize == 0 || readAhead > MAX_READ_AHEAD_FRAMES)
+        return false;
+
+    // own handle, so the read-ahead thread is independent of the caller's file
+    m_file = fopen(fileName, "rb");
+    if (!m_file)
+        return false;
+
+    m_frameSize   = frameSize;
+    m_repeat      = repeat;
+    m_repeatCount = 0;
+    m_head        = 0;
+    m_count       = 0;
+    m_bEnd        = false;
+    m_bStop       = false;
+
+    try {
+        m_frames.assign(readAhead ? readAhead : 1, std::vector<mfxU8>(frameSize));
+
+        if (readAhead)
+            m_thread = std::thread(&RawFrameReader::ReadAheadThread, this);
+    }
+    catch (...) {
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+bool RawFrameReader::Preload(const char* fileName,
+                             mfxU32 frameSize,
+                             mfxU32 repeat,
+                             mfxU32 maxFrames) {
+    Close();
+
+    if (frameSize == 0 || !m_preload.Load(fileName, (size_t)maxFrames * frameSize))
+        return false;
+
+    m_frameSize    = frameSize;
+    m_repeat       = repeat;
+    m_numPreloaded = (mfxU32)(m_preload.GetSize() / frameSize);
+    m_frameIndex   = 0;
+
+    if (m_numPreloaded == 0) {
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+void RawFrameReader::Close() {
+    if (m_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_bStop = true;
+        }
+        m_cv.notify_all();
+        m_thread.join();
+    }
+
+    m_frames.clear();
+    m_preload.Free();
+    m_numPreloaded = 0;
+
+    if (m_file) {
+        fclose(m_file);
+        m_file = nullptr;
+    }
+}
+
+// read one whole frame, restarting from the beginning of the file at the end if repeat is set
+bool RawFrameReader::ReadFrame(mfxU8* buf) {
+    for (;;) {
+        if (fread(buf, 1, m_frameSize, m_file) == m_frameSize)
+            return true;
+
+        if (m_repeatCount >= m_repeat)
+            return false;
+
+        fseek(m_file, 0, SEEK_SET);
+        m_repeatCount++;
+    }
+}
+
+void RawFrameReader::ReadAheadThread() {
+    mfxU32 numFrames = (mfxU32)m_frames.size();
+
+    for (;;) {
+        mfxU8* buf = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [&]() {
+                return m_bStop || m_count < numFrames;
+            });
+            if (m_bStop)
+                return;
+
+            // the consumer does not touch buffers outside m_head..m_head+m_count-1
+            buf = m_frames[(m_head + m_count) % numFrames].data();
+        }
+
+        bool bRead = ReadFrame(buf);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (bRead)
+                m_count++;
+            else
+                m_bEnd = true;
+        }
+        m_cv.notify_all();
+
+        if (!bRead)
+            return;
+    }
+}
+
+mfxStatus RawFrameReader::LoadFrame(const RawFramePlane* planes, mfxU32 numPlanes) {
+    if (!IsOpen())
+        return MFX_ERR_NOT_INITIALIZED;
+
+    // the planes must not need more than one frame, or frames would be read from wrong offsets
+    size_t totalBytes = 0;
+    for (mfxU32 i = 0; i < numPlanes; i++)
+        totalBytes += (size_t)planes[i].rowBytes * planes[i].rows;
+    if (totalBytes > m_frameSize)
+        return MFX_ERR_UNDEFINED_BEHAVIOR;
+
+    const mfxU8* src = nullptr;
+
+    if (m_numPreloaded) {
+        if (m_frameIndex >= (mfxU64)m_numPreloaded * (m_repeat + 1))
+            return MFX_ERR_MORE_DATA;
+
+        src = m_preload.GetData() + (size_t)(m_frameIndex % m_numPreloaded) * m_frameSize;
+        m_frameIndex++;
+    }
+    else if (m_thread.joinable()) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [&]() {
+            return m_count > 0 || m_bEnd;
+        });
+        if (m_count == 0)
+            return MFX_ERR_MORE_DATA;
+
+        src = m_frames[m_head].data();
+    }
+    else {
+        if (!ReadFrame(m_frames[0].data()))
+            return MFX_ERR_MORE_DATA;
+
+        src = m_frames[0].data();
+    }
+
+    // planes are contiguous in the file, rows are copied separately only if the surface is pitched
+    for (mfxU32 i = 0; i < numPlanes; i++) {
+        const RawFramePlane& plane = planes[i];
+        size_t planeBytes          = (size_t)plane.rowBytes * plane.rows;
+
+        if (plane.dstPitch == plane.rowBytes) {
+            memcpy(plane.dst, src, planeBytes);
+        }
+        else {
+            for (mfxU32 row = 0; row < plane.rows; row++)
+                memcpy(plane.dst + (size_t)row * plane.dstPitch,
+                       src + (size_t)row * plane.rowBytes,
+                       plane.rowBytes);
+        }
+
+        src += planeBytes;
+    }
+
+    if (m_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_head = (m_head + 1) % (mfxU32)m_frames.size();
+            m_count--;
+        }
+        m_cv.notify_all();
+    }
+
+    return MFX_ERR_NONE;
+}
@@ -0,0 +1,89 @@
+/*############################################################################
+  # Copyright (C) Intel Corporation
+  #
+  # SPDX-License-Identifier: MIT
+  ############################################################################*/
+#ifndef TOOLS_CLI_VPL_RAW_FRAME_READER_H_
+#define TOOLS_CLI_VPL_RAW_FRAME_READER_H_
+
+#include <stdio.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "./vpl-preload-buffer.h"
+#include "vpl/mfxstructures.h"
+
+#define MAX_READ_AHEAD_FRAMES 16
+
+// one plane of a raw frame: rows of rowBytes each, stored one after the other in the file,
+//   copied to dst with dstPitch bytes between rows
+typedef struct {
+    mfxU8* dst;
+    mfxU32 dstPitch;
+    mfxU32 rowBytes;
+    mfxU32 rows;
+} RawFramePlane;
+
+// Reads raw frames of frameSize bytes with one fread() per frame.
+// With readAhead > 0 a separate thread reads up to readAhead frames in advance,
+// so the caller only waits for the file if it consumes frames faster than they
+// can be read.
+// With Preload() the frames are read into memory once and copied to the
+// surfaces straight from there, also for every repeat.
+// At the end of the file the input is restarted repeat times, a partial frame
+// at the end of the file is skipped.
+class RawFrameReader {
+public:
+    RawFrameReader();
+    ~RawFrameReader();
+
+    bool Open(const char* fileName, mfxU32 frameSize, mfxU32 repeat, mfxU32 readAhead);
+
+    // load the first maxFrames frames (0 = all) up front, no file I/O after this
+    bool Preload(const char* fileName, mfxU32 frameSize, mfxU32 repeat, mfxU32 maxFrames);
+
+    void Close();
+
+    bool IsOpen() const {
+        return m_file != nullptr || m_numPreloaded > 0;
+    }
+
+    // copy the next frame to the planes, which must add up to frameSize bytes
+    // returns MFX_ERR_MORE_DATA at the end of the input, and
+    //   MFX_ERR_UNDEFINED_BEHAVIOR if the planes need more than frameSize bytes
+    mfxStatus LoadFrame(const RawFramePlane* planes, mfxU32 numPlanes);
+
+private:
+    RawFrameReader(const RawFrameReader&);
+    RawFrameReader& operator=(const RawFrameReader&);
+
+    bool ReadFrame(mfxU8* buf);
+    void ReadAheadThread();
+
+    FILE* m_file;
+    mfxU32 m_frameSize;
+    mfxU32 m_repeat;
+    mfxU32 m_repeatCount;
+
+    // ring of frame buffers, m_count frames starting at m_head are ready
+    // without read-ahead there is one buffer which is read on demand
+    std::vector<std::vector<mfxU8>> m_frames;
+    mfxU32 m_head;
+    mfxU32 m_count;
+    bool m_bEnd;
+    bool m_bStop;
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+
+    // preloaded frames, replayed m_repeat more times
+    PreloadBuffer m_preload;
+    mfxU32 m_numPreloaded;
+    mfxU64 m_frameIndex;
+};
+
+#endif // TOOLS_CLI_VPL_RAW_FRAME_READER_H_
@@ -6,6 +6,8 @@
 
 #include <string>
 #include "./vpl-common.h"
+#include "./vpl-frame-writer.h"
+#include "./vpl-raw-frame-reader.h"
 #include "vpl/mfxvideo.h"
 
 #if !defined(WIN32) && !defined(memcpy_s)
@@ -19,19 +21,21 @@
 #define MAX_WIDTH  3840
 #define MAX_HEIGHT 2160
 mfxU32 repeatCount = 0;
+RawFrameReader g_frameReader;
+FrameWriter g_writer;
 
 const char* InputFrameReadModeString[INPUT_FRAME_READ_MODE_COUNT] = {
     "INPUT_FRAME_READ_MODE_PITCH",
     "INPUT_FRAME_READ_MODE_FRAME"
 };
 
-mfxStatus LoadRawFrame(mfxFrameSurface1* pSurface, FILE* f, mfxU32 repeat);
+mfxStatus LoadRawFrame(mfxFrameSurface1* pSurface);
 mfxStatus LoadRawFrame2(mfxFrameSurface1* pSurface,
                         FILE* f,
                         int bytes_to_read,
                         mfxU8* buf_read,
                         mfxU32 repeat);
-void WriteRawFrame(mfxFrameSurface1* pSurface, FILE* f);
+void WriteRawFrame(mfxFrameSurface1* pSurface);
 mfxU32 GetSurfaceWidth(mfxU32 fourcc, mfxU16 img_width);
 mfxU32 GetSurfaceSize(mfxU32 FourCC, mfxU32 width, mfxU32 height);
 char** ValidateInput(int cnt, char* in[]);
@@ -79,6 +83,14 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    // output frames are written through g_writer, see FrameWriter
+    if (!g_writer.Open(fSink, params.writeBehind)) {
+        fclose(fSource);
+        fclose(fSink);
+        printf("could not create output file, %s\n", params.outfileName);
+        return 1;
+    }
+
     mfxStatus sts      = MFX_ERR_NOT_INITIALIZED;
     mfxSession session = nullptr;
 
@@ -202,6 +214,32 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    // pitch mode reads whole frames, see RawFrameReader
+    if (!b_read_frame) {
+        bool bOpened = false;
+        if (params.preloadInput)
+            bOpened = g_frameReader.Preload(params.infileName,
+                                            frame_size,
+                                            params.repeat,
+                                            params.maxFrames);
+        else
+            bOpened =
+                g_frameReader.Open(params.infileName, frame_size, params.repeat, params.readAhead);
+
+        if (!bOpened) {
+            if (fSource) {
+                fclose(fSource);
+                fSource = NULL;
+            }
+            if (fSink) {
+                fclose(fSink);
+                fSink = NULL;
+            }
+            puts("Error opening input file for frame read.");
+            return 1;
+        }
+    }
+
     // get file size
     fseek(fSource, 0, SEEK_END);
 #ifdef _WIN32
@@ -427,7 +465,7 @@ int main(int argc, char* argv[]) {
                 sts = LoadRawFrame2(vppSurfaceIn, fSource, frame_size, buf_read, params.repeat);
             }
             else {
-                sts = LoadRawFrame(vppSurfaceIn, fSource, params.repeat);
+                sts = LoadRawFrame(vppSurfaceIn);
             }
         }
         else {
@@ -467,7 +505,7 @@ int main(int argc, char* argv[]) {
                 sts = MFXVideoCORE_SyncOperation(session, syncp, 60000);
             }
             if (!IS_ARG_EQ(params.outfileName, "null")) {
-                WriteRawFrame(vppSurfaceOut, fSink);
+                WriteRawFrame(vppSurfaceOut);
             }
 
             if (params.memoryMode == MEM_MODE_INTERNAL) {
@@ -584,7 +622,7 @@ int main(int argc, char* argv[]) {
             }
 
             if (!IS_ARG_EQ(params.outfileName, "null")) {
-                WriteRawFrame(&pVPPSurfacesOut[nSurfIdxOut], fSink);
+                WriteRawFrame(&pVPPSurfacesOut[nSurfIdxOut]);
             }
 
             if (params.memoryMode == MEM_MODE_INTERNAL) {
@@ -623,10 +661,12 @@ int main(int argc, char* argv[]) {
         fclose(fSource);
         fSource = NULL;
     }
+    g_writer.Close();
     if (fSink) {
         fclose(fSink);
         fSink = NULL;
     }
+    g_frameReader.Close();
     if (buf_read) {
         free(buf_read);
         buf_read = NULL;
@@ -683,139 +723,43 @@ mfxStatus LoadRawFrame2(mfxFrameSurface1* pSurface,
     return MFX_ERR_NONE;
 }
 
-mfxStatus LoadRawFrame(mfxFrameSurface1* pSurface, FILE* f, mfxU32 repeat) {
-    mfxU16 w, h, i, pitch;
-    mfxU32 nBytesRead;
-    mfxU8* ptr;
+mfxStatus LoadRawFrame(mfxFrameSurface1* pSurface) {
+    RawFramePlane planes[3];
+    mfxU32 numPlanes    = 0;
     mfxFrameInfo* pInfo = &pSurface->Info;
     mfxFrameData* pData = &pSurface->Data;
+    mfxU32 pitch        = pData->Pitch;
+    mfxU32 w            = pInfo->Width;
+    mfxU32 h            = pInfo->Height;
 
-    w = pInfo->Width;
-    h = pInfo->Height;
-
+    // planes in the order in which they are stored in the file
     switch (pInfo->FourCC) {
         case MFX_FOURCC_NV12:
         case MFX_FOURCC_I420:
-            // read luminance plane (Y)
-            pitch = pData->Pitch;
-            ptr   = pData->Y;
-            for (i = 0; i < h; i++) {
-                nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, f);
-                if (w != nBytesRead) {
-                    if (repeatCount == repeat)
-                        return MFX_ERR_MORE_DATA;
-                    else {
-                        fseek(f, 0, SEEK_SET);
-                        repeatCount++;
-                    }
-                }
-            }
-
-            // read chrominance (U, V)
-            pitch /= 2;
-            h /= 2;
-            w /= 2;
-            ptr = pData->U;
-            for (i = 0; i < h; i++) {
-                nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, f);
-                if (w != nBytesRead) {
-                    if (repeatCount == repeat)
-                        return MFX_ERR_MORE_DATA;
-                    else {
-                        fseek(f, 0, SEEK_SET);
-                        repeatCount++;
-                    }
-                }
-            }
-
-            ptr = pData->V;
-            for (i = 0; i < h; i++) {
-                nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, f);
-                if (w != nBytesRead) {
-                    if (repeatCount == repeat)
-                        return MFX_ERR_MORE_DATA;
-                    else {
-                        fseek(f, 0, SEEK_SET);
-                        repeatCount++;
-                    }
-                }
-            }
+            planes[numPlanes++] = { pData->Y, pitch, w, h };
+            planes[numPlanes++] = { pData->U, pitch / 2, w / 2, h / 2 };
+            planes[numPlanes++] = { pData->V, pitch / 2, w / 2, h / 2 };
             break;
-
         case MFX_FOURCC_P010:
         case MFX_FOURCC_I010:
-            // read luminance plane (Y)
-            pitch = pData->Pitch;
-            w *= 2;
-            ptr = pData->Y;
-            for (i = 0; i < h; i++) {
-                nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, f);
-                if (w != nBytesRead) {
-                    if (repeatCount == repeat)
-                        return MFX_ERR_MORE_DATA;
-                    else {
-                        fseek(f, 0, SEEK_SET);
-                        repeatCount++;
-                    }
-                }
-            }
-
-            // read chrominance (U, V)
-            pitch /= 2;
-            w /= 2;
-            h /= 2;
-            ptr = pData->U;
-            for (i = 0; i < h; i++) {
-                nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, f);
-                if (w != nBytesRead) {
-                    if (repeatCount == repeat)
-                        return MFX_ERR_MORE_DATA;
-                    else {
-                        fseek(f, 0, SEEK_SET);
-                        repeatCount++;
-                    }
-                }
-            }
-
-            ptr = pData->V;
-            for (i = 0; i < h; i++) {
-                nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, f);
-                if (w != nBytesRead) {
-                    if (repeatCount == repeat)
-                        return MFX_ERR_MORE_DATA;
-                    else {
-                        fseek(f, 0, SEEK_SET);
-                        repeatCount++;
-                    }
-                }
-            }
+            planes[numPlanes++] = { pData->Y, pitch, w * 2, h };
+            planes[numPlanes++] = { pData->U, pitch / 2, w, h / 2 };
+            planes[numPlanes++] = { pData->V, pitch / 2, w, h / 2 };
             break;
-
         case MFX_FOURCC_RGB4:
-            // read luminance plane (Y)
-            pitch = pData->Pitch;
-            w *= 4;
-            ptr = pData->B;
-            for (i = 0; i < h; i++) {
-                nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, f);
-                if (w != nBytesRead) {
-                    if (repeatCount == repeat)
-                        return MFX_ERR_MORE_DATA;
-                    else {
-                        fseek(f, 0, SEEK_SET);
-                        repeatCount++;
-                    }
-                }
-            }
+            planes[numPlanes++] = { pData->B, pitch, w * 4, h };
             break;
         default:
             break;
     }
 
-    return MFX_ERR_NONE;
+    if (numPlanes == 0)
+        return MFX_ERR_NONE;
+
+    return g_frameReader.LoadFrame(planes, numPlanes);
 }
 
-void WriteRawFrame(mfxFrameSurface1* pSurface, FILE* f) {
+void WriteRawFrame(mfxFrameSurface1* pSurface) {
     mfxU16 w, h, i, pitch;
     mfxFrameInfo* pInfo = &pSurface->Info;
     mfxFrameData* pData = &pSurface->Data;
@@ -823,14 +767,14 @@ void WriteRawFrame(mfxFrameSurface1* pSurface, FILE* f) {
     w = pInfo->Width;
     h = pInfo->Height;
 
-    // write the output to disk
+    // copy the output rows to one buffer, written to disk with a single write
     switch (pInfo->FourCC) {
         case MFX_FOURCC_NV12:
         case MFX_FOURCC_I420:
             //Y
             pitch = pData->Pitch;
             for (i = 0; i < h; i++) {
-                fwrite(pData->Y + i * pitch, 1, w, f);
+                g_writer.Append(pData->Y + i * pitch, w);
             }
 
             //U
@@ -838,11 +782,11 @@ void WriteRawFrame(mfxFrameSurface1* pSurface, FILE* f) {
             h /= 2;
             w /= 2;
             for (i = 0; i < h; i++) {
-                fwrite(pData->U + i * pitch, 1, w, f);
+                g_writer.Append(pData->U + i * pitch, w);
             }
             //V
             for (i = 0; i < h; i++) {
-                fwrite(pData->V + i * pitch, 1, w, f);
+                g_writer.Append(pData->V + i * pitch, w);
             }
             break;
 
@@ -852,7 +796,7 @@ void WriteRawFrame(mfxFrameSurface1* pSurface, FILE* f) {
             pitch = pData->Pitch;
             w *= 2;
             for (i = 0; i < h; i++) {
-                fwrite(pSurface->Data.Y + i * pitch, 1, w, f);
+                g_writer.Append(pSurface->Data.Y + i * pitch, w);
             }
 
             //U
@@ -860,11 +804,11 @@ void WriteRawFrame(mfxFrameSurface1* pSurface, FILE* f) {
             w /= 2;
             h /= 2;
             for (i = 0; i < h; i++) {
-                fwrite(pSurface->Data.U + i * pitch, 1, w, f);
+                g_writer.Append(pSurface->Data.U + i * pitch, w);
             }
             //V
             for (i = 0; i < h; i++) {
-                fwrite(pSurface->Data.V + i * pitch, 1, w, f);
+                g_writer.Append(pSurface->Data.V + i * pitch, w);
             }
             break;
 
@@ -872,13 +816,14 @@ void WriteRawFrame(mfxFrameSurface1* pSurface, FILE* f) {
             pitch = pData->Pitch;
             w *= 4;
             for (i = 0; i < h; i++) {
-                fwrite(pSurface->Data.B + i * pitch, 1, w, f);
+                g_writer.Append(pSurface->Data.B + i * pitch, w);
             }
             break;
         default:
             break;
     }
 
+    g_writer.Commit();
     return;
 }
 
@@ -1231,6 +1176,27 @@ bool ParseArgsAndValidate(int argc, char* argv[], Params* params) {
         else if (IS_ARG_EQ(s, "fframe")) {
             params->inFrameReadMode = INPUT_FRAME_READ_MODE_FRAME;
         }
+        else if (IS_ARG_EQ(s, "preload")) {
+            params->preloadInput = true;
+        }
+        else if (IS_ARG_EQ(s, "ra")) {
+            if (atoi(argv[idx]) < 0 || atoi(argv[idx]) > MAX_READ_AHEAD_FRAMES) {
+                printf("ERROR - invalid argument: value for -ra switch must be 0 to %d\n",
+                       MAX_READ_AHEAD_FRAMES);
+                return false;
+            }
+
+            params->readAhead = atoi(argv[idx++]);
+        }
+        else if (IS_ARG_EQ(s, "wb")) {
+            if (atoi(argv[idx]) < 0 || atoi(argv[idx]) > MAX_WRITE_BEHIND_FRAMES) {
+                printf("ERROR - invalid argument: value for -wb switch must be 0 to %d\n",
+                       MAX_WRITE_BEHIND_FRAMES);
+                return false;
+            }
+
+            params->writeBehind = atoi(argv[idx++]);
+        }
         else {
             printf("ERROR - invalid argument: %s\n", argv[idx]);
             return false;
@@ -1281,6 +1247,9 @@ void Usage(void) {
     printf("\nFrame mode (optional, default = -fpitch)\n");
     printf("  -fpitch = load frame-by-frame (read data per pitch - legacy)\n");
     printf("  -fframe = load frame-by-frame (read data per frame)\n");
+    printf("  -ra N   = with -fpitch, read up to N frames ahead on another thread (default 0)\n");
+    printf("  -preload = with -fpitch, load input (first maxFrames if -n) into memory once\n");
+    printf("  -wb N   = write up to N output frames behind on another thread (default 0)\n");
 
     printf("\nTo view:\n");
     printf(
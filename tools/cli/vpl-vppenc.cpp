@@ -5,6 +5,8 @@
   ############################################################################*/
 
 #include "./vpl-common.h"
+#include "./vpl-frame-writer.h"
+#include "./vpl-raw-frame-reader.h"
 
 #if !defined(WIN32) && !defined(memcpy_s)
     // memcpy_s proxy to allow use safe version where supported
@@ -28,13 +30,15 @@ typedef struct {
 
 AV1EncConfig* g_conf = NULL;
 mfxU32 repeatCount   = 0;
+RawFrameReader g_frameReader;
+FrameWriter g_writer;
 
 const char* InputFrameReadModeString[INPUT_FRAME_READ_MODE_COUNT] = {
     "INPUT_FRAME_READ_MODE_PITCH",
     "INPUT_FRAME_READ_MODE_FRAME"
 };
 
-mfxStatus LoadRawFrame(mfxFrameSurface1* pSurface, FILE* f, mfxU32 repeat);
+mfxStatus LoadRawFrame(mfxFrameSurface1* pSurface);
 mfxStatus LoadRawFrame2(mfxFrameSurface1* pSurface,
                         FILE* f,
                         int bytes_to_read,
@@ -43,14 +47,13 @@ mfxStatus LoadRawFrame2(mfxFrameSurface1* pSurface,
 
 inline void mem_put_le16(void* vmem, mfxU32 val);
 inline void mem_put_le32(void* vmem, mfxU32 val);
-void WriteIVF_StreamHeader(const AV1EncConfig* conf, FILE* f);
-void WriteIVF_FrameHeader(mfxU32 byte_count, mfxU64 pts, FILE* f);
+void WriteIVF_StreamHeader(const AV1EncConfig* conf);
+void WriteIVF_FrameHeader(mfxU32 byte_count, mfxU64 pts);
 void WriteEncodedStream(mfxU32 nframe,
                         void* conf,
                         mfxU8* data,
                         mfxU32 length,
-                        mfxU32 codecID,
-                        FILE* f);
+                        mfxU32 codecID);
 
 mfxU32 GetSurfaceWidth(mfxU32 fourcc, mfxU16 img_width);
 mfxU32 GetSurfaceSize(mfxU32 FourCC, mfxU32 width, mfxU32 height);
@@ -108,6 +111,14 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    // output frames are written through g_writer, see FrameWriter
+    if (!g_writer.Open(fSink, params.writeBehind)) {
+        fclose(fSource);
+        fclose(fSink);
+        printf("could not create output file, %s\n", params.outfileName);
+        return 1;
+    }
+
     // Initialize Media SDK session
     mfxStatus sts      = MFX_ERR_NOT_INITIALIZED;
     mfxSession session = nullptr;
@@ -248,6 +259,32 @@ int main(int argc, char* argv[]) {
         buf_read = reinterpret_cast<mfxU8*>(malloc(frame_size));
     }
 
+    // pitch mode reads whole frames, see RawFrameReader
+    if (!b_read_frame) {
+        bool bOpened = false;
+        if (params.preloadInput)
+            bOpened = g_frameReader.Preload(params.infileName,
+                                            frame_size,
+                                            params.repeat,
+                                            params.maxFrames);
+        else
+            bOpened =
+                g_frameReader.Open(params.infileName, frame_size, params.repeat, params.readAhead);
+
+        if (!bOpened) {
+            if (fSource) {
+                fclose(fSource);
+                fSource = NULL;
+            }
+            if (fSink) {
+                fclose(fSink);
+                fSink = NULL;
+            }
+            puts("Error opening input file for frame read.");
+            return 1;
+        }
+    }
+
     // get file size
     fseek(fSource, 0, SEEK_END);
 #ifdef _WIN32
@@ -440,7 +477,7 @@ int main(int argc, char* argv[]) {
                     sts = LoadRawFrame2(vppSurfaceIn, fSource, frame_size, buf_read, params.repeat);
                 }
                 else {
-                    sts = LoadRawFrame(vppSurfaceIn, fSource, params.repeat);
+                    sts = LoadRawFrame(vppSurfaceIn);
                 }
                 if (sts != MFX_ERR_NONE)
                     is_draining_vpp = true;
@@ -519,8 +556,7 @@ int main(int argc, char* argv[]) {
                                            g_conf,
                                            bitstream.Data + bitstream.DataOffset,
                                            bitstream.DataLength,
-                                           params.dstFourCC,
-                                           fSink);
+                                           params.dstFourCC);
                         bitstream.DataLength = 0;
                     }
                     break;
@@ -563,11 +599,14 @@ int main(int argc, char* argv[]) {
         fclose(fSource);
         fSource = NULL;
     }
+    g_writer.Close();
     if (fSink) {
         fclose(fSink);
         fSink = NULL;
     }
 
+    g_frameReader.Close();
+
     if (buf_read)
         free(buf_read);
 
@@ -621,134 +660,38 @@ mfxStatus LoadRawFrame2(mfxFrameSurface1* pSurface,
     return MFX_ERR_NONE;
 }
 
-mfxStatus LoadRawFrame(mfxFrameSurface1* pSurface, FILE* f, mfxU32 repeat) {
-    mfxU16 w, h, i, pitch;
-    mfxU32 nBytesRead;
-    mfxU8* ptr;
+mfxStatus LoadRawFrame(mfxFrameSurface1* pSurface) {
+    RawFramePlane planes[3];
+    mfxU32 numPlanes    = 0;
     mfxFrameInfo* pInfo = &pSurface->Info;
     mfxFrameData* pData = &pSurface->Data;
+    mfxU32 pitch        = pData->Pitch;
+    mfxU32 w            = pInfo->Width;
+    mfxU32 h            = pInfo->Height;
 
-    w = pInfo->Width;
-    h = pInfo->Height;
-
+    // planes in the order in which they are stored in the file
     switch (pInfo->FourCC) {
         case MFX_FOURCC_I420:
-            // read luminance plane (Y)
-            pitch = pData->Pitch;
-            ptr   = pData->Y;
-            for (i = 0; i < h; i++) {
-                nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, f);
-                if (w != nBytesRead) {
-                    if (repeatCount == repeat)
-                        return MFX_ERR_MORE_DATA;
-                    else {
-                        fseek(f, 0, SEEK_SET);
-                        repeatCount++;
-                    }
-                }
-            }
-
-            // read chrominance (U, V)
-            pitch /= 2;
-            h /= 2;
-            w /= 2;
-            ptr = pData->U;
-            for (i = 0; i < h; i++) {
-                nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, f);
-                if (w != nBytesRead) {
-                    if (repeatCount == repeat)
-                        return MFX_ERR_MORE_DATA;
-                    else {
-                        fseek(f, 0, SEEK_SET);
-                        repeatCount++;
-                    }
-                }
-            }
-
-            ptr = pData->V;
-            for (i = 0; i < h; i++) {
-                nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, f);
-                if (w != nBytesRead) {
-                    if (repeatCount == repeat)
-                        return MFX_ERR_MORE_DATA;
-                    else {
-                        fseek(f, 0, SEEK_SET);
-                        repeatCount++;
-                    }
-                }
-            }
+            planes[numPlanes++] = { pData->Y, pitch, w, h };
+            planes[numPlanes++] = { pData->U, pitch / 2, w / 2, h / 2 };
+            planes[numPlanes++] = { pData->V, pitch / 2, w / 2, h / 2 };
             break;
-
         case MFX_FOURCC_I010:
-            // read luminance plane (Y)
-            pitch = pData->Pitch;
-            w *= 2;
-            ptr = pData->Y;
-            for (i = 0; i < h; i++) {
-                nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, f);
-                if (w != nBytesRead) {
-                    if (repeatCount == repeat)
-                        return MFX_ERR_MORE_DATA;
-                    else {
-                        fseek(f, 0, SEEK_SET);
-                        repeatCount++;
-                    }
-                }
-            }
-
-            // read chrominance (U, V)
-            pitch /= 2;
-            w /= 2;
-            h /= 2;
-            ptr = pData->U;
-            for (i = 0; i < h; i++) {
-                nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, f);
-                if (w != nBytesRead) {
-                    if (repeatCount == repeat)
-                        return MFX_ERR_MORE_DATA;
-                    else {
-                        fseek(f, 0, SEEK_SET);
-                        repeatCount++;
-                    }
-                }
-            }
-
-            ptr = pData->V;
-            for (i = 0; i < h; i++) {
-                nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, f);
-                if (w != nBytesRead) {
-                    if (repeatCount == repeat)
-                        return MFX_ERR_MORE_DATA;
-                    else {
-                        fseek(f, 0, SEEK_SET);
-                        repeatCount++;
-                    }
-                }
-            }
+            planes[numPlanes++] = { pData->Y, pitch, w * 2, h };
+            planes[numPlanes++] = { pData->U, pitch / 2, w, h / 2 };
+            planes[numPlanes++] = { pData->V, pitch / 2, w, h / 2 };
             break;
-
         case MFX_FOURCC_RGB4:
-            // read luminance plane (Y)
-            pitch = pData->Pitch;
-            w *= 4;
-            ptr = pData->B;
-            for (i = 0; i < h; i++) {
-                nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, f);
-                if (w != nBytesRead) {
-                    if (repeatCount == repeat)
-                        return MFX_ERR_MORE_DATA;
-                    else {
-                        fseek(f, 0, SEEK_SET);
-                        repeatCount++;
-                    }
-                }
-            }
+            planes[numPlanes++] = { pData->B, pitch, w * 4, h };
             break;
         default:
             break;
     }
 
-    return MFX_ERR_NONE;
+    if (numPlanes == 0)
+        return MFX_ERR_NONE;
+
+    return g_frameReader.LoadFrame(planes, numPlanes);
 }
 
 void WriteRawFrame(mfxFrameSurface1* pSurface, FILE* f) {
@@ -1135,6 +1078,27 @@ bool ParseArgsAndValidate(int argc, char* argv[], Params* params) {
         else if (IS_ARG_EQ(s, "fframe")) {
             params->inFrameReadMode = INPUT_FRAME_READ_MODE_FRAME;
         }
+        else if (IS_ARG_EQ(s, "preload")) {
+            params->preloadInput = true;
+        }
+        else if (IS_ARG_EQ(s, "ra")) {
+            if (atoi(argv[idx]) < 0 || atoi(argv[idx]) > MAX_READ_AHEAD_FRAMES) {
+                printf("ERROR - invalid argument: value for -ra switch must be 0 to %d\n",
+                       MAX_READ_AHEAD_FRAMES);
+                return false;
+            }
+
+            params->readAhead = atoi(argv[idx++]);
+        }
+        else if (IS_ARG_EQ(s, "wb")) {
+            if (atoi(argv[idx]) < 0 || atoi(argv[idx]) > MAX_WRITE_BEHIND_FRAMES) {
+                printf("ERROR - invalid argument: value for -wb switch must be 0 to %d\n",
+                       MAX_WRITE_BEHIND_FRAMES);
+                return false;
+            }
+
+            params->writeBehind = atoi(argv[idx++]);
+        }
         else {
             printf("ERROR - invalid argument: %s\n", argv[idx]);
             return false;
@@ -1179,6 +1143,9 @@ void Usage(void) {
     printf("\nFrame mode (optional, default = -fpitch)\n");
     printf("  -fpitch = load frame-by-frame (read data per pitch - legacy)\n");
     printf("  -fframe = load frame-by-frame (read data per frame)\n");
+    printf("  -ra N   = with -fpitch, read up to N frames ahead on another thread (default 0)\n");
+    printf("  -preload = with -fpitch, load input (first maxFrames if -n) into memory once\n");
+    printf("  -wb N   = write up to N output frames behind on another thread (default 0)\n");
 
     printf("\nTo view:\n");
     printf(
@@ -1385,7 +1352,7 @@ inline void mem_put_le32(void* vmem, mfxU32 val) {
     mem[3] = (mfxU8)((val >> 24) & 0xff);
 }
 
-void WriteIVF_StreamHeader(const AV1EncConfig* conf, FILE* f) {
+void WriteIVF_StreamHeader(const AV1EncConfig* conf) {
     char header[32] = { 0 };
 
     header[0] = 'D';
@@ -1403,34 +1370,35 @@ void WriteIVF_StreamHeader(const AV1EncConfig* conf, FILE* f) {
     mem_put_le32(header + 24, 0); // length
     mem_put_le32(header + 28, 0); // unused
 
-    fwrite(header, 1, 32, f);
+    g_writer.Append(header, 32);
     return;
 }
 
-void WriteIVF_FrameHeader(mfxU32 byte_count, mfxU64 pts, FILE* f) {
+void WriteIVF_FrameHeader(mfxU32 byte_count, mfxU64 pts) {
     char header[12] = { 0 };
 
     mem_put_le32(header, (mfxU32)byte_count);
     mem_put_le32(header + 4, (mfxU32)(pts & 0xFFFFFFFF));
     mem_put_le32(header + 8, (mfxU32)(pts >> 32));
 
-    fwrite(header, 1, 12, f);
+    g_writer.Append(header, 12);
 }
 
 void WriteEncodedStream(mfxU32 nframe,
                         void* conf,
                         mfxU8* data,
                         mfxU32 length,
-                        mfxU32 codecID,
-                        FILE* f) {
+                        mfxU32 codecID) {
+    // headers and data go to one buffer, written to disk with a single write
     if (codecID == MFX_CODEC_AV1) {
         if (nframe == 1) {
-            WriteIVF_StreamHeader(reinterpret_cast<AV1EncConfig*>(conf), f);
+            WriteIVF_StreamHeader(reinterpret_cast<AV1EncConfig*>(conf));
         }
-        WriteIVF_FrameHeader(length, nframe - 1, f); // pts starts from 0
-        fwrite(data, 1, length, f);
+        WriteIVF_FrameHeader(length, nframe - 1); // pts starts from 0
+        g_writer.Append(data, length);
     }
     else {
-        fwrite(data, 1, length, f);
+        g_writer.Append(data, length);
     }
+    g_writer.Commit();
 }